@@ -0,0 +1,121 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Brian O'Dell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "account.h"
+
+_Thread_local MemoryAccount *Account;
+
+static const char *KindNames[MEMKINDS] = {
+  "terms", "unifiers", "kb", "proof", "resolution", "tables"
+};
+
+void openAccount(MemoryAccount *account, _Atomic int *abort){
+  for(int i = 0; i<MEMKINDS; i++){
+    account->current[i] = 0;
+    account->peak[i] = 0;
+  }
+  account->total = 0;
+  account->peaktotal = 0;
+  account->exceeded = 0;
+  account->shared = 0;
+  account->abort = abort;
+  Account = account;
+}
+
+void shareAccount(MemoryAccount *account, int shared){
+  account->shared = shared;
+}
+
+/* addBytes - adds bytes to counter and returns the sum; only a shared
+ * account pays for an atomic add */
+static long long addBytes(_Atomic long long *counter, long long bytes, int shared){
+  if(shared) return atomic_fetch_add(counter, bytes) + bytes;
+  long long sum = atomic_load_explicit(counter, memory_order_relaxed) + bytes;
+  atomic_store_explicit(counter, sum, memory_order_relaxed);
+  return sum;
+}
+
+/* raisePeak - makes peak at least value; threads may race, which can only
+ * leave a slightly lower peak */
+static void raisePeak(_Atomic long long *peak, long long value){
+  if(value > atomic_load_explicit(peak, memory_order_relaxed)){
+    atomic_store_explicit(peak, value, memory_order_relaxed);
+  }
+}
+
+void chargeMemory(MemoryKind kind, long long bytes){
+  MemoryAccount *account = Account;
+  if(!account || !bytes) return;
+  int shared = atomic_load_explicit(&account->shared, memory_order_relaxed);
+  raisePeak(&account->peak[kind], addBytes(&account->current[kind], bytes, shared));
+  long long total = addBytes(&account->total, bytes, shared);
+  if(total <= atomic_load_explicit(&account->peaktotal, memory_order_relaxed)) return;
+  raisePeak(&account->peaktotal, total);
+  if(account->limit && total > account->limit && !account->exceeded){
+    account->exceeded = 1;
+    if(account->abort) *account->abort = 1;
+  }
+}
+
+void exhaustMemory(void){
+  MemoryAccount *account = Account;
+  if(!account) return;
+  account->exceeded = 1;
+  if(account->abort) *account->abort = 1;
+}
+
+void closeAccount(void){
+  Account = NULL;
+}
+
+void *accountAlloc(MemoryKind kind, size_t size){
+  chargeMemory(kind, (long long)size);
+  return malloc(size);
+}
+
+void *accountRealloc(MemoryKind kind, void *p, size_t old, size_t size){
+  chargeMemory(kind, (long long)size - (long long)old);
+  return realloc(p, size);
+}
+
+void accountFree(MemoryKind kind, void *p, size_t size){
+  if(!p) return;
+  chargeMemory(kind, -(long long)size);
+  free(p);
+}
+
+const char *memoryKindName(MemoryKind kind){
+  return KindNames[kind];
+}
+
+void printAccount(MemoryAccount *account, FILE *out){
+  fprintf(out, "Peak memory of the last query: %lld bytes", (long long)account->peaktotal);
+  for(int i = 0; i<MEMKINDS; i++){
+    fprintf(out, "%s%s %lld", i ? ", " : " (", KindNames[i], (long long)account->peak[i]);
+  }
+  fprintf(out, ")\n");
+}
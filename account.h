@@ -0,0 +1,97 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Brian O'Dell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PPP_ACCOUNT
+#define PPP_ACCOUNT
+
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * Memory accounting
+ *
+ * A query charges the memory it takes to the account of its engine, kept
+ * per kind of use: the terms it adds to the term store, unifier bindings
+ * and trails, lemmas in the working KB, the text of its answers, the
+ * resolution stacks and answer tables. Each kind has its current and peak
+ * bytes, and so has their total. An account with a limit sets the
+ * engine's abort flag as soon as the total goes over it, so the query
+ * unwinds as it does when it is stopped and releases everything it held.
+ *
+ * Charges go to the account of the calling thread, which runQuery and the
+ * threads of a parallel query set; outside a query nothing is charged.
+ * Only an account shared by several threads is updated with atomic adds.
+ * The counts are of bytes asked for, not of what malloc keeps for them.
+ */
+
+typedef enum
+{
+  MEMTERMS, MEMUNIFIERS, MEMKB, MEMPROOF, MEMRESOLUTION, MEMTABLES, MEMKINDS
+}MemoryKind;
+
+typedef struct MEMORY_ACCOUNT{
+  _Atomic long long current[MEMKINDS];
+  _Atomic long long peak[MEMKINDS];
+  _Atomic long long total;
+  _Atomic long long peaktotal;
+  long long limit;         /* most bytes a query may hold; 0 for no limit */
+  _Atomic int exceeded;    /* the query was stopped at the limit */
+  _Atomic int shared;      /* charged by several threads at once */
+  _Atomic int *abort;      /* set when the limit is exceeded */
+} MemoryAccount;
+
+/* Account - the account charges of this thread go to; NULL for none */
+extern _Thread_local MemoryAccount *Account;
+
+/* openAccount - zeroes account for a new query, keeping its limit, and
+ * makes it the calling thread's; abort is set if the limit is exceeded */
+void openAccount(MemoryAccount *account, _Atomic int *abort);
+
+/* chargeMemory - adds bytes (negative when memory is given back) to kind */
+void chargeMemory(MemoryKind kind, long long bytes);
+
+/* exhaustMemory - stops the query of the calling thread as its limit
+ * does, when memory it needs has run out */
+void exhaustMemory(void);
+
+/* shareAccount - marks account as charged by several threads (1) or by
+ * one (0); set before the other threads start and after they stop */
+void shareAccount(MemoryAccount *account, int shared);
+
+/* closeAccount - stops charging the calling thread's account */
+void closeAccount(void);
+
+/* accountAlloc, accountRealloc, accountFree - malloc, realloc and free
+ * charging kind; old and size are the byte counts before and after */
+void *accountAlloc(MemoryKind kind, size_t size);
+void *accountRealloc(MemoryKind kind, void *p, size_t old, size_t size);
+void accountFree(MemoryKind kind, void *p, size_t size);
+
+/* memoryKindName - name of kind for display */
+const char *memoryKindName(MemoryKind kind);
+
+/* printAccount - writes the peak bytes of each kind and of the total */
+void printAccount(MemoryAccount *account, FILE *out);
+
+#endif
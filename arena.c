@@ -0,0 +1,129 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Brian O'Dell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+#define ARENA_ALIGN 16
+
+static size_t alignSize(size_t size){
+  return (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+/* chunkData - first usable byte of a chunk, after its aligned header */
+static char *chunkData(ArenaChunk *chunk){
+  return (char *)chunk + alignSize(sizeof(ArenaChunk));
+}
+
+Arena *newArena(size_t chunksize){
+  Arena *arena = malloc(sizeof(Arena));
+  arena->chunk = NULL;
+  arena->spare = NULL;
+  arena->chunksize = chunksize;
+  memset(&arena->stats, 0, sizeof(ArenaStats));
+  return arena;
+}
+
+void freeArena(Arena **arena){
+  if(!(* arena)) return;
+  ArenaChunk *c = (* arena)->chunk;
+  while(c){
+    ArenaChunk *prev = c->prev;
+    free(c);
+    c = prev;
+  }
+  free((* arena)->spare);
+  free(* arena);
+  (* arena) = NULL;
+}
+
+static ArenaChunk *newChunk(Arena *arena, size_t size){
+  ArenaChunk *c;
+  if(arena->spare && arena->spare->size >= size){
+    c = arena->spare;
+    arena->spare = NULL;
+  } else {
+    if(size < arena->chunksize) size = arena->chunksize;
+    c = malloc(alignSize(sizeof(ArenaChunk)) + size);
+    c->size = size;
+  }
+  c->used = 0;
+  c->prev = arena->chunk;
+  arena->chunk = c;
+  arena->stats.chunks++;
+  return c;
+}
+
+void *arenaAlloc(Arena *arena, size_t size){
+  size = alignSize(size ? size : 1);
+  ArenaChunk *c = arena->chunk;
+  if(!c || c->used + size > c->size) c = newChunk(arena, size);
+  void *p = chunkData(c) + c->used;
+  c->used += size;
+  arena->stats.allocations++;
+  arena->stats.bytes += size;
+  if(arena->stats.bytes > arena->stats.peak) arena->stats.peak = arena->stats.bytes;
+  return p;
+}
+
+char *arenaString(Arena *arena, const char *str){
+  size_t length = strlen(str);
+  char *copy = arenaAlloc(arena, length + 1);
+  memcpy(copy, str, length + 1);
+  return copy;
+}
+
+ArenaMark arenaMark(Arena *arena){
+  ArenaMark mark;
+  mark.chunk = arena->chunk;
+  mark.used = arena->chunk ? arena->chunk->used : 0;
+  mark.bytes = arena->stats.bytes;
+  return mark;
+}
+
+void arenaRelease(Arena *arena, ArenaMark mark){
+  if(arena->stats.bytes == mark.bytes) return;
+  while(arena->chunk && arena->chunk != mark.chunk){
+    ArenaChunk *c = arena->chunk;
+    arena->chunk = c->prev;
+    arena->stats.chunks--;
+    if(!arena->spare || c->size > arena->spare->size){
+      free(arena->spare);
+      arena->spare = c;
+    } else {
+      free(c);
+    }
+  }
+  if(arena->chunk) arena->chunk->used = mark.used;
+  arena->stats.bytes = mark.bytes;
+  arena->stats.releases++;
+}
+
+void arenaReset(Arena *arena){
+  ArenaMark empty = {NULL, 0, 0};
+  arenaRelease(arena, empty);
+  memset(&arena->stats, 0, sizeof(ArenaStats));
+}
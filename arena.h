@@ -0,0 +1,87 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Brian O'Dell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PPP_ARENA
+#define PPP_ARENA
+
+#include <stddef.h>
+
+/**
+ * Arena
+ *
+ * A region allocator: memory is bumped out of large chunks and never freed
+ * piece by piece. A mark records the current position; releasing to a mark
+ * drops everything allocated after it at once. A query takes a mark when it
+ * starts and releases it when it ends or is aborted, so nothing it allocated
+ * has to be tracked individually.
+ */
+
+typedef struct ARENA_STATS{
+  size_t allocations;  /* arenaAlloc calls */
+  size_t bytes;        /* bytes currently allocated */
+  size_t peak;         /* most bytes allocated at once */
+  size_t chunks;       /* chunks currently held */
+  size_t releases;     /* arenaRelease calls that freed something */
+} ArenaStats;
+
+typedef struct ARENA_CHUNK{
+  struct ARENA_CHUNK *prev;
+  size_t size;
+  size_t used;
+} ArenaChunk;
+
+typedef struct ARENA{
+  ArenaChunk *chunk;   /* newest chunk */
+  ArenaChunk *spare;   /* last released chunk, kept for reuse */
+  size_t chunksize;
+  ArenaStats stats;
+} Arena;
+
+/* ArenaMark - position to release back to */
+typedef struct ARENA_MARK{
+  ArenaChunk *chunk;
+  size_t used;
+  size_t bytes;
+} ArenaMark;
+
+/* newArena - creates an arena allocating chunks of at least chunksize bytes */
+Arena *newArena(size_t chunksize);
+
+void freeArena(Arena **arena);
+
+/* arenaAlloc - returns size bytes aligned for any type */
+void *arenaAlloc(Arena *arena, size_t size);
+
+/* arenaString - returns a copy of str allocated in arena */
+char *arenaString(Arena *arena, const char *str);
+
+ArenaMark arenaMark(Arena *arena);
+
+/* arenaRelease - discards everything allocated since mark */
+void arenaRelease(Arena *arena, ArenaMark mark);
+
+/* arenaReset - discards everything and clears the statistics */
+void arenaReset(Arena *arena);
+
+#endif
@@ -0,0 +1,136 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Brian O'Dell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arith.h"
+
+int isArithmetic(Term goal){
+  if(termType(goal) != TTFUNCTOR || termArity(goal) != 2) return 0;
+  Symbol name = termName(goal);
+  return name == SymIs || name == SymArithEqual || name == SymArithNotEqual ||
+    name == SymLess || name == SymLessEqual || name == SymGreater ||
+    name == SymGreaterEqual;
+}
+
+int applyArithmetic(Symbol name, int arity, const int *args, int *value){
+  long long a = args[0];
+  long long result;
+  if(arity == 1){
+    if(name != SymMinus) return 0;
+    result = -a;
+  } else {
+    long long b = args[1];
+    if(name == SymPlus) result = a + b;
+    else if(name == SymMinus) result = a - b;
+    else if(name == SymTimes) result = a * b;
+    else if(name == SymIntDivide || name == SymMod){
+      if(!b) return 0;
+      result = name == SymIntDivide ? a / b : a % b;
+      // mod takes the sign of the divisor, where C's % takes the dividend's
+      if(name == SymMod && result && (result < 0) != (b < 0)) result += b;
+    } else {
+      return 0;
+    }
+  }
+  if(result < INT_MIN || result > INT_MAX) return 0;
+  (* value) = (int)result;
+  return 1;
+}
+
+int compareArithmetic(Symbol name, int a, int b){
+  if(name == SymArithEqual) return a == b;
+  if(name == SymArithNotEqual) return a != b;
+  if(name == SymLess) return a < b;
+  if(name == SymLessEqual) return a <= b;
+  if(name == SymGreater) return a > b;
+  if(name == SymGreaterEqual) return a >= b;
+  return 0;
+}
+
+int evaluate(Term expr, Unifier *unifier, int *value){
+  return evaluateWith(expr, unifier, NULL, NULL, value);
+}
+
+int evaluateWith(Term expr, Unifier *unifier, Lookup lookup, void *context, int *value){
+  // operands go on pending above a 0 and their operator; a 0 popped means
+  // the operands are on values and the operator below it can be applied
+  TermStack pending;
+  initTermStack(&pending);
+  int local[32];
+  int *values = local;
+  int count = 0, size = 32, ok = 1;
+  PUSH_TERM(&pending, expr);
+  while(ok && pending.count){
+    Term t = pending.items[--pending.count];
+    int result;
+    if(!t){
+      t = pending.items[--pending.count];
+      int arity = termArity(t);
+      count -= arity;
+      ok = applyArithmetic(termName(t), arity, values + count, &result);
+    } else if(lookup && termType(t) == TTVARIABLE){
+      // the term a variable stands for is not part of expr itself
+      t = lookup(t, context);
+      ok = t && evaluate(t, unifier, &result);
+    } else {
+      t = deref(t, unifier);
+      int arity = termArity(t);
+      if(termType(t) == TTINTEGER){
+        result = termInteger(t);
+      } else if(termType(t) == TTFUNCTOR && arity <= 2){
+        PUSH_TERM(&pending, t);
+        PUSH_TERM(&pending, 0);
+        for(int i = arity - 1; i>=0; i--) PUSH_TERM(&pending, termArg(t, i));
+        continue;
+      } else {
+        ok = 0;
+        break;
+      }
+    }
+    if(!ok) break;
+    if(count == size){
+      size *= 2;
+      values = values == local ? memcpy(malloc(size * sizeof(int)), local, sizeof(local)) :
+        realloc(values, size * sizeof(int));
+    }
+    values[count++] = result;
+  }
+  if(ok) (* value) = values[0];
+  if(values != local) free(values);
+  freeTermStack(&pending);
+  return ok;
+}
+
+int solveArithmetic(Term goal, Unifier *unifier){
+  int right;
+  if(!evaluate(termArg(goal, 1), unifier, &right)) return 0;
+  if(termName(goal) == SymIs) return unify(termArg(goal, 0), integerTerm(right), unifier);
+  int left;
+  if(!evaluate(termArg(goal, 0), unifier, &left)) return 0;
+  return compareArithmetic(termName(goal), left, right);
+}
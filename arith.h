@@ -0,0 +1,71 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Brian O'Dell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef PPP_ARITH
+#define PPP_ARITH
+
+#include "ppp.h"
+
+/**
+ * Arithmetic
+ *
+ * is/2 and the comparisons =:=, =\=, <, =<, >, >= are proved in C rather
+ * than from clauses. Their arguments are evaluated as expressions: an
+ * integer, a variable bound to an expression, or +, -, *, // and mod of
+ * expressions (and - of one). // truncates towards zero and the result of
+ * mod has the sign of its divisor.
+ *
+ * Integers are 32 bits wide. A goal whose expression has an unbound
+ * variable or a name that is not a function, divides by zero or overflows
+ * fails, as does any goal that is false.
+ */
+
+/* isArithmetic - returns 1 if goal is is/2 or a comparison */
+int isArithmetic(Term goal);
+
+/* applyArithmetic - sets *value to function name of arity 1 or 2 applied
+ * to args; returns 0 if it is no function or has no value there */
+int applyArithmetic(Symbol name, int arity, const int *args, int *value);
+
+/* compareArithmetic - returns 1 if comparison name holds between a and b */
+int compareArithmetic(Symbol name, int a, int b);
+
+/* evaluate - sets *value to the value of expr under unifier; returns 0 if
+ * expr has none */
+int evaluate(Term expr, Unifier *unifier, int *value);
+
+/* Lookup - the term variable var of an expression stands for, or 0 if it
+ * stands for none */
+typedef Term (*Lookup)(Term var, void *context);
+
+/* evaluateWith - evaluate, with each variable of expr itself replaced by
+ * lookup(var, context) and the terms it gives evaluated under unifier */
+int evaluateWith(Term expr, Unifier *unifier, Lookup lookup, void *context, int *value);
+
+/* solveArithmetic - proves goal, binding the left side of is/2; returns 0,
+ * leaving unifier unchanged, if goal fails */
+int solveArithmetic(Term goal, Unifier *unifier);
+
+#endif
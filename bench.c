@@ -0,0 +1,253 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Brian O'Dell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * ppp_bench
+ *
+ * Runs fixed query sets over the bundled knowledge bases and scaled
+ * synthetic ones, on the interpreter and the VM, and writes one JSON
+ * result per query: best and mean wall time, resolution steps, unify
+ * calls, solutions, peak RSS and allocations. Results from two builds
+ * can be diffed line by line.
+ *
+ * usage: ppp_bench [--repeat N] [--out FILE]
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ppp.h"
+#include "wam.h"
+#include "utils.h"
+
+#ifndef PPP_SOURCE_DIR
+#define PPP_SOURCE_DIR "."
+#endif
+
+/* answers beyond this are not asked for, so every query terminates */
+#define BENCH_MAX_SOLUTIONS 10000
+
+#ifdef PPP_COUNT_ALLOCATIONS
+// the bench target is linked with --wrap for these, so every allocation
+// made by the engine passes through here
+static long Allocations = 0;
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void *__wrap_malloc(size_t size){
+  Allocations++;
+  return __real_malloc(size);
+}
+void *__wrap_calloc(size_t count, size_t size){
+  Allocations++;
+  return __real_calloc(count, size);
+}
+void *__wrap_realloc(void *ptr, size_t size){
+  Allocations++;
+  return __real_realloc(ptr, size);
+}
+#else
+static long Allocations = -1;
+#endif
+
+typedef struct WORKLOAD{
+  const char *name;
+  const char *kbfile;                /* KB in the source tree, or NULL */
+  void (*generate)(FILE *f, int n);  /* writes a synthetic KB of size n */
+  int size;
+  int vm;                            /* the VM terminates on these queries */
+  long maxsolutions;                 /* answers per query; 0 for BENCH_MAX_SOLUTIONS */
+  const char *queries[8];
+} Workload;
+
+static void generateChain(FILE *f, int n){
+  for(int i = 0; i<=n; i++) fprintf(f, "d(%d).\n", i);
+  for(int i = 0; i<n; i++) fprintf(f, "ds(%d,%d).\n", i, i + 1);
+  fprintf(f, "lt(A,B):-ds(A,B).\n");
+  fprintf(f, "lt(A,B):-ds(A,C),ds(C,B).\n");
+  fprintf(f, "lt(A,B):-ds(A,C), ds(D,B), lt(C,D).\n");
+}
+
+static void generateAckermann(FILE *f, int n){
+  (void)n;
+  fprintf(f, "a(0,N,s(N)).\n");
+  fprintf(f, "a(s(M), 0, X) :- a(M, s(0), X).\n");
+  fprintf(f, "a(s(M), s(N), X) :- a(s(M), N, Y), a(M, Y, X).\n");
+}
+
+static void generateClosure(FILE *f, int n){
+  fprintf(f, ":- table path/2.\n");
+  for(int i = 0; i<n; i++) fprintf(f, "edge(n%d,n%d).\n", i, i + 1);
+  fprintf(f, "edge(n%d,n0).\n", n);
+  fprintf(f, "path(X,Y):-path(X,Z),edge(Z,Y).\n");
+  fprintf(f, "path(X,Y):-edge(X,Y).\n");
+}
+
+static void generateArithmetic(FILE *f, int n){
+  (void)n;
+  fprintf(f, "sum(0,0).\n");
+  fprintf(f, "sum(N,S):-N > 0, M is N - 1, sum(M,T), S is T + N.\n");
+}
+
+static Workload Workloads[] = {
+  {"testkb", "testkb", NULL, 0, 1, 0, {"lt(0,X).", "lt(X,9).", "ds(X,Y).", "lt(X,Y).", NULL}},
+  {"ackermann", "ackermann", NULL, 0, 1, 0, {"a(s(s(0)),s(s(0)),X).", "a(s(0),s(s(0)),X).", NULL}},
+  {"tabling", "tabling", NULL, 0, 0, 0, {"true(X).", NULL}},
+  {"marylikeswine", "marylikeswine", NULL, 0, 1, 0, {"likes(mary,X).", NULL}},
+  {"peano", "peano", NULL, 0, 0, 0, {"n(0).", "n(X).", "not(eq(s(0),0)).", NULL}},
+  {"chain100", NULL, generateChain, 100, 1, 0, {"lt(0,X).", "lt(X,100).", "ds(X,Y).", "lt(50,X).", NULL}},
+  // the VM tries ds/2 clause by clause, so chain1000 would take minutes there;
+  // ds(D,B) is not indexed either, so each further lt/2 answer costs more than the last
+  {"chain1000", NULL, generateChain, 1000, 0, 200, {"lt(0,X).", "lt(X,1000).", "ds(X,Y).", NULL}},
+  {"ackermann33", NULL, generateAckermann, 0, 1, 0,
+    {"a(s(s(s(0))),s(s(s(0))),X).", "a(s(s(0)),s(s(s(s(s(s(s(s(s(s(0)))))))))),X).", NULL}},
+  {"closure200", NULL, generateClosure, 200, 0, 0, {"path(n0,X).", "path(X,n0).", NULL}},
+  {"closure50", NULL, generateClosure, 50, 0, 0, {"path(X,Y).", NULL}},
+  {"arithmetic", NULL, generateArithmetic, 0, 1, 0, {"sum(1000,S).", "sum(5000,S).", NULL}}
+};
+
+static double now(void){
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+/* resetPeakRSS - restarts the kernel's high water mark (Linux); 0 if unsupported */
+static int resetPeakRSS(void){
+  FILE *f = fopen("/proc/self/clear_refs", "w");
+  if(!f) return 0;
+  int ok = fputs("5", f) >= 0;
+  return fclose(f) == 0 && ok;
+}
+
+/* peakRSS - high water mark of resident memory in KB; -1 if unknown */
+static long peakRSS(void){
+  FILE *f = fopen("/proc/self/status", "r");
+  if(!f) return -1;
+  char line[256];
+  long kb = -1;
+  while(fgets(line, sizeof(line), f)){
+    if(!strncmp(line, "VmHWM:", 6)) kb = atol(line + 6);
+  }
+  fclose(f);
+  return kb;
+}
+
+static int loadWorkload(Engine *engine, Workload *w){
+  if(w->kbfile){
+    char *path = concat(PPP_SOURCE_DIR "/", w->kbfile);
+    int load = loadKB(engine, path);
+    freeChar(&path);
+    return load;
+  }
+  char path[] = "/tmp/ppp_benchXXXXXX";
+  int fd = mkstemp(path);
+  if(fd < 0) return 0;
+  FILE *f = fdopen(fd, "w");
+  w->generate(f, w->size);
+  fclose(f);
+  int load = loadKB(engine, path);
+  unlink(path);
+  return load;
+}
+
+static void runWorkload(Engine *engine, FILE *out, Workload *w, int vm, int repeat,
+  int *first){
+  for(int q = 0; w->queries[q]; q++){
+    char *text = copyString(w->queries[q]);
+    int rss = resetPeakRSS();
+    EngineStats before = Stats;
+    long allocations = Allocations;
+    double best = 0;
+    double total = 0;
+    for(int r = 0; r<repeat; r++){
+      double start = now();
+      runQuery(engine, text, vm);
+      double ms = now() - start;
+      if(!r || ms < best) best = ms;
+      total += ms;
+    }
+    fprintf(out, "%s\n    {\"workload\":", * first ? "" : ",");
+    outputJSONString(out, w->name);
+    fprintf(out, ",\"engine\":\"%s\",\"query\":", vm ? "vm" : "interpreter");
+    outputJSONString(out, w->queries[q]);
+    fprintf(out, ",\"solutions\":%ld,\"time_ms\":%.3f,\"time_ms_mean\":%.3f"
+      ",\"steps\":%ld,\"unifications\":%ld,\"peak_rss_kb\":%ld,\"allocations\":%ld}",
+      engine->presentation.solutions, best, total / repeat,
+      (Stats.steps - before.steps) / repeat,
+      (Stats.unifications - before.unifications) / repeat,
+      rss ? peakRSS() : -1,
+      Allocations < 0 ? -1 : (Allocations - allocations) / repeat);
+    (* first) = 0;
+    freeChar(&text);
+  }
+}
+
+int main(int argc, char const *argv[]){
+  int repeat = 3;
+  FILE *out = stdout;
+  for(int i = 1; i<argc; i++){
+    if(!strcomp((char *)argv[i], "--repeat") && i + 1 < argc){
+      repeat = atoint(argv[++i]);
+      if(repeat < 1) repeat = 1;
+    } else if(!strcomp((char *)argv[i], "--out") && i + 1 < argc){
+      out = fopen(argv[++i], "w");
+      if(!out){
+        fprintf(stderr, "%s: cannot write\n", argv[i]);
+        return 1;
+      }
+    } else {
+      fprintf(stderr, "usage: ppp_bench [--repeat N] [--out FILE]\n");
+      return 1;
+    }
+  }
+
+  Engine *engine = newEngine();
+  engine->presentation.batch = 1;
+  engine->presentation.quiet = 1;
+
+  int first = 1;
+  fprintf(out, "{\"repeat\":%d,\"results\":[", repeat);
+  for(unsigned int i = 0; i<sizeof(Workloads) / sizeof(Workload); i++){
+    Workload *w = &Workloads[i];
+    if(!loadWorkload(engine, w)){
+      fprintf(stderr, "%s: File Not Found\n", w->name);
+      continue;
+    }
+    engine->presentation.maxsolutions = w->maxsolutions ? w->maxsolutions : BENCH_MAX_SOLUTIONS;
+    runWorkload(engine, out, w, 0, repeat, &first);
+    if(w->vm){
+      compileKB(engine);
+      runWorkload(engine, out, w, 1, repeat, &first);
+    }
+    freeKB(&engine->kb);
+  }
+  fprintf(out, "\n]}\n");
+  if(out != stdout) fclose(out);
+
+  freeEngine(&engine);
+  return 0;
+}
@@ -0,0 +1,422 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Brian O'Dell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "image.h"
+#include "index.h"
+#include "utils.h"
+
+#define IMAGE_BYTEORDER 0x01020304u
+
+typedef struct IMAGE_HEADER{
+  char magic[4];
+  uint32_t version;
+  uint32_t byteorder;      /* IMAGE_BYTEORDER as the writer stored it */
+  uint32_t symbolcount;
+  uint32_t cellcount;      /* cells are numbered from 1 */
+  uint32_t statementcount;
+  uint32_t predicatecount;
+  uint32_t unused;
+  uint64_t symbols;        /* section offsets from the start of the image */
+  uint64_t strings;
+  uint64_t cells;
+  uint64_t statements;
+  uint64_t predicates;
+  uint64_t size;           /* size of the whole image */
+} ImageHeader;
+
+typedef struct IMAGE_STATEMENT{
+  uint64_t entry;          /* offset in strings; 0 for no text */
+  uint32_t term;           /* cell number; 0 for no term */
+  uint32_t unused;
+} ImageStatement;
+
+/* ByteBuffer - a section of the image being written */
+typedef struct BYTE_BUFFER{
+  char *data;
+  size_t length;
+  size_t size;
+} ByteBuffer;
+
+/* ImageWriter - the sections and the numbers given so far */
+typedef struct IMAGE_WRITER{
+  KeyTable symbols;        /* Symbol to its number + 1 */
+  KeyTable cells;          /* Term to its cell number */
+  KeyTable statements;     /* statement node to its number + 1 */
+  uint32_t symbolcount;
+  uint32_t cellcount;
+  ByteBuffer symbolsection;
+  ByteBuffer strings;
+  ByteBuffer cellsection;
+  ByteBuffer statementsection;
+  ByteBuffer predicatesection;
+} ImageWriter;
+
+static void appendBytes(ByteBuffer *b, const void *bytes, size_t length){
+  while(b->length + length > b->size){
+    b->size = b->size ? b->size * 2 : 4096;
+    b->data = realloc(b->data, b->size);
+  }
+  memcpy(b->data + b->length, bytes, length);
+  b->length += length;
+}
+
+static void appendWord(ByteBuffer *b, uint32_t word){
+  appendBytes(b, &word, sizeof(word));
+}
+
+/* imageString - adds text to the string pool; returns its offset */
+static uint64_t imageString(ImageWriter *w, const char *text){
+  uint64_t offset = w->strings.length;
+  appendBytes(&w->strings, text, strlength(text) + 1);
+  return offset;
+}
+
+static uint32_t imageSymbol(ImageWriter *w, Symbol s){
+  void *number = getKey(&w->symbols, s);
+  if(number) return (uint32_t)((uintptr_t)number - 1);
+  uint64_t offset = imageString(w, symbolName(s));
+  appendBytes(&w->symbolsection, &offset, sizeof(offset));
+  putKey(&w->symbols, s, (void *)(uintptr_t)(w->symbolcount + 1));
+  return w->symbolcount++;
+}
+
+/* imageCell - writes t after its arguments; returns its cell number */
+static uint32_t imageCell(ImageWriter *w, Term t){
+  TermStack pending;
+  initTermStack(&pending);
+  PUSH_TERM(&pending, t);
+  while(pending.count){
+    Term n = pending.items[pending.count - 1];
+    if(getKey(&w->cells, n)){
+      pending.count--;
+      continue;
+    }
+    // a term is written once all its arguments are
+    int arity = termArity(n), waiting = 0;
+    for(int i = arity - 1; i>=0; i--){
+      if(!getKey(&w->cells, termArg(n, i))){
+        PUSH_TERM(&pending, termArg(n, i));
+        waiting = 1;
+      }
+    }
+    if(waiting) continue;
+    pending.count--;
+    appendWord(&w->cellsection, (uint32_t)termType(n));
+    appendWord(&w->cellsection, imageSymbol(w, termName(n)));
+    appendWord(&w->cellsection, (uint32_t)termIndex(n));
+    appendWord(&w->cellsection, (uint32_t)arity);
+    for(int i = 0; i<arity; i++){
+      appendWord(&w->cellsection, (uint32_t)(uintptr_t)getKey(&w->cells, termArg(n, i)));
+    }
+    putKey(&w->cells, n, (void *)(uintptr_t)(++w->cellcount));
+  }
+  freeTermStack(&pending);
+  return (uint32_t)(uintptr_t)getKey(&w->cells, t);
+}
+
+/* imagePositions - writes a position list, preceded by the name and arity
+ * of its first argument unless it lists variable first arguments (key 0) */
+static void imagePositions(ImageWriter *w, unsigned long long key, PositionList *list){
+  if(key){
+    appendWord(&w->predicatesection, imageSymbol(w, (Symbol)(key >> 32)));
+    appendWord(&w->predicatesection, (uint32_t)key);
+  }
+  appendWord(&w->predicatesection, (uint32_t)list->count);
+  for(int i = 0; i<list->count; i++){
+    appendWord(&w->predicatesection, (uint32_t)list->positions[i]);
+  }
+}
+
+static void imagePredicate(ImageWriter *w, Predicate *pred){
+  appendWord(&w->predicatesection, imageSymbol(w, (Symbol)(pred->key >> 32)));
+  appendWord(&w->predicatesection, (uint32_t)pred->key);
+  appendWord(&w->predicatesection, (uint32_t)pred->count);
+  for(int i = 0; i<pred->count; i++){
+    void *number = getKey(&w->statements, (unsigned long long)(uintptr_t)pred->clauses[i]);
+    appendWord(&w->predicatesection, (uint32_t)((uintptr_t)number - 1));
+  }
+  imagePositions(w, 0, &pred->variables);
+  appendWord(&w->predicatesection, (uint32_t)pred->firstargs.count);
+  for(int i = 0; i<pred->firstargs.size; i++){
+    if(pred->firstargs.keys[i]){
+      imagePositions(w, pred->firstargs.keys[i], pred->firstargs.values[i]);
+    }
+  }
+}
+
+/* writeSection - writes b padded to 8 bytes; returns its offset */
+static uint64_t writeSection(FILE *f, ByteBuffer *b, uint64_t *offset){
+  static const char padding[8];
+  uint64_t at = * offset;
+  fwrite(b->data, 1, b->length, f);
+  size_t pad = (8 - b->length % 8) % 8;
+  fwrite(padding, 1, pad, f);
+  (* offset) += b->length + pad;
+  return at;
+}
+
+int writeImage(KB *kb, const char *pathname){
+  FILE *f = fopen(pathname, "wb");
+  if(!f) return 0;
+  refreshIndex(kb->index);
+  ImageWriter w;
+  memset(&w, 0, sizeof(ImageWriter));
+  initKeyTable(&w.symbols);
+  initKeyTable(&w.cells);
+  initKeyTable(&w.statements);
+  // offset 0 of the pool is the empty string, meaning no text
+  appendBytes(&w.strings, "", 1);
+  uint32_t statementcount = 0;
+  for(StringList *s = kb->statements; s; s = s->next){
+    ImageStatement st;
+    st.entry = s->entry ? imageString(&w, s->entry) : 0;
+    st.term = s->term ? imageCell(&w, s->term) : 0;
+    st.unused = 0;
+    appendBytes(&w.statementsection, &st, sizeof(st));
+    putKey(&w.statements, (unsigned long long)(uintptr_t)s, (void *)(uintptr_t)(++statementcount));
+  }
+  uint32_t predicatecount = 0;
+  KeyTable *preds = &kb->index->predicates;
+  for(int i = 0; i<preds->size; i++){
+    Predicate *pred = preds->values[i];
+    if(!pred || !pred->count) continue;
+    imagePredicate(&w, pred);
+    predicatecount++;
+  }
+
+  ImageHeader h;
+  memset(&h, 0, sizeof(ImageHeader));
+  memcpy(h.magic, IMAGE_MAGIC, 4);
+  h.version = IMAGE_VERSION;
+  h.byteorder = IMAGE_BYTEORDER;
+  h.symbolcount = w.symbolcount;
+  h.cellcount = w.cellcount;
+  h.statementcount = statementcount;
+  h.predicatecount = predicatecount;
+  fwrite(&h, sizeof(ImageHeader), 1, f);
+  uint64_t offset = sizeof(ImageHeader);
+  h.symbols = writeSection(f, &w.symbolsection, &offset);
+  h.strings = writeSection(f, &w.strings, &offset);
+  h.cells = writeSection(f, &w.cellsection, &offset);
+  h.statements = writeSection(f, &w.statementsection, &offset);
+  h.predicates = writeSection(f, &w.predicatesection, &offset);
+  h.size = offset;
+  // the offsets are known only now
+  fseek(f, 0, SEEK_SET);
+  fwrite(&h, sizeof(ImageHeader), 1, f);
+  int ok = !ferror(f);
+  if(fclose(f)) ok = 0;
+
+  free(w.symbols.keys);
+  free(w.symbols.values);
+  free(w.cells.keys);
+  free(w.cells.values);
+  free(w.statements.keys);
+  free(w.statements.values);
+  free(w.symbolsection.data);
+  free(w.strings.data);
+  free(w.cellsection.data);
+  free(w.statementsection.data);
+  free(w.predicatesection.data);
+  return ok;
+}
+
+int isImage(const char *data, size_t size){
+  return data && size >= 4 && !memcmp(data, IMAGE_MAGIC, 4);
+}
+
+/* ImageReader - a bounds-checked walk over one section */
+typedef struct IMAGE_READER{
+  const uint32_t *next;
+  const uint32_t *end;
+  int error;
+} ImageReader;
+
+static uint32_t readWord(ImageReader *r){
+  if(r->next >= r->end){
+    r->error = 1;
+    return 0;
+  }
+  return *(r->next++);
+}
+
+static int validHeader(const ImageHeader *h, size_t size){
+  if(size < sizeof(ImageHeader) || h->version != IMAGE_VERSION ||
+    h->byteorder != IMAGE_BYTEORDER || h->size != size) return 0;
+  // the sections follow each other in this order
+  uint64_t order[6] = {h->symbols, h->strings, h->cells, h->statements, h->predicates, h->size};
+  if(h->symbols < sizeof(ImageHeader)) return 0;
+  for(int i = 0; i<5; i++){
+    if(order[i] > order[i+1] || order[i] % 8) return 0;
+  }
+  return (h->strings - h->symbols) / sizeof(uint64_t) >= h->symbolcount &&
+    (h->predicates - h->statements) / sizeof(ImageStatement) >= h->statementcount &&
+    h->cells < h->statements && ((char *)h)[h->cells - 1] == '\0';
+}
+
+/* readCells - interns the symbols and rebuilds the cells into terms */
+static int readCells(const ImageHeader *h, const char *data, Symbol *symbols, Term *terms){
+  const uint64_t *offsets = (const uint64_t *)(data + h->symbols);
+  uint64_t strings = h->cells - h->strings;
+  for(uint32_t i = 0; i<h->symbolcount; i++){
+    if(offsets[i] >= strings) return 0;
+    const char *name = data + h->strings + offsets[i];
+    symbols[i] = intern(name, strlength(name));
+  }
+  ImageReader r = {(const uint32_t *)(data + h->cells), (const uint32_t *)(data + h->statements), 0};
+  int size = 8;
+  Term *args = malloc(size * sizeof(Term));
+  terms[0] = 0;
+  for(uint32_t c = 1; c<=h->cellcount && !r.error; c++){
+    TermType type = (TermType)readWord(&r);
+    uint32_t name = readWord(&r);
+    int index = (int)readWord(&r);
+    uint32_t arity = readWord(&r);
+    if(r.error || name >= h->symbolcount || arity > (uint32_t)(r.end - r.next)){
+      r.error = 1;
+      break;
+    }
+    if((int)arity > size){
+      size = arity;
+      args = realloc(args, size * sizeof(Term));
+    }
+    for(uint32_t i = 0; i<arity; i++){
+      // arguments are always written before the cells using them
+      uint32_t arg = readWord(&r);
+      if(!arg || arg >= c) r.error = 1;
+      args[i] = r.error ? 0 : terms[arg];
+    }
+    if(r.error) break;
+    if(type == TTVARIABLE) terms[c] = variableTerm(symbols[name], index);
+    else if(type == TTINTEGER) terms[c] = integerTerm(index);
+    else terms[c] = functorTerm(symbols[name], arity, args);
+  }
+  free(args);
+  return !r.error;
+}
+
+/* readPositions - restores one position list of pred; keyed lists start
+ * with the name and arity of their first argument */
+static int readPositions(ImageReader *r, Predicate *pred, int keyed, const Symbol *symbols,
+  uint32_t symbolcount, unsigned int **positions, int *size){
+  unsigned long long key = 0;
+  if(keyed){
+    uint32_t name = readWord(r);
+    uint32_t arity = readWord(r);
+    if(r->error || name >= symbolcount) return 0;
+    key = ((unsigned long long)symbols[name] << 32) | arity;
+  }
+  uint32_t count = readWord(r);
+  if(r->error || count > (uint32_t)(r->end - r->next)) return 0;
+  if((int)count > (* size)){
+    (* size) = count;
+    (* positions) = realloc(* positions, (* size) * sizeof(unsigned int));
+  }
+  for(uint32_t i = 0; i<count; i++){
+    (* positions)[i] = readWord(r);
+    if((* positions)[i] >= (uint32_t)pred->count) return 0;
+  }
+  restorePositions(pred, key, * positions, count);
+  return 1;
+}
+
+static int readPredicates(const ImageHeader *h, const char *data, KB *kb, const Symbol *symbols){
+  ImageReader r = {(const uint32_t *)(data + h->predicates), (const uint32_t *)(data + h->size), 0};
+  int size = 16;
+  StringList **clauses = malloc(size * sizeof(StringList *));
+  int psize = 16;
+  unsigned int *positions = malloc(psize * sizeof(unsigned int));
+  int ok = 1;
+  for(uint32_t p = 0; p<h->predicatecount && ok; p++){
+    uint32_t name = readWord(&r);
+    uint32_t arity = readWord(&r);
+    uint32_t count = readWord(&r);
+    if(r.error || name >= h->symbolcount || count > (uint32_t)(r.end - r.next)){
+      ok = 0;
+      break;
+    }
+    if((int)count > size){
+      size = count;
+      clauses = realloc(clauses, size * sizeof(StringList *));
+    }
+    for(uint32_t i = 0; i<count; i++){
+      uint32_t statement = readWord(&r);
+      if(statement >= kb->nodecount) ok = 0;
+      clauses[i] = ok ? &kb->nodes[statement] : NULL;
+    }
+    if(!ok) break;
+    unsigned long long key = ((unsigned long long)symbols[name] << 32) | arity;
+    Predicate *pred = restorePredicate(kb->index, key, clauses, count);
+    ok = readPositions(&r, pred, 0, symbols, h->symbolcount, &positions, &psize);
+    uint32_t firstargs = readWord(&r);
+    for(uint32_t i = 0; i<firstargs && ok && !r.error; i++){
+      ok = readPositions(&r, pred, 1, symbols, h->symbolcount, &positions, &psize);
+    }
+    if(r.error) ok = 0;
+  }
+  free(clauses);
+  free(positions);
+  return ok;
+}
+
+KB *loadImage(char *data, size_t size){
+  const ImageHeader *h = (const ImageHeader *)data;
+  if(!isImage(data, size) || !validHeader(h, size)) return NULL;
+  Symbol *symbols = malloc((h->symbolcount ? h->symbolcount : 1) * sizeof(Symbol));
+  Term *terms = malloc((h->cellcount + 1) * sizeof(Term));
+  KB *kb = NULL;
+  if(readCells(h, data, symbols, terms)){
+    kb = newKB();
+    kb->text = data;
+    kb->textsize = size;
+    kb->nodes = malloc((h->statementcount ? h->statementcount : 1) * sizeof(StringList));
+    const ImageStatement *st = (const ImageStatement *)(data + h->statements);
+    uint64_t strings = h->cells - h->strings;
+    StringList **tail = &kb->statements;
+    int ok = 1;
+    for(uint32_t i = 0; i<h->statementcount; i++){
+      if(st[i].entry >= strings || st[i].term > h->cellcount) ok = 0;
+      StringList *s = &kb->nodes[kb->nodecount++];
+      s->entry = ok && st[i].entry ? data + h->strings + st[i].entry : NULL;
+      s->term = ok ? terms[st[i].term] : 0;
+      s->next = NULL;
+      (* tail) = s;
+      tail = &s->next;
+      recordClause(kb->index, s);
+    }
+    if(!ok || !readPredicates(h, data, kb, symbols)){
+      // the caller still owns the image and the text in it
+      for(StringList *s = kb->statements; s; s = s->next) s->entry = NULL;
+      kb->text = NULL;
+      kb->textsize = 0;
+      freeKB(&kb);
+    }
+  }
+  free(symbols);
+  free(terms);
+  return kb;
+}
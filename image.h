@@ -0,0 +1,66 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Brian O'Dell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PPP_IMAGE
+#define PPP_IMAGE
+
+#include "ppp.h"
+
+/**
+ * KB image
+ *
+ * "ppp --compile kb -o kb.pppi" writes the loaded KB as a binary image so
+ * that later starts skip parsing. The image holds, in native byte order:
+ *
+ *   header      magic "PPPI", version, byte order mark, section offsets
+ *   symbols     offset of each name in the string pool
+ *   strings     symbol names and statement text, each ending with a 0
+ *   cells       every term of the KB, arguments before the terms using
+ *               them: type, name, index (the value of an integer), arity,
+ *               argument cells
+ *   statements  text offset (0 for none) and cell of each statement
+ *   predicates  name, arity and clauses of each predicate, then its
+ *               clause positions by first argument
+ *
+ * loadKB recognizes an image by its magic. The loader interns the symbols
+ * and rebuilds the cells without reading any text, points the statements
+ * at the text in the mapped image and restores the clause index from the
+ * saved positions.
+ */
+
+#define IMAGE_MAGIC "PPPI"
+#define IMAGE_VERSION 2
+
+/* writeImage - writes kb to pathname as an image; returns 0 on failure */
+int writeImage(KB *kb, const char *pathname);
+
+/* isImage - returns 1 if data starts with the image magic */
+int isImage(const char *data, size_t size);
+
+/* loadImage - builds a KB over the mapped image data, which the KB then
+ * owns; returns NULL, leaving data to the caller, if the image is damaged
+ * or of another version */
+KB *loadImage(char *data, size_t size);
+
+#endif
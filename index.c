@@ -0,0 +1,549 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Brian O'Dell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "index.h"
+#include "utils.h"
+
+static unsigned int hashKey(unsigned long long key){
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  return (unsigned int)key;
+}
+
+void initKeyTable(KeyTable *table){
+  table->count = 0;
+  table->size = 16;
+  table->keys = calloc(table->size, sizeof(unsigned long long));
+  table->values = calloc(table->size, sizeof(void *));
+}
+
+void *getKey(KeyTable *table, unsigned long long key){
+  unsigned int i = hashKey(key) & (table->size - 1);
+  while(table->keys[i]){
+    if(table->keys[i] == key) return table->values[i];
+    i = (i + 1) & (table->size - 1);
+  }
+  return NULL;
+}
+
+void putKey(KeyTable *table, unsigned long long key, void *value){
+  if((table->count + 1) * 2 > table->size){
+    unsigned long long *keys = table->keys;
+    void **values = table->values;
+    int size = table->size;
+    table->size *= 2;
+    table->count = 0;
+    table->keys = calloc(table->size, sizeof(unsigned long long));
+    table->values = calloc(table->size, sizeof(void *));
+    for(int i = 0; i<size; i++){
+      if(keys[i]) putKey(table, keys[i], values[i]);
+    }
+    free(keys);
+    free(values);
+  }
+  unsigned int i = hashKey(key) & (table->size - 1);
+  while(table->keys[i] && table->keys[i] != key){
+    i = (i + 1) & (table->size - 1);
+  }
+  if(!table->keys[i]) table->count++;
+  table->keys[i] = key;
+  table->values[i] = value;
+}
+
+static void appendPosition(PositionList *list, int position){
+  if(list->count == list->size){
+    list->size = list->size ? list->size * 2 : 4;
+    list->positions = realloc(list->positions, list->size * sizeof(int));
+  }
+  list->positions[list->count++] = position;
+}
+
+static void clearFirstArgs(Predicate *pred){
+  for(int i = 0; i<pred->firstargs.size; i++){
+    PositionList *list = pred->firstargs.values[i];
+    if(!list) continue;
+    free(list->positions);
+    free(list);
+  }
+  free(pred->firstargs.keys);
+  free(pred->firstargs.values);
+}
+
+unsigned long long termKey(Term t){
+  if(!t || termType(t) == TTVARIABLE) return 0;
+  // integers share a name, so each value takes the place of the arity
+  if(termType(t) == TTINTEGER) return ((unsigned long long)SymInteger << 32) | (unsigned int)termInteger(t);
+  return ((unsigned long long)termName(t) << 32) | (unsigned int)termArity(t);
+}
+
+static Term clauseHead(Term clause){
+  if(termType(clause) == TTCLAUSE) return termArg(clause, 0);
+  return clause;
+}
+
+ClauseIndex *newClauseIndex(void){
+  ClauseIndex *index = malloc(sizeof(ClauseIndex));
+  initKeyTable(&index->predicates);
+  index->chunks = NULL;
+  index->chunkcount = 0;
+  index->chunksize = 0;
+  index->count = 0;
+  index->chunkofbuilt = 0;
+  index->termsbuilt = 0;
+  index->stale = 0;
+  initKeyTable(&index->directives);
+  return index;
+}
+
+void freeClauseIndex(ClauseIndex **index){
+  if(!(* index)) return;
+  KeyTable *preds = &(* index)->predicates;
+  for(int i = 0; i<preds->size; i++){
+    Predicate *pred = preds->values[i];
+    if(!pred) continue;
+    free(pred->clauses);
+    free(pred->variables.positions);
+    clearFirstArgs(pred);
+    free(pred);
+  }
+  free(preds->keys);
+  free(preds->values);
+  free((* index)->directives.keys);
+  free((* index)->directives.values);
+  for(int i = 0; i<(* index)->chunkcount; i++) free((* index)->chunks[i]);
+  free((* index)->chunks);
+  if((* index)->chunkofbuilt){
+    free((* index)->chunkof.keys);
+    free((* index)->chunkof.values);
+  }
+  if((* index)->termsbuilt){
+    free((* index)->terms.keys);
+    free((* index)->terms.values);
+  }
+  free(* index);
+  (* index) = NULL;
+}
+
+static Predicate *getPredicate(ClauseIndex *index, unsigned long long key){
+  Predicate *pred = getKey(&index->predicates, key);
+  if(pred) return pred;
+  pred = malloc(sizeof(Predicate));
+  pred->key = key;
+  pred->count = 0;
+  pred->size = 4;
+  pred->clauses = malloc(pred->size * sizeof(StringList *));
+  pred->variables.positions = NULL;
+  pred->variables.count = 0;
+  pred->variables.size = 0;
+  pred->stale = 0;
+  initKeyTable(&pred->firstargs);
+  putKey(&index->predicates, key, pred);
+  return pred;
+}
+
+/* positionList - list for the first argument of clause; NULL without one */
+static PositionList *positionList(Predicate *pred, Term clause){
+  Term hed = clauseHead(clause);
+  if(!termArity(hed)) return NULL;
+  unsigned long long key = termKey(termArg(hed, 0));
+  if(!key) return &pred->variables;
+  PositionList *list = getKey(&pred->firstargs, key);
+  if(!list){
+    list = calloc(1, sizeof(PositionList));
+    putKey(&pred->firstargs, key, list);
+  }
+  return list;
+}
+
+static void addClause(Predicate *pred, StringList *clause){
+  if(pred->count == pred->size){
+    pred->size *= 2;
+    pred->clauses = realloc(pred->clauses, pred->size * sizeof(StringList *));
+  }
+  pred->clauses[pred->count++] = clause;
+  PositionList *list = positionList(pred, clause->term);
+  if(list) appendPosition(list, pred->count - 1);
+}
+
+static void refreshPositions(Predicate *pred){
+  pred->variables.count = 0;
+  clearFirstArgs(pred);
+  initKeyTable(&pred->firstargs);
+  for(int i = 0; i<pred->count; i++){
+    PositionList *list = positionList(pred, pred->clauses[i]->term);
+    if(list) appendPosition(list, i);
+  }
+  pred->stale = 0;
+}
+
+static void countTerm(ClauseIndex *index, Term t, int n){
+  if(!index->termsbuilt || !t) return;
+  uintptr_t count = (uintptr_t)getKey(&index->terms, t);
+  putKey(&index->terms, t, (void *)(count + n));
+}
+
+/* markDirective - records whether clause is a directive */
+static void markDirective(ClauseIndex *index, StringList *clause, int directive){
+  Term t = clause->term;
+  if(!t || termName(t) != SymClause || termArity(t) != 1) return;
+  putKey(&index->directives, (uintptr_t)clause, directive ? clause : NULL);
+}
+
+static void mapChunk(ClauseIndex *index, StatementChunk *chunk){
+  if(!index->chunkofbuilt) return;
+  for(int i = 0; i<chunk->count; i++){
+    putKey(&index->chunkof, (uintptr_t)chunk->statements[i], chunk);
+  }
+}
+
+/* newChunk - adds an empty chunk at i of the chunk list */
+static StatementChunk *newChunk(ClauseIndex *index, int i){
+  if(index->chunkcount == index->chunksize){
+    index->chunksize = index->chunksize ? index->chunksize * 2 : 16;
+    index->chunks = realloc(index->chunks, index->chunksize * sizeof(StatementChunk *));
+  }
+  memmove(&index->chunks[i + 1], &index->chunks[i],
+    (index->chunkcount - i) * sizeof(StatementChunk *));
+  StatementChunk *chunk = malloc(sizeof(StatementChunk));
+  chunk->count = 0;
+  index->chunks[i] = chunk;
+  index->chunkcount++;
+  return chunk;
+}
+
+/* findChunk - chunk holding position, with position made relative to it;
+ * the end of the KB is in the last chunk */
+static int findChunk(ClauseIndex *index, int *position){
+  int last = index->chunkcount - 1;
+  if(last >= 0 && *position >= index->count - index->chunks[last]->count){
+    (* position) -= index->count - index->chunks[last]->count;
+    return last;
+  }
+  int i = 0;
+  while(i<last && *position >= index->chunks[i]->count){
+    (* position) -= index->chunks[i]->count;
+    i++;
+  }
+  return i;
+}
+
+/* placeClause - adds clause at position of the statement chunks */
+static void placeClause(ClauseIndex *index, int position, StringList *clause){
+  if(!index->chunkcount) newChunk(index, 0);
+  int i = findChunk(index, &position);
+  StatementChunk *chunk = index->chunks[i];
+  if(chunk->count == CHUNK_STATEMENTS){
+    StatementChunk *next = newChunk(index, i + 1);
+    if(position == CHUNK_STATEMENTS){
+      chunk = next;
+      position = 0;
+    } else {
+      // split the full chunk in half
+      int half = CHUNK_STATEMENTS / 2;
+      memcpy(next->statements, &chunk->statements[half], half * sizeof(StringList *));
+      next->count = half;
+      chunk->count = half;
+      mapChunk(index, next);
+      if(position > half){
+        chunk = next;
+        position -= half;
+      }
+    }
+  }
+  memmove(&chunk->statements[position + 1], &chunk->statements[position],
+    (chunk->count - position) * sizeof(StringList *));
+  chunk->statements[position] = clause;
+  chunk->count++;
+  index->count++;
+  if(index->chunkofbuilt) putKey(&index->chunkof, (uintptr_t)clause, chunk);
+  countTerm(index, clause->term, 1);
+  markDirective(index, clause, 1);
+}
+
+/* clauseRank - position of clause in the KB */
+static int clauseRank(ClauseIndex *index, StringList *clause){
+  if(!index->chunkofbuilt){
+    initKeyTable(&index->chunkof);
+    index->chunkofbuilt = 1;
+    for(int i = 0; i<index->chunkcount; i++) mapChunk(index, index->chunks[i]);
+  }
+  StatementChunk *chunk = getKey(&index->chunkof, (uintptr_t)clause);
+  int rank = 0;
+  for(int i = 0; i<index->chunkcount && index->chunks[i] != chunk; i++){
+    rank += index->chunks[i]->count;
+  }
+  for(int i = 0; i<chunk->count; i++){
+    if(chunk->statements[i] == clause) return rank + i;
+  }
+  return -1;
+}
+
+static unsigned long long clauseKey(Term t){
+  if(!t) return 0;
+  return termKey(clauseHead(t));
+}
+
+/* predicateSlot - first position in pred of a clause not before rank */
+static int predicateSlot(ClauseIndex *index, Predicate *pred, int rank){
+  int lo = 0;
+  int hi = pred->count;
+  // appends are the common case
+  if(hi && clauseRank(index, pred->clauses[hi - 1]) < rank) return hi;
+  while(lo < hi){
+    int mid = (lo + hi) / 2;
+    if(clauseRank(index, pred->clauses[mid]) < rank) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+/* predicateInsert - adds clause to its predicate in KB order */
+static void predicateInsert(ClauseIndex *index, StringList *clause){
+  unsigned long long key = clauseKey(clause->term);
+  if(!key) return;
+  Predicate *pred = getPredicate(index, key);
+  int i = predicateSlot(index, pred, clauseRank(index, clause));
+  if(i == pred->count){
+    addClause(pred, clause);
+    return;
+  }
+  if(pred->count == pred->size){
+    pred->size *= 2;
+    pred->clauses = realloc(pred->clauses, pred->size * sizeof(StringList *));
+  }
+  memmove(&pred->clauses[i + 1], &pred->clauses[i], (pred->count - i) * sizeof(StringList *));
+  pred->clauses[i] = clause;
+  pred->count++;
+  pred->stale = 1;
+  index->stale = 1;
+}
+
+/* predicateRemove - takes clause, whose term is t, out of its predicate */
+static void predicateRemove(ClauseIndex *index, StringList *clause, Term t){
+  unsigned long long key = clauseKey(t);
+  Predicate *pred = key ? getKey(&index->predicates, key) : NULL;
+  if(!pred) return;
+  int i = predicateSlot(index, pred, clauseRank(index, clause));
+  if(i == pred->count || pred->clauses[i] != clause) return;
+  memmove(&pred->clauses[i], &pred->clauses[i + 1], (pred->count - i - 1) * sizeof(StringList *));
+  pred->count--;
+  pred->stale = 1;
+  index->stale = 1;
+}
+
+void recordClause(ClauseIndex *index, StringList *clause){
+  placeClause(index, index->count, clause);
+}
+
+void indexClause(ClauseIndex *index, StringList *clause){
+  recordClause(index, clause);
+  unsigned long long key = clauseKey(clause->term);
+  if(!key) return;
+  addClause(getPredicate(index, key), clause);
+}
+
+void insertClause(ClauseIndex *index, int position, StringList *clause){
+  if(position < 0 || position > index->count) return;
+  placeClause(index, position, clause);
+  predicateInsert(index, clause);
+}
+
+StringList *removeClause(ClauseIndex *index, int position){
+  if(position < 0 || position >= index->count) return NULL;
+  int i = findChunk(index, &position);
+  StatementChunk *chunk = index->chunks[i];
+  StringList *clause = chunk->statements[position];
+  predicateRemove(index, clause, clause->term);
+  memmove(&chunk->statements[position], &chunk->statements[position + 1],
+    (chunk->count - position - 1) * sizeof(StringList *));
+  chunk->count--;
+  index->count--;
+  if(!chunk->count){
+    free(chunk);
+    memmove(&index->chunks[i], &index->chunks[i + 1],
+      (index->chunkcount - i - 1) * sizeof(StatementChunk *));
+    index->chunkcount--;
+  }
+  if(index->chunkofbuilt) putKey(&index->chunkof, (uintptr_t)clause, NULL);
+  countTerm(index, clause->term, -1);
+  markDirective(index, clause, 0);
+  return clause;
+}
+
+void reindexClause(ClauseIndex *index, StringList *clause, Term old){
+  countTerm(index, old, -1);
+  countTerm(index, clause->term, 1);
+  if(getKey(&index->directives, (uintptr_t)clause)){
+    putKey(&index->directives, (uintptr_t)clause, NULL);
+  }
+  markDirective(index, clause, 1);
+  unsigned long long oldkey = clauseKey(old);
+  unsigned long long newkey = clauseKey(clause->term);
+  if(oldkey == newkey){
+    Predicate *pred = newkey ? getKey(&index->predicates, newkey) : NULL;
+    if(pred){
+      pred->stale = 1;
+      index->stale = 1;
+    }
+    return;
+  }
+  predicateRemove(index, clause, old);
+  predicateInsert(index, clause);
+}
+
+void refreshIndex(ClauseIndex *index){
+  if(!index->stale) return;
+  for(int i = 0; i<index->predicates.size; i++){
+    Predicate *pred = index->predicates.values[i];
+    if(pred && pred->stale) refreshPositions(pred);
+  }
+  index->stale = 0;
+}
+
+StringList *clauseAt(ClauseIndex *index, int position){
+  if(position < 0 || position >= index->count) return NULL;
+  int i = findChunk(index, &position);
+  return index->chunks[i]->statements[position];
+}
+
+int clauseCount(ClauseIndex *index){
+  return index->count;
+}
+
+int containsClause(ClauseIndex *index, Term t){
+  if(!index->termsbuilt){
+    initKeyTable(&index->terms);
+    index->termsbuilt = 1;
+    for(int i = 0; i<index->chunkcount; i++){
+      StatementChunk *chunk = index->chunks[i];
+      for(int j = 0; j<chunk->count; j++) countTerm(index, chunk->statements[j]->term, 1);
+    }
+  }
+  return t && getKey(&index->terms, t) != NULL;
+}
+
+Predicate *restorePredicate(ClauseIndex *index, unsigned long long key,
+  StringList **clauses, int count){
+  Predicate *pred = getPredicate(index, key);
+  if(pred->size < count){
+    pred->size = count;
+    pred->clauses = realloc(pred->clauses, pred->size * sizeof(StringList *));
+  }
+  for(int i = 0; i<count; i++) pred->clauses[i] = clauses[i];
+  pred->count = count;
+  return pred;
+}
+
+void restorePositions(Predicate *pred, unsigned long long argkey,
+  const unsigned int *positions, int count){
+  if(!count) return;
+  PositionList *list = &pred->variables;
+  if(argkey){
+    list = calloc(1, sizeof(PositionList));
+    putKey(&pred->firstargs, argkey, list);
+  }
+  list->size = count;
+  list->count = count;
+  list->positions = realloc(list->positions, count * sizeof(int));
+  for(int i = 0; i<count; i++) list->positions[i] = (int)positions[i];
+}
+
+/* positionCursor - starts cursor on the clauses of index for its key */
+static void positionCursor(ClauseCursor *cursor, KB *kb){
+  cursor->all = NULL;
+  cursor->predicate = NULL;
+  cursor->keyed = NULL;
+  cursor->keyedi = 0;
+  cursor->variablesi = 0;
+  cursor->clausesi = 0;
+  if(!cursor->key){
+    // a variable goal may match any clause
+    cursor->all = kb->statements;
+    return;
+  }
+  cursor->predicate = getKey(&kb->index->predicates, cursor->key);
+}
+
+void openClauses(KB *kb, Term goal, Term firstarg, ClauseCursor *cursor){
+  cursor->key = termKey(goal);
+  cursor->argkey = firstarg && cursor->key ? termKey(firstarg) : 0;
+  cursor->ground = cursor->argkey && termIsGround(firstarg) ? firstarg : 0;
+  cursor->rest = NULL;
+  if(kb->base){
+    cursor->rest = kb;
+    kb = kb->base;
+  }
+  positionCursor(cursor, kb);
+}
+
+/* cursorClause - next candidate of the KB the cursor is on or NULL */
+static StringList *cursorClause(ClauseCursor *cursor){
+  if(cursor->all){
+    StringList *s = cursor->all;
+    cursor->all = s->next;
+    return s;
+  }
+  Predicate *pred = cursor->predicate;
+  if(!pred) return NULL;
+  if(!cursor->argkey){
+    if(cursor->clausesi >= pred->count) return NULL;
+    return pred->clauses[cursor->clausesi++];
+  }
+  // clauses added during resolution may create the list after the cursor opened
+  if(!cursor->keyed) cursor->keyed = getKey(&pred->firstargs, cursor->argkey);
+  PositionList *keyed = cursor->keyed;
+  for(;;){
+    int kp = keyed && cursor->keyedi < keyed->count ?
+      keyed->positions[cursor->keyedi] : INT_MAX;
+    int vp = cursor->variablesi < pred->variables.count ?
+      pred->variables.positions[cursor->variablesi] : INT_MAX;
+    if(kp == INT_MAX && vp == INT_MAX) return NULL;
+    if(kp < vp){
+      cursor->keyedi++;
+      StringList *s = pred->clauses[kp];
+      // hash-consed, two ground terms unify only if they are the same term
+      if(cursor->ground && s->term){
+        Term arg = termArg(head(s->term), 0);
+        if(termIsGround(arg) && arg != cursor->ground) continue;
+      }
+      return s;
+    }
+    cursor->variablesi++;
+    return pred->clauses[vp];
+  }
+}
+
+StringList *nextClause(ClauseCursor *cursor){
+  StringList *s = cursorClause(cursor);
+  if(s || !cursor->rest) return s;
+  // the base is done, go on with the clauses of the overlay
+  positionCursor(cursor, cursor->rest);
+  cursor->rest = NULL;
+  return cursorClause(cursor);
+}
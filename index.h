@@ -0,0 +1,170 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Brian O'Dell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PPP_INDEX
+#define PPP_INDEX
+
+#include "ppp.h"
+
+/**
+ * Clause index
+ *
+ * Clauses are grouped by predicate (name/arity). Within a predicate the
+ * clauses are hashed on the name/arity of their first argument; clauses
+ * whose first argument is a variable are kept on a separate list and
+ * merged back in, so candidates are always produced in KB order.
+ */
+
+/* KeyTable - open addressing hash table from key to pointer; key 0 is empty */
+typedef struct KEY_TABLE{
+  unsigned long long *keys;
+  void **values;
+  int count;
+  int size;
+} KeyTable;
+
+/* PositionList - ascending positions in a predicate's clause list */
+typedef struct POSITION_LIST{
+  int *positions;
+  int count;
+  int size;
+} PositionList;
+
+typedef struct PREDICATE{
+  unsigned long long key;
+  StringList **clauses;
+  int count;
+  int size;
+  PositionList variables;
+  KeyTable firstargs;
+  int stale;
+} Predicate;
+
+#define CHUNK_STATEMENTS 256
+
+/* StatementChunk - a run of consecutive statements of the KB */
+typedef struct STATEMENT_CHUNK{
+  StringList *statements[CHUNK_STATEMENTS];
+  int count;
+} StatementChunk;
+
+/**
+ * The index also keeps every statement of the KB in order, in chunks of at
+ * most CHUNK_STATEMENTS, so statements are found by position without
+ * walking the list. The statement to chunk map (for positions of a given
+ * statement) and the term counts (for duplicates) are built on first use.
+ * Directives are kept in a set of their own for openTables.
+ */
+struct CLAUSE_INDEX{
+  KeyTable predicates;
+  StatementChunk **chunks;
+  int chunkcount;
+  int chunksize;
+  int count;
+  KeyTable chunkof;
+  int chunkofbuilt;
+  KeyTable terms;
+  int termsbuilt;
+  KeyTable directives;
+  int stale;
+};
+
+/* ClauseCursor - walks the candidate clauses for one goal */
+typedef struct CLAUSE_CURSOR{
+  StringList *all;
+  Predicate *predicate;
+  unsigned long long key;
+  unsigned long long argkey;
+  Term ground;          /* the goal's first argument if it is ground, else 0 */
+  PositionList *keyed;
+  int keyedi;
+  int variablesi;
+  int clausesi;
+  KB *rest;             /* overlay whose clauses follow those of its base */
+} ClauseCursor;
+
+void initKeyTable(KeyTable *table);
+
+/* getKey - value stored under key or NULL */
+void *getKey(KeyTable *table, unsigned long long key);
+
+void putKey(KeyTable *table, unsigned long long key, void *value);
+
+/* termKey - name/arity key of t, name/value for integers; 0 for variables */
+unsigned long long termKey(Term t);
+
+ClauseIndex *newClauseIndex(void);
+
+void freeClauseIndex(ClauseIndex **index);
+
+/* indexClause - adds clause after every statement of the KB */
+void indexClause(ClauseIndex *index, StringList *clause);
+
+/* recordClause - adds clause after every statement without indexing its
+ * predicate, which restorePredicate does for a KB image */
+void recordClause(ClauseIndex *index, StringList *clause);
+
+/* insertClause - adds clause at position, before the statement there */
+void insertClause(ClauseIndex *index, int position, StringList *clause);
+
+/* removeClause - takes the statement at position out of the index and
+ * returns it; NULL if there is none */
+StringList *removeClause(ClauseIndex *index, int position);
+
+/* reindexClause - updates the index after the term of clause was old */
+void reindexClause(ClauseIndex *index, StringList *clause, Term old);
+
+/* clauseAt - statement at position or NULL */
+StringList *clauseAt(ClauseIndex *index, int position);
+
+/* clauseCount - number of statements in the KB */
+int clauseCount(ClauseIndex *index);
+
+/* containsClause - 1 if some statement of the KB is t */
+int containsClause(ClauseIndex *index, Term t);
+
+/* restorePredicate - adds the predicate of key with clauses in order, as
+ * saved in a KB image; its position lists are added by restorePositions */
+Predicate *restorePredicate(ClauseIndex *index, unsigned long long key,
+  StringList **clauses, int count);
+
+/* restorePositions - sets the positions of the clauses whose first argument
+ * has key argkey, or of those whose first argument is a variable if 0 */
+void restorePositions(Predicate *pred, unsigned long long argkey,
+  const unsigned int *positions, int count);
+
+/* refreshIndex - rebuilds the position lists that edits other than appends
+ * left stale; openClauses only reads them, so call it before searching */
+void refreshIndex(ClauseIndex *index);
+
+/* openClauses - positions cursor on the clauses of kb that may match goal,
+ * those of its base first; firstarg is the current value of the goal's
+ * first argument. When it is ground, clauses whose first argument is a
+ * different ground term are skipped */
+void openClauses(KB *kb, Term goal, Term firstarg, ClauseCursor *cursor);
+
+/* nextClause - returns the next candidate or NULL */
+StringList *nextClause(ClauseCursor *cursor);
+
+#endif
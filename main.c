@@ -23,83 +23,197 @@
  */
 
 
+#include <ctype.h>
+
 #include "ppp.h"
+#include "wam.h"
+#include "table.h"
+#include "image.h"
+#include "profile.h"
 #include "utils.h"
 
-#define DEBUG
+#include <time.h>
 
 
 int continueprompt(){
   printf("\nContinue? (y/N) ");
   char buf[10];
-  fgets(buf, 9, stdin);
+  if(!fgets(buf, 9, stdin)) return 0;
   if(buf[0] == 'Y' || buf[0] == 'y') return 1;
   return 0;
 }
 
+/* runBatch - runs every query in the file at path ("-" for stdin), one per
+ * line, writing answers and a summary per query as JSON lines */
+int runBatch(Engine *engine, const char *path, int vm){
+  FILE *f = strcomp((char *)path, "-") ? fopen(path, "r") : stdin;
+  if(!f) return 0;
+  char *line;
+  while((line = readLine(f))){
+    char *text = line;
+    while(isspace((unsigned char)*text)) text++;
+    int length = strlength(text);
+    while(length > 0 && isspace((unsigned char)text[length-1])) text[--length] = '\0';
+    // blank lines and % comments are skipped
+    if(!length || text[0] == '%'){
+      freeChar(&line);
+      continue;
+    }
+    if(text[0] == '?' && text[1] == '-') text += 2;
+    engine->presentation.query++;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int parsed = runQuery(engine, text, vm);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+    printf("{\"query\":%d,\"text\":", engine->presentation.query);
+    outputJSONString(stdout, text);
+    const char *status = !parsed ? "syntax error" : engine->cyclic ? "occurs check error" :
+      engine->memory.exceeded ? "memory limit" : "ok";
+    printf(",\"status\":\"%s\",\"solutions\":%ld,\"time_ms\":%.3f,\"peak_bytes\":%lld}\n",
+      status, engine->presentation.solutions, ms, (long long)engine->memory.peaktotal);
+    if(engine->profile && parsed && !vm) writeProfileJSON(engine->profile, stdout, engine->presentation.query);
+    freeChar(&line);
+  }
+  if(f != stdin) fclose(f);
+  return 1;
+}
+
+/* parseBytes - reads a byte count with an optional K, M or G suffix; -1 if
+ * text is not one */
+static long long parseBytes(const char *text){
+  char *end;
+  long long bytes = strtoll(text, &end, 10);
+  if(end == text || bytes < 0) return -1;
+  switch(toupper((unsigned char)*end)){
+    case 'G': bytes *= 1024;
+    /* fall through */
+    case 'M': bytes *= 1024;
+    /* fall through */
+    case 'K': bytes *= 1024; end++;
+  }
+  return *end ? -1 : bytes;
+}
+
+/* readStatement - reads a line from stdin; returns it as a wff or NULL */
+static char *readStatement(void){
+  char *line = readLine(stdin);
+  char *w = line ? wff(line) : NULL;
+  freeChar(&line);
+  return w;
+}
+
+void usage(void){
+  printf("usage: ppp [--vm] [--threads N] [--max-solutions N] [--occurs-check off|on|error] [--profile] [--max-query-memory N[K|M|G]] [--queries FILE|-] [--kb] knowledgebasefile\n");
+  printf("       ppp --compile knowledgebasefile [-o imagefile]\n");
+}
+
 int main(int argc, char const *argv[])
 {
-  char buf[B_MAX_STRING_LENGTH];
-  int bufi = 0;
-
-  // Initialize Globals
-  KnowledgeBase = NULL;
-  Query = NULL;
-  Unifiers = NULL;
-  Proof = NULL;
-
-  printf("Pen & Paper Prolog\nCopyright (c) 2022 Brian O'Dell\n");
-
-  int load;
-#ifdef DEBUG
-  load = loadKB("/home/brian/dev/ppp/testkb");
-#else
-  if(argc == 0){
-    printf("usage: ppp knowledgebasefile\n");
+  char *buf = NULL;
+  int vm = 0;
+  const char *kbpath = NULL;
+  const char *queries = NULL;
+  int compile = 0;
+  const char *imagepath = NULL;
+  Engine *engine = newEngine();
+
+  for(int i = 1; i<argc; i++){
+    if(!strcomp((char *)argv[i], "--vm")){
+      vm = 1;
+    } else if(!strcomp((char *)argv[i], "--kb") && i + 1 < argc){
+      kbpath = argv[++i];
+    } else if(!strcomp((char *)argv[i], "--queries") && i + 1 < argc){
+      queries = argv[++i];
+    } else if(!strcomp((char *)argv[i], "--max-solutions") && i + 1 < argc){
+      engine->presentation.maxsolutions = atol(argv[++i]);
+    } else if(!strcomp((char *)argv[i], "--occurs-check") && i + 1 < argc){
+      const char *mode = argv[++i];
+      if(!strcomp((char *)mode, "off")) engine->occurscheck = OCCURSOFF;
+      else if(!strcomp((char *)mode, "on")) engine->occurscheck = OCCURSON;
+      else if(!strcomp((char *)mode, "error")) engine->occurscheck = OCCURSERROR;
+      else {
+        usage();
+        freeEngine(&engine);
+        return 1;
+      }
+    } else if(!strcomp((char *)argv[i], "--max-query-memory") && i + 1 < argc){
+      engine->memory.limit = parseBytes(argv[++i]);
+      if(engine->memory.limit < 0){
+        usage();
+        freeEngine(&engine);
+        return 1;
+      }
+    } else if(!strcomp((char *)argv[i], "--profile")){
+      startProfile(engine);
+    } else if(!strcomp((char *)argv[i], "--compile") && i + 1 < argc){
+      kbpath = argv[++i];
+      compile = 1;
+    } else if(!strcomp((char *)argv[i], "-o") && i + 1 < argc){
+      imagepath = argv[++i];
+    } else if(!strcomp((char *)argv[i], "--threads") && i + 1 < argc){
+      engine->presentation.threads = atoi(argv[++i]);
+    } else if(argv[i][0] == '-' && argv[i][1] == '-'){
+      usage();
+      freeEngine(&engine);
+      return 1;
+    } else if(!kbpath){
+      kbpath = argv[i];
+    }
+  }
+  if(!kbpath){
+    usage();
+    freeEngine(&engine);
     return 1;
   }
-  load = loadKB(argv[1]);
-#endif
-  if(!load){
+  engine->presentation.batch = queries != NULL;
+
+  if(!engine->presentation.batch && !compile) printf("Pen & Paper Prolog\nCopyright (c) 2022 Brian O'Dell\n");
+
+  if(!loadKB(engine, kbpath)){
     printf("\nFile Not Found\n");
+    freeEngine(&engine);
     return 1;
   }
+  KB *kb = engine->kb;
+  if(compile){
+    char *defaultpath = imagepath ? NULL : concat(kbpath, ".pppi");
+    const char *out = imagepath ? imagepath : defaultpath;
+    int written = writeImage(kb, out);
+    if(!written) fprintf(stderr, "%s: cannot write image\n", out);
+    freeChar(&defaultpath);
+    freeEngine(&engine);
+    return written ? 0 : 1;
+  }
+  if(vm) compileKB(engine);
+
+  if(engine->presentation.batch){
+    // answers are written in blocks rather than line by line
+    setvbuf(stdout, NULL, _IOFBF, 1 << 16);
+    int ran = runBatch(engine, queries, vm);
+    if(!ran) fprintf(stderr, "%s: File Not Found\n", queries);
+    freeEngine(&engine);
+    return ran ? 0 : 1;
+  }
 
   printf("\nKnowledge Base Loaded:\n");
-  printStringlist(KnowledgeBase, 0, 100);
+  printStringlist(kb->statements, 0, 100);
   printf("\n");
 
   while(1){
     printf("]");
-    fgets(buf, B_MAX_STRING_LENGTH-1, stdin);
-    bufi = strlength(buf);
-    if(bufi > 0) buf[bufi-1] = '\0';
+    freeChar(&buf);
+    if(!(buf = readLine(stdin))) break;
 
     //Quit
     if(!strcomp(buf, "quit.")) break;
 
     //Query
     if(buf[0] == '?' && buf[1] == '-'){
-      Query = wff(buf+2);
-      if(Query){
-        AbortResolution = 0;
-        WorkingKB = copyStringList(KnowledgeBase);
-        char *unifier = resolve(Query, "{ | }",1);
-        if(!unifier){
-          printf("No.\n");
-        } else {
-          if(Unifiers){
-            printf("Unifiers:\n");
-            printf("Θ = %s\n", Unifiers);
-            // printf("Proof:\n");
-            // printStringlist(Proof);
-          }
-          printStringlist(WorkingKB, 0, 100);
-        }
-        freeChar(&Query);
-        freeStringList(&Proof);
-        freeChar(&unifier);
-        freeStringList(&WorkingKB);
+      if(runQuery(engine, buf+2, vm)){
+        if(engine->cyclic) printf("Occurs check error.\n");
+        else if(engine->memory.exceeded) printf("Memory limit exceeded.\n");
+        else printf("No.\n");
       }
     }
 
@@ -110,19 +224,20 @@ int main(int argc, char const *argv[])
       StringList *slist = splitByControlChars(w);
       freeChar(&w);
       StringList *s = slist;
+      int edited = 0;       /* the command changed the KB */
 
       //List
       if(!strcomp(s->entry, "list")){
         s = s->next;
         if(s->entry[0]=='.'){
-          printStringlist(KnowledgeBase, 0, 100);
+          printStringlist(kb->statements, 0, 100);
         } else {
           s = s->next;
           int start = atoint(s->entry);
           s = s->next->next;
           int count = atoint(s->entry);
           freeStringList(&slist);
-          printStringlist(KnowledgeBase, start, count);
+          printStringlist(statementAt(kb, start), 0, count);
         }
       }
 
@@ -132,15 +247,15 @@ int main(int argc, char const *argv[])
         if(s->entry[0] != ')'){
           int index = atoint(s->entry);
           printf("Enter statement to replace statement %d:\n", index);
-          printStringlist(KnowledgeBase, index, 1);
+          printStringlist(statementAt(kb, index), 0, 1);
           printf("\n>");
-          fgets(buf, B_MAX_STRING_LENGTH-1, stdin);
-          w = wff(buf);
+          w = readStatement();
           if(!w){
             printf("syntax error.\n");
           } else {
             if(continueprompt()){
-              replaceStatement(KnowledgeBase, index, w);
+              replaceStatement(kb, index, w);
+              edited = 1;
             }
             putchar('\n');
             freeChar(&w);
@@ -154,15 +269,15 @@ int main(int argc, char const *argv[])
         if(s->entry[0] != ')'){
           int index = atoint(s->entry);
           printf("Enter statement to insert prior to statement %d:\n", index);
-          printStringlist(KnowledgeBase, index, 1);
+          printStringlist(statementAt(kb, index), 0, 1);
           printf("\n>");
-          fgets(buf, B_MAX_STRING_LENGTH-1, stdin);
-          w = wff(buf);
+          w = readStatement();
           if(!w){
             printf("syntax error.\n");
           } else {
             if(continueprompt()){
-              insertStatement(&KnowledgeBase, index, w);
+              insertStatement(kb, index, w);
+              edited = 1;
             }
             putchar('\n');
             freeChar(&w);
@@ -173,12 +288,12 @@ int main(int argc, char const *argv[])
       //Append
       if(!strcomp(s->entry, "append")){ 
         printf("Enter statement to append to KnowledgeBase:\n>");
-        fgets(buf, B_MAX_STRING_LENGTH-1, stdin);
-        w = wff(buf);
+        w = readStatement();
         if(!w){
           printf("syntax error.\n");
         } else {
-          appendStatement(KnowledgeBase, w);
+          appendStatement(kb, w);
+          edited = 1;
           freeChar(&w);
         }
       }
@@ -188,27 +303,56 @@ int main(int argc, char const *argv[])
         s = s->next->next;
         int index = atoint(s->entry);
         printf("Delete: ");
-        printStringlist(KnowledgeBase, index, 1);
+        printStringlist(statementAt(kb, index), 0, 1);
         if(continueprompt()){
-          deleteStatement(&KnowledgeBase, index);
+          deleteStatement(kb, index);
+          edited = 1;
         }
         putchar('\n');
       }
 
       //Save
       if(!strcomp(s->entry, "save")){
-        char *fname = concat(argv[1], "work");
-        if(fprintStringlist(fname, KnowledgeBase)){
+        char *fname = concat(kbpath, "work");
+        if(fprintStringlist(fname, kb->statements)){
           output("Done.\n");
         } else {
           output("KnowledgeBase not saved.\n");
         }
         freeChar(&fname);
       }
+      //Stats
+      if(!strcomp(s->entry, "stats")){
+        ArenaStats *st = &engine->arena->stats;
+        // the arena only holds the working KB; the account covers the rest
+        printf("Lemma arena of the last query: %zu allocations, %zu bytes peak, %zu releases\n",
+          st->allocations, st->peak, st->releases);
+        printAccount(&engine->memory, stdout);
+      }
+
+      //Profile
+      if(!strcomp(s->entry, "profile")){
+        if(vm){
+          printf("The VM is not profiled.\n");
+        } else if(!engine->profile){
+          startProfile(engine);
+          printf("Profiling on; queries from now on are profiled.\n");
+        } else {
+          printProfile(engine->profile, stdout);
+        }
+      }
+
+      //Code
+      if(vm && !strcomp(s->entry, "code")){
+        printWamCode(engine);
+      }
       freeStringList(&slist);
+      // an edit changes the program the VM runs
+      if(vm && edited) compileKB(engine);
     }
 
   }
-  freeStringList(&KnowledgeBase);
+  freeChar(&buf);
+  freeEngine(&engine);
   return 0;
 }
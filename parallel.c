@@ -0,0 +1,828 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Brian O'Dell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <string.h>
+
+#include "parallel.h"
+#include "index.h"
+#include "utils.h"
+
+/* TASK_ANSWERS - answers a worker may find ahead of those presented */
+#define TASK_ANSWERS 1024
+
+/* AND_DEPTH - the deepest term region groups are proved under; deeper
+ * bodies are left to the caller, as a helper is seldom free that far down
+ * and every region more slows the lookups in those below it */
+#define AND_DEPTH 8
+
+typedef struct PARALLEL_ANSWER{
+  Term q;              /* the renamed clause */
+  Term thetaq;         /* q with the answer substituted */
+  char *theta;
+} ParallelAnswer;
+
+typedef struct PARALLEL_TASK{
+  Term goal;           /* level 1 goal */
+  int alternative;     /* position of goal among the query's alternatives */
+  Term clause;         /* candidate clause, renamed by the worker */
+  int done;
+  int cut;             /* the clause's body ran a cut */
+  Cancel skipped;      /* set once an earlier clause of goal cut this one off */
+  ParallelAnswer *answers; /* answers found so far, in order */
+  int count;
+  int size;
+  int presented;       /* answers the caller has taken */
+} ParallelTask;
+
+typedef struct WORKER{
+  pthread_t thread;
+  Engine *engine;
+  TermRegion *region;  /* the terms of its proofs */
+  TermRegion *answers; /* its answers, kept until they are presented */
+  pthread_mutex_t lock;
+  int next;            /* tasks next ... end-1 are still to run */
+  int end;
+  EngineStats stats;   /* the worker's counters, added to the caller's */
+} Worker;
+
+typedef enum
+{
+  JOBQUEUED, JOBRUNNING, JOBDONE
+}JobState;
+
+typedef struct AND_JOB{
+  Term goals;          /* an independent group of body goals, substituted */
+  int level;
+  Term *vars;          /* unbound variables of goals */
+  int count;
+  Term *values;        /* what each solution found so far bound them to */
+  int solutions;
+  int size;
+  int current;         /* solution in the combination being tried */
+  Unifier *unifier;    /* bindings of the proof, kept for further solutions */
+  Resolution *resolution;
+  TermRegion *region;  /* the terms of the proof */
+  TermRegion *kept;    /* values, kept while the proof backtracks */
+  int exhausted;
+  Cancel cancel;       /* set once another group failed; nested in the caller's */
+  JobState state;
+  struct AND_JOB *next;
+} AndJob;
+
+/* BodySplit - the goals of a clause body a group may start at; each group
+ * holds a goal worth a thread, and its goals share variables with the
+ * other groups' only through the head */
+struct BODY_SPLIT{
+  int count;           /* goals in the body */
+  char *starts;        /* 1 for a goal a group may start at */
+};
+
+/* NoSplit - remembers a clause whose body is proved in one piece */
+static BodySplit NoSplit;
+
+/* Independent - the groups of a body and the solutions found for each */
+struct INDEPENDENT{
+  WorkerPool *pool;
+  AndJob *jobs;
+  int count;
+  int started;
+  int failed;          /* a group has no solution; the others are cancelled */
+};
+
+typedef struct HELPER{
+  pthread_t thread;
+  Engine *engine;
+  EngineStats stats;   /* the helper's counters, added to the caller's */
+} Helper;
+
+/* WorkerPool - the helpers of an engine's parallel query, the groups queued
+ * for them and the level 1 alternatives shared by the workers */
+struct WORKER_POOL{
+  int threads;
+  int stopping;
+  Helper *helpers;
+  int helpercount;
+  AndJob *queue;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;     /* a job was queued or the pool is stopping */
+  pthread_cond_t jobcond;  /* a job is done */
+  pthread_rwlock_t splitlock;
+  KeyTable splits;         /* clause to its BodySplit, worked out once */
+  KeyTable rules;          /* predicate to whether it has a rule */
+  ParallelTask *tasks;
+  int taskcount;
+  int tasksize;
+  Worker *workers;
+  int workercount;
+  pthread_mutex_t donelock;
+  pthread_cond_t donecond; /* a task is done */
+};
+
+static void addTask(WorkerPool *pool, Term goal, int alternative, Term clause){
+  if(pool->taskcount == pool->tasksize){
+    pool->tasksize = pool->tasksize ? pool->tasksize * 2 : 64;
+    pool->tasks = realloc(pool->tasks, pool->tasksize * sizeof(ParallelTask));
+  }
+  ParallelTask *t = &pool->tasks[pool->taskcount++];
+  t->goal = goal;
+  t->alternative = alternative;
+  t->clause = clause;
+  t->done = 0;
+  t->cut = 0;
+  t->skipped.set = 0;
+  t->answers = NULL;
+  t->count = t->size = 0;
+  t->presented = 0;
+}
+
+static void addAnswer(ParallelTask *t, Term q, Term thetaq, char *theta){
+  if(t->count == t->size){
+    t->size = t->size ? t->size * 2 : 4;
+    t->answers = realloc(t->answers, t->size * sizeof(ParallelAnswer));
+  }
+  t->answers[t->count++] = (ParallelAnswer){q, thetaq, theta};
+}
+
+/* collectTasks - lists the alternatives in the order resolve() tries them */
+static void collectTasks(Engine *engine, Term goals){
+  engine->pool->taskcount = 0;
+  Term goal = firstTerm(goals);
+  Term restgoal = restTerm(goals);
+  int alternative = 0;
+  while(goal){
+    if(isBuiltin(goal)){
+      // control goals have no clauses to share out; resolve() runs the query
+      engine->pool->taskcount = 0;
+      return;
+    }
+    Term firstarg = termArity(goal) ? termArg(goal, 0) : 0;
+    ClauseCursor cursor;
+    openClauses(engine->working, goal, firstarg, &cursor);
+    StringList *kb;
+    while((kb = nextClause(&cursor))){
+      if(kb->term) addTask(engine->pool, goal, alternative, kb->term);
+    }
+    alternative++;
+    goal = firstTerm(restgoal);
+    restgoal = restTerm(restgoal);
+  }
+}
+
+/* stealTasks - moves the back half of another worker's range to w; returns
+ * the first stolen task or -1 if every range is empty */
+static int stealTasks(Worker *w){
+  WorkerPool *pool = w->engine->pool;
+  int self = (int)(w - pool->workers);
+  for(int k = 1; k<pool->workercount; k++){
+    Worker *victim = &pool->workers[(self + k) % pool->workercount];
+    pthread_mutex_lock(&victim->lock);
+    int remaining = victim->end - victim->next;
+    int start = victim->end - (remaining + 1) / 2;
+    int end = victim->end;
+    if(remaining > 0) victim->end = start;
+    pthread_mutex_unlock(&victim->lock);
+    if(remaining <= 0) continue;
+    pthread_mutex_lock(&w->lock);
+    w->next = start + 1;
+    w->end = end;
+    pthread_mutex_unlock(&w->lock);
+    return start;
+  }
+  return -1;
+}
+
+static int takeTask(Worker *w){
+  pthread_mutex_lock(&w->lock);
+  int task = w->next < w->end ? w->next++ : -1;
+  pthread_mutex_unlock(&w->lock);
+  if(task >= 0) return task;
+  return stealTasks(w);
+}
+
+/* runTask - proves one alternative as resolve() does at level 1, keeping
+ * its answers in region answers for the caller */
+static void runTask(Engine *engine, ParallelTask *t, Unifier *unifier, TermRegion *answers){
+  WorkerPool *pool = engine->pool;
+  pthread_mutex_lock(&pool->donelock);
+  int skipped = t->skipped.set;
+  pthread_mutex_unlock(&pool->donelock);
+  int cut = 0;
+  Term q = 0;
+  Term keptq = 0;
+  if(!skipped){
+    Stats.steps++;
+    q = renameClause(engine, t->goal, t->clause, unifier);
+  }
+  if(q && unify(t->goal, head(q), unifier)){
+    Resolution *r = openResolution(engine, body(q), unifier, 2);
+    // a cut off task unwinds at its next goal, answers or not
+    watchCancel(r, &t->skipped);
+    while(nextSolution(r)){
+      Term thetaq = substitute(q, unifier);
+      if(!termIsGround(thetaq) && !cyclesOnly(thetaq, unifier)) continue;
+      char *theta = engine->presentation.quiet ? NULL : unifierToString(unifier);
+      // the worker releases thetaq as it backtracks, before it is presented
+      TermRegion *work = useTermRegion(answers);
+      if(!keptq) keptq = importTerm(q);
+      thetaq = importTerm(thetaq);
+      useTermRegion(work);
+      pthread_mutex_lock(&pool->donelock);
+      while(t->count - t->presented >= TASK_ANSWERS && !engine->abort && !t->skipped.set){
+        pthread_cond_wait(&pool->donecond, &pool->donelock);
+      }
+      skipped = t->skipped.set;
+      if(skipped) freeChar(&theta);
+      else addAnswer(t, keptq, thetaq, theta);
+      pthread_cond_broadcast(&pool->donecond);
+      pthread_mutex_unlock(&pool->donelock);
+      if(engine->abort || skipped) break;
+    }
+    cut = resolutionCut(r);
+    closeResolution(&r);
+  }
+  undoBindings(unifier, 0);
+  pthread_mutex_lock(&pool->donelock);
+  t->cut = cut;
+  t->done = 1;
+  pthread_cond_broadcast(&pool->donecond);
+  pthread_mutex_unlock(&pool->donelock);
+}
+
+static void *runWorker(void *arg){
+  Worker *w = arg;
+  Engine *engine = w->engine;
+  Account = &engine->memory;
+  useTermRegion(w->region);
+  Unifier *unifier = newUnifier();
+  unifier->occurs = engine->occurscheck;
+  int task;
+  while(!engine->abort && (task = takeTask(w)) >= 0){
+    runTask(engine, &engine->pool->tasks[task], unifier, w->answers);
+  }
+  // after an abort the tasks left are never done; wake the caller
+  pthread_mutex_lock(&engine->pool->donelock);
+  pthread_cond_broadcast(&engine->pool->donecond);
+  pthread_mutex_unlock(&engine->pool->donelock);
+  freeUnifier(&unifier);
+  useTermRegion(NULL);
+  closeAccount();
+  w->stats = Stats;
+  return NULL;
+}
+
+void resolveParallel(Engine *engine, Term goals, Unifier *unifier){
+  WorkerPool *pool = engine->pool;
+  collectTasks(engine, goals);
+  if(pool->taskcount < 2 || pool->threads < 2){
+    resolve(engine, goals, unifier, 1);
+    return;
+  }
+  pool->workercount = pool->threads < pool->taskcount ? pool->threads : pool->taskcount;
+  pool->workers = malloc(pool->workercount * sizeof(Worker));
+  for(int i = 0; i<pool->workercount; i++){
+    Worker *w = &pool->workers[i];
+    w->engine = engine;
+    // the caller adds no terms until the workers are done
+    w->region = openTermRegion(termRegion());
+    w->answers = openTermRegion(termRegion());
+    pthread_mutex_init(&w->lock, NULL);
+    w->next = (int)((long)pool->taskcount * i / pool->workercount);
+    w->end = (int)((long)pool->taskcount * (i + 1) / pool->workercount);
+  }
+  for(int i = 0; i<pool->workercount; i++){
+    pthread_create(&pool->workers[i].thread, NULL, runWorker, &pool->workers[i]);
+  }
+  int stop = 0;
+  for(int i = 0; i<pool->taskcount && !stop; i++){
+    ParallelTask *t = &pool->tasks[i];
+    for(;;){
+      pthread_mutex_lock(&pool->donelock);
+      while(t->presented == t->count && !t->done && !engine->abort){
+        pthread_cond_wait(&pool->donecond, &pool->donelock);
+      }
+      int more = t->presented < t->count && !engine->abort;
+      ParallelAnswer a = more ? t->answers[t->presented] : (ParallelAnswer){0, 0, NULL};
+      if(!more && t->cut){
+        // as in resolve(), a cut leaves the goal's later clauses untried
+        for(int k = i + 1; k<pool->taskcount && pool->tasks[k].alternative == t->alternative; k++){
+          pool->tasks[k].skipped.set = 1;
+          i = k;
+        }
+        pthread_cond_broadcast(&pool->donecond);
+      }
+      pthread_mutex_unlock(&pool->donelock);
+      if(!more) break;
+      stop = presentAnswerText(engine, a.theta, a.q, a.thetaq);
+      pthread_mutex_lock(&pool->donelock);
+      t->presented++;
+      // the last answer wanted is enough; the workers stop at their next goal
+      if(stop) engine->abort = 1;
+      pthread_cond_broadcast(&pool->donecond);
+      pthread_mutex_unlock(&pool->donelock);
+      if(stop) break;
+    }
+  }
+  for(int i = 0; i<pool->workercount; i++) pthread_join(pool->workers[i].thread, NULL);
+  for(int i = 0; i<pool->workercount; i++){
+    pthread_mutex_destroy(&pool->workers[i].lock);
+    closeTermRegion(&pool->workers[i].region);
+    closeTermRegion(&pool->workers[i].answers);
+    Stats.steps += pool->workers[i].stats.steps;
+    Stats.unifications += pool->workers[i].stats.unifications;
+  }
+  for(int i = 0; i<pool->taskcount; i++){
+    ParallelTask *t = &pool->tasks[i];
+    for(int k = 0; k<t->count; k++) freeChar(&t->answers[k].theta);
+    free(t->answers);
+  }
+  free(pool->workers);
+  pool->workers = NULL;
+  pool->workercount = 0;
+  free(pool->tasks);
+  pool->tasks = NULL;
+  pool->taskcount = pool->tasksize = 0;
+}
+
+/* moreSolutions - resumes the proof of j for its next solution and keeps
+ * what it binds the variables of j to; 0 once there are no more */
+static int moreSolutions(AndJob *j){
+  if(j->exhausted) return 0;
+  TermRegion *previous = useTermRegion(j->region);
+  if(!nextSolution(j->resolution)){
+    j->exhausted = 1;
+    useTermRegion(previous);
+    return 0;
+  }
+  if(j->solutions == j->size){
+    j->size = j->size ? j->size * 2 : 4;
+    j->values = realloc(j->values, j->size * (j->count ? j->count : 1) * sizeof(Term));
+  }
+  Term *values = &j->values[j->solutions * j->count];
+  for(int i = 0; i<j->count; i++){
+    Term value = substitute(j->vars[i], j->unifier);
+    // the proof releases its terms when it backtracks for the next solution
+    useTermRegion(j->kept);
+    values[i] = importTerm(value);
+    useTermRegion(j->region);
+  }
+  j->solutions++;
+  useTermRegion(previous);
+  return 1;
+}
+
+/* runJob - starts the proof of a group with its own unifier and finds its
+ * first solution */
+static void runJob(Engine *engine, AndJob *j){
+  j->unifier = newUnifier();
+  j->unifier->occurs = engine->occurscheck;
+  j->resolution = openResolution(engine, j->goals, j->unifier, j->level);
+  watchCancel(j->resolution, &j->cancel);
+  moreSolutions(j);
+}
+
+static void *runHelper(void *arg){
+  Helper *helper = arg;
+  WorkerPool *pool = helper->engine->pool;
+  Account = &helper->engine->memory;
+  pthread_mutex_lock(&pool->lock);
+  while(!pool->stopping){
+    AndJob *j = pool->queue;
+    if(!j){
+      pthread_cond_wait(&pool->cond, &pool->lock);
+      continue;
+    }
+    pool->queue = j->next;
+    j->state = JOBRUNNING;
+    pthread_mutex_unlock(&pool->lock);
+    runJob(helper->engine, j);
+    pthread_mutex_lock(&pool->lock);
+    j->state = JOBDONE;
+    pthread_cond_broadcast(&pool->jobcond);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  closeAccount();
+  helper->stats = Stats;
+  return NULL;
+}
+
+void openParallel(Engine *engine, int threads){
+  WorkerPool *pool = calloc(1, sizeof(WorkerPool));
+  pool->threads = threads;
+  pool->helpercount = threads - 1;
+  pool->helpers = malloc(pool->helpercount * sizeof(Helper));
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->cond, NULL);
+  pthread_cond_init(&pool->jobcond, NULL);
+  pthread_mutex_init(&pool->donelock, NULL);
+  pthread_cond_init(&pool->donecond, NULL);
+  pthread_rwlock_init(&pool->splitlock, NULL);
+  initKeyTable(&pool->splits);
+  initKeyTable(&pool->rules);
+  engine->pool = pool;
+  shareTermStore(1);
+  shareAccount(&engine->memory, 1);
+  for(int i = 0; i<pool->helpercount; i++){
+    pool->helpers[i].engine = engine;
+    pthread_create(&pool->helpers[i].thread, NULL, runHelper, &pool->helpers[i]);
+  }
+}
+
+void closeParallel(Engine *engine){
+  WorkerPool *pool = engine->pool;
+  if(!pool) return;
+  pthread_mutex_lock(&pool->lock);
+  pool->stopping = 1;
+  pthread_cond_broadcast(&pool->cond);
+  pthread_mutex_unlock(&pool->lock);
+  for(int i = 0; i<pool->helpercount; i++){
+    pthread_join(pool->helpers[i].thread, NULL);
+    Stats.steps += pool->helpers[i].stats.steps;
+    Stats.unifications += pool->helpers[i].stats.unifications;
+  }
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->cond);
+  pthread_cond_destroy(&pool->jobcond);
+  pthread_mutex_destroy(&pool->donelock);
+  pthread_cond_destroy(&pool->donecond);
+  pthread_rwlock_destroy(&pool->splitlock);
+  for(int i = 0; i<pool->splits.size; i++){
+    BodySplit *split = pool->splits.values[i];
+    if(pool->splits.keys[i] && split != &NoSplit){
+      free(split->starts);
+      free(split);
+    }
+  }
+  free(pool->splits.keys);
+  free(pool->splits.values);
+  free(pool->rules.keys);
+  free(pool->rules.values);
+  free(pool->helpers);
+  free(pool);
+  engine->pool = NULL;
+  shareTermStore(0);
+  shareAccount(&engine->memory, 0);
+}
+
+int parallelOpen(Engine *engine){
+  return engine->pool != NULL;
+}
+
+/* addVariables - adds the variables of t not yet in vars */
+static void addVariables(Term t, Term **vars, int *count, int *size){
+  TermStack pending;
+  initTermStack(&pending);
+  for(;;){
+    if(termType(t) == TTVARIABLE){
+      int i = 0;
+      while(i<(* count) && (* vars)[i] != t) i++;
+      if(i == (* count)){
+        if((* count) == (* size)){
+          (* size) = (* size) ? (* size) * 2 : 8;
+          (* vars) = realloc(* vars, (* size) * sizeof(Term));
+        }
+        (* vars)[(* count)++] = t;
+      }
+    } else if(!termIsGround(t)){
+      for(int i = termArity(t) - 1; i>=0; i--) PUSH_TERM(&pending, termArg(t, i));
+    }
+    if(!pending.count) break;
+    t = pending.items[--pending.count];
+  }
+  freeTermStack(&pending);
+}
+
+/* conjunction - joins goals first ... end-1 back into one conjunction */
+static Term conjunction(Term *goals, int first, int end){
+  Term t = 0;
+  for(int i = end - 1; i>=first; i--){
+    if(!t){
+      t = goals[i];
+    } else {
+      Term args[2] = {goals[i], t};
+      t = functorTerm(SymConjunction, 2, args);
+    }
+  }
+  return t;
+}
+
+/* takeBack - removes j from the queue if no helper has started it */
+static int takeBack(WorkerPool *pool, AndJob *j){
+  pthread_mutex_lock(&pool->lock);
+  int queued = j->state == JOBQUEUED;
+  if(queued){
+    AndJob **p = &pool->queue;
+    while((* p) != j) p = &(* p)->next;
+    (* p) = j->next;
+    j->state = JOBRUNNING;
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return queued;
+}
+
+static void waitJob(WorkerPool *pool, AndJob *j){
+  pthread_mutex_lock(&pool->lock);
+  while(j->state != JOBDONE) pthread_cond_wait(&pool->jobcond, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+/* waitGroups - waits for the helpers' groups until they are all done or
+ * one of them has failed; returns 1 if all have a solution */
+static int waitGroups(WorkerPool *pool, AndJob *jobs, int count){
+  pthread_mutex_lock(&pool->lock);
+  int proved;
+  for(;;){
+    int pending = 0;
+    proved = 1;
+    for(int j = 0; j<count; j++){
+      if(jobs[j].state != JOBDONE) pending = 1;
+      else if(!jobs[j].solutions) proved = 0;
+    }
+    if(!proved || !pending) break;
+    pthread_cond_wait(&pool->jobcond, &pool->lock);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return proved;
+}
+
+/* bodyGoals - the goals of the conjunction bdy, in order */
+static Term *bodyGoals(Term bdy, int *count){
+  (* count) = 0;
+  for(Term g = bdy; g; g = restTerm(g)) (* count)++;
+  Term *goals = malloc((* count) * sizeof(Term));
+  int i = 0;
+  for(Term g = bdy; g; g = restTerm(g)) goals[i++] = firstTerm(g);
+  return goals;
+}
+
+/* separates - 1 if goals before b and those from b on share no variable
+ * but the count in shared */
+static int separates(Term *goals, int n, int b, Term *shared, int count){
+  Term *before = NULL, *after = NULL;
+  int beforecount = 0, aftercount = 0, size = 0;
+  for(int i = 0; i<b; i++) addVariables(goals[i], &before, &beforecount, &size);
+  size = 0;
+  for(int i = b; i<n; i++) addVariables(goals[i], &after, &aftercount, &size);
+  int separate = 1;
+  for(int i = 0; i<beforecount && separate; i++){
+    int k = 0;
+    while(k<aftercount && after[k] != before[i]) k++;
+    if(k == aftercount) continue;
+    k = 0;
+    while(k<count && shared[k] != before[i]) k++;
+    separate = k < count;
+  }
+  free(before);
+  free(after);
+  return separate;
+}
+
+/* worthThread - 1 if goal may run long enough to be worth a thread: it
+ * calls a predicate with a rule. Builtins, arithmetic and facts are proved
+ * by the thread that meets them. Called with splitlock held for writing. */
+static int worthThread(Engine *engine, Term goal){
+  static char rule, norule;
+  if(termType(goal) == TTVARIABLE || isBuiltin(goal)) return 0;
+  WorkerPool *pool = engine->pool;
+  unsigned long long key = termKey(goal);
+  void *known = getKey(&pool->rules, key);
+  if(!known){
+    known = &norule;
+    ClauseCursor cursor;
+    openClauses(engine->working, goal, 0, &cursor);
+    StringList *kb;
+    while((kb = nextClause(&cursor))){
+      if(kb->term && body(kb->term)){
+        known = &rule;
+        break;
+      }
+    }
+    putKey(&pool->rules, key, known);
+  }
+  return known == &rule;
+}
+
+/* splitGoals - marks in starts the goals of a body a group may start at
+ * and returns the number of groups. A group ends only where the goals on
+ * either side share no variable but those of head, any if head is 0, and
+ * once it holds a goal worth a thread; a body with a cut is not split, as
+ * the cut prunes the goals before it. Called with splitlock held for
+ * writing. */
+static int splitGoals(Engine *engine, Term head, Term *goals, int n, char *starts){
+  Term *headvars = NULL;
+  int headcount = 0, size = 0;
+  if(head) addVariables(head, &headvars, &headcount, &size);
+  int groups = 1;
+  int worthy = 0;
+  int last = 0;
+  for(int i = 0; i<n; i++) starts[i] = 0;
+  for(int i = 0; i<n; i++){
+    if(termType(goals[i]) == TTATOM && termName(goals[i]) == SymCut){
+      for(int k = 0; k<n; k++) starts[k] = 0;
+      groups = 1;
+      break;
+    }
+    if(i && worthy && (!head || separates(goals, n, i, headvars, headcount))){
+      starts[i] = 1;
+      last = i;
+      groups++;
+      worthy = 0;
+    }
+    worthy = worthy || worthThread(engine, goals[i]);
+  }
+  if(groups > 1 && !worthy){
+    // the goals after the last worthy one stay with it
+    starts[last] = 0;
+    groups--;
+  }
+  free(headvars);
+  return groups;
+}
+
+BodySplit *clauseSplit(Engine *engine, Term clause){
+  WorkerPool *pool = engine->pool;
+  pthread_rwlock_rdlock(&pool->splitlock);
+  BodySplit *split = getKey(&pool->splits, clause);
+  pthread_rwlock_unlock(&pool->splitlock);
+  if(!split){
+    pthread_rwlock_wrlock(&pool->splitlock);
+    split = getKey(&pool->splits, clause);
+    if(!split){
+      int count;
+      Term *goals = bodyGoals(body(clause), &count);
+      char *starts = malloc(count);
+      if(splitGoals(engine, head(clause), goals, count, starts) > 1){
+        split = malloc(sizeof(BodySplit));
+        split->count = count;
+        split->starts = starts;
+      } else {
+        free(starts);
+        split = &NoSplit;
+      }
+      free(goals);
+      putKey(&pool->splits, clause, split);
+    }
+    pthread_rwlock_unlock(&pool->splitlock);
+  }
+  return split == &NoSplit ? NULL : split;
+}
+
+Independent *openIndependent(Engine *engine, BodySplit *split, Term goals, Unifier *unifier, int level, Cancel *cancel){
+  WorkerPool *pool = engine->pool;
+  if(pool->helpercount < 1 || termRegionDepth() >= AND_DEPTH) return NULL;
+  int count;
+  Term *bound = bodyGoals(goals, &count);
+  // a variable goal instantiated to a conjunction adds goals to the split's
+  if(split && split->count != count){
+    free(bound);
+    return NULL;
+  }
+  char *starts = malloc(count);
+  int groupcount = 0;
+  if(split){
+    memcpy(starts, split->starts, count);
+    for(int i = 0; i<count; i++) groupcount += starts[i];
+    groupcount++;
+  } else {
+    pthread_rwlock_wrlock(&pool->splitlock);
+    groupcount = splitGoals(engine, 0, bound, count, starts);
+    pthread_rwlock_unlock(&pool->splitlock);
+  }
+  // the groups must share no unbound variable as the goals are now
+  for(int i = 0; i<count; i++) bound[i] = substitute(bound[i], unifier);
+  for(int i = 1; i<count && groupcount > 1; i++){
+    if(starts[i] && !separates(bound, count, i, NULL, 0)){
+      starts[i] = 0;
+      groupcount--;
+    }
+  }
+  Independent *independent = NULL;
+  if(groupcount > 1){
+    independent = calloc(1, sizeof(Independent));
+    independent->pool = pool;
+    independent->count = groupcount;
+    independent->jobs = calloc(groupcount, sizeof(AndJob));
+    int first = 0;
+    for(int j = 0; j<groupcount; j++){
+      int end = first + 1;
+      while(end < count && !starts[end]) end++;
+      AndJob *job = &independent->jobs[j];
+      job->goals = conjunction(bound, first, end);
+      job->level = level;
+      job->cancel.outer = cancel;
+      int size = 0;
+      for(int k = first; k<end; k++) addVariables(bound[k], &job->vars, &job->count, &size);
+      first = end;
+    }
+  }
+  free(starts);
+  free(bound);
+  if(!independent) return NULL;
+
+  // every group but the first goes to the helpers; the first stays here.
+  // This thread adds no terms to its own region until all are done.
+  AndJob *jobs = independent->jobs;
+  for(int j = 0; j<groupcount; j++){
+    jobs[j].region = openTermRegion(termRegion());
+    jobs[j].kept = openTermRegion(termRegion());
+  }
+  pthread_mutex_lock(&pool->lock);
+  AndJob **tail = &pool->queue;
+  while(* tail) tail = &(* tail)->next;
+  for(int j = 1; j<groupcount; j++){
+    jobs[j].state = JOBQUEUED;
+    jobs[j].next = NULL;
+    (* tail) = &jobs[j];
+    tail = &jobs[j].next;
+  }
+  pthread_cond_broadcast(&pool->cond);
+  pthread_mutex_unlock(&pool->lock);
+
+  jobs[0].state = JOBDONE;
+  runJob(engine, &jobs[0]);
+  int proved = jobs[0].solutions > 0;
+  for(int j = 1; j<groupcount; j++){
+    AndJob *job = &jobs[j];
+    if(takeBack(pool, job)){
+      // run it here rather than wait for a helper; skip it once a group failed
+      if(proved) runJob(engine, job);
+      else job->exhausted = 1;
+      job->state = JOBDONE;
+      proved = proved && job->solutions > 0;
+    }
+  }
+  proved = proved && waitGroups(pool, jobs + 1, groupcount - 1);
+  if(!proved){
+    // a group that may never end is stopped rather than waited for here;
+    // closeIndependent waits for it to unwind
+    independent->failed = 1;
+    for(int j = 0; j<groupcount; j++) jobs[j].cancel.set = 1;
+  }
+  return independent;
+}
+
+int nextIndependent(Independent *independent, Unifier *unifier){
+  AndJob *jobs = independent->jobs;
+  int i;
+  if(!independent->started){
+    independent->started = 1;
+    // every group has a solution unless one failed
+    if(independent->failed) return 0;
+  } else {
+    // the last group varies fastest, as its goals would be retried first
+    for(i = independent->count - 1; i>=0; i--){
+      if(jobs[i].current + 1 < jobs[i].solutions || moreSolutions(&jobs[i])) break;
+      jobs[i].current = 0;
+    }
+    if(i < 0) return 0;
+    jobs[i].current++;
+  }
+  for(i = 0; i<independent->count; i++){
+    AndJob *job = &jobs[i];
+    Term *values = &job->values[job->current * job->count];
+    for(int k = 0; k<job->count; k++){
+      if(values[k] != job->vars[k]) bind(unifier, job->vars[k], importTerm(values[k]));
+    }
+  }
+  return 1;
+}
+
+void closeIndependent(Independent **independent){
+  if(!(* independent)) return;
+  WorkerPool *pool = (* independent)->pool;
+  for(int i = 0; i<(* independent)->count; i++){
+    AndJob *job = &(* independent)->jobs[i];
+    if(takeBack(pool, job)) job->state = JOBDONE;
+    waitJob(pool, job);
+    closeResolution(&job->resolution);
+    freeUnifier(&job->unifier);
+    closeTermRegion(&job->region);
+    closeTermRegion(&job->kept);
+    free(job->vars);
+    free(job->values);
+  }
+  free((* independent)->jobs);
+  free(* independent);
+  (* independent) = NULL;
+}
@@ -0,0 +1,101 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Brian O'Dell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PPP_PARALLEL
+#define PPP_PARALLEL
+
+#include "ppp.h"
+
+/**
+ * OR-parallel resolution
+ *
+ * Every (goal, candidate clause) pair of a level 1 query is an alternative
+ * that does not depend on the others, so they are handed to a pool of
+ * worker threads. Each worker owns a range of alternatives, runs them from
+ * the front with its own unifier and, once its range is empty, steals the
+ * back half of another worker's range. The calling thread presents the
+ * answers in the order the sequential resolver would, taking each as soon
+ * as its worker finds it; a worker stays at most TASK_ANSWERS answers ahead
+ * of the caller. Stopping the query cancels every worker.
+ *
+ * AND-parallel resolution
+ *
+ * When a rule body is entered, its goals are cut into groups of adjacent
+ * goals that share no unbound variable, each holding a goal worth a thread:
+ * a call of a predicate with a rule rather than a builtin, arithmetic or a
+ * fact. Where a clause body may be cut is worked out from the clause the
+ * first time it is entered; each time, the cuts whose goals have come to
+ * share a variable are dropped. A body with fewer than two groups is
+ * proved as it is, without instantiating it. The first group is proved by
+ * the calling thread; the others are queued for a pool of helper threads,
+ * each proving its group with its own unifier. A group no helper has
+ * started by the time the caller needs it is taken back and proved by the
+ * caller, so nested bodies never wait on each other. The groups cannot
+ * affect each other's answers, so the solutions of the body are every
+ * combination of theirs: each proof stops at its first solution and is
+ * resumed, on the caller's thread, only when backtracking asks for more.
+ * As the groups are adjacent, the last varying fastest, combinations come
+ * in the order the sequential resolver finds them.
+ *
+ * Workers only read the knowledge base, so lemmas are not recorded while
+ * a query runs in parallel.
+ */
+
+/* openParallel - shares the term store and starts threads - 1 helpers */
+void openParallel(Engine *engine, int threads);
+
+/* closeParallel - stops the helpers and adds their stats to the caller's */
+void closeParallel(Engine *engine);
+
+/* parallelOpen - returns 1 between openParallel and closeParallel */
+int parallelOpen(Engine *engine);
+
+/* resolveParallel - resolve(engine, goals, unifier, 1) spread over the workers */
+void resolveParallel(Engine *engine, Term goals, Unifier *unifier);
+
+/* Independent - the independent groups of a body being proved */
+typedef struct INDEPENDENT Independent;
+
+/* BodySplit - where the body of a clause may be cut into groups */
+typedef struct BODY_SPLIT BodySplit;
+
+/* clauseSplit - the split of the body of KB clause, worked out on its
+ * first call; NULL if the body is not worth proving in groups */
+BodySplit *clauseSplit(Engine *engine, Term clause);
+
+/* openIndependent - proves the groups of the body goals at level
+ * concurrently up to their first solutions, stopping them all once one
+ * fails or cancel is set. split is that of the clause goals instantiates
+ * the body of, or NULL if goals are no clause's and are split as they
+ * are. NULL if goals form one group, which is left to the caller. */
+Independent *openIndependent(Engine *engine, BodySplit *split, Term goals, Unifier *unifier, int level, Cancel *cancel);
+
+/* nextIndependent - binds the next combination of the groups' solutions in
+ * unifier; 0 when there is none left */
+int nextIndependent(Independent *independent, Unifier *unifier);
+
+/* closeIndependent - ends the proofs of the groups and frees independent */
+void closeIndependent(Independent **independent);
+
+#endif
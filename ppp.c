@@ -32,26 +32,97 @@
  *    - loop for user-entered query; "quit." to exit
  *    - tested with Mary Likes Wine, Implication, and Ackermann algorithm
  *    - Manual Garbage Collection fully implemented; verified with Valgrind
+ * 
+ * Version 0.2
+ *    - KB entries and queries parsed once into hash-consed terms (term.c);
+ *      unify, substitute and resolve work on term handles
+ *    - Θ is a binding store with a trail (unifier.c); alternatives undo
+ *      their bindings instead of copying and composing unifier strings
+ *    - per-query arena (arena.c) holds WorkingKB and lemmas; each resolution
+ *      level releases the terms of a failed alternative
+ *    - ":- table name/arity." directive; tabled goals are answered from
+ *      answer tables filled to a fixpoint (table.c)
+ *    - --vm compiles the KB to WAM instructions and runs queries on an
+ *      abstract machine (wam.c); this interpreter remains the reference
+ *    - the state of a query lives in an Engine rather than in globals, so
+ *      a process may run several; everything but main.c builds as libppp
+ *    - resolve loops over a frame stack and a choicepoint stack instead of
+ *      recursing, and a rule's last goal reuses its frame, so proofs are
+ *      not limited by the C stack
+ *    - terms are parsed, printed, unified, copied and compiled with stacks
+ *      of their own too, so they may nest as deeply as memory allows
+ *    - failing a goal retries the goals before it through a choicepoint
+ *      stack, so rule bodies have all their solutions; tabled evaluation and
+ *      the parallel workers resume the same proofs for further answers
+ *    - ! and once/1 prune the search; integers are terms of their own and
+ *      is/2 and the comparisons evaluate arithmetic in C (arith.c)
+ *    - the occurs check (off, on or error) keeps a variable from being bound
+ *      to a term containing it, skipping terms whose variables are unbound
+ *    - --profile counts the ports and time of each predicate (profile.c)
+ *    - queries account for the memory they hold and stop at
+ *      --max-query-memory (account.c)
+ *    - each query, parallel worker and group of goals adds its terms to a
+ *      region of the term store that is given back as it ends, so engines
+ *      and threads sharing the store no longer keep every term
+ *    - below the query's own clause, the variables of a clause are bound
+ *      in the environment of its body's frame instead of renaming the
+ *      clause, and arithmetic in a body reads them from there
  */
 
 
 #include <stdio.h>
 #include <ctype.h>
+#include <limits.h>
+#include <string.h>
+#include <pthread.h>
 
 #include "ppp.h"
+#include "index.h"
+#include "table.h"
+#include "wam.h"
+#include "parallel.h"
+#include "image.h"
+#include "arith.h"
+#include "profile.h"
 #include "utils.h"
 
-typedef enum 
-{
-  TTVARIABLE, TTATOM, TTFUNCTOR, TTCONJUNCTION, TTCLAUSE, TTCONTROLCHAR
-}TermType;
+_Thread_local EngineStats Stats;
+
+/* Engines - engines alive; the term store is created with the first and
+ * shared between threads while there is more than one */
+static int Engines = 0;
+static pthread_mutex_t EngineLock = PTHREAD_MUTEX_INITIALIZER;
 
-StringList *KnowledgeBase;
-StringList *WorkingKB;
-char *Query;
-char *Unifiers;
-StringList *Proof;
-int AbortResolution;
+Engine *newEngine(void){
+  pthread_mutex_lock(&EngineLock);
+  if(!Engines) initTermStore();
+  else shareTermStore(1);
+  Engines++;
+  pthread_mutex_unlock(&EngineLock);
+  Engine *engine = calloc(1, sizeof(Engine));
+  engine->arena = newArena(64 * 1024);
+  engine->occurscheck = OCCURSON;
+  return engine;
+}
+
+void freeEngine(Engine **engine){
+  if(!(* engine)) return;
+  freeWam(* engine);
+  closeTables(* engine);
+  stopProfile(* engine);
+  freeKB(&(* engine)->kb);
+  freeArena(&(* engine)->arena);
+  freeChar(&(* engine)->query);
+  freeChar(&(* engine)->unifiers);
+  freeStringList(&(* engine)->proof);
+  free(* engine);
+  (* engine) = NULL;
+  pthread_mutex_lock(&EngineLock);
+  Engines--;
+  if(!Engines) freeTermStore();
+  else shareTermStore(0);
+  pthread_mutex_unlock(&EngineLock);
+}
 
 int isControlChar(char c){
   return (c == '(' || c == ')' || c == ',' || c == ':' || 
@@ -61,6 +132,7 @@ int isControlChar(char c){
 StringList *newStringList(){
   StringList *slist = malloc(sizeof(StringList));
   slist->entry = NULL;
+  slist->term = 0;
   slist->next = NULL;
   return slist;
 }
@@ -71,12 +143,6 @@ void freeChar(char **charptr){
   (* charptr) = NULL;
 }
 
-void freeUnifier(char **unifier){
-  if(!(* unifier)) return;
-  if((* unifier)[0] == '{') freeChar(unifier);
-  return;
-}
-
 void freeStringList(StringList **list){
   StringList *next = NULL;
   while(* list){
@@ -92,80 +158,28 @@ StringList *splitByControlChars(char *str){
   if(!str) return NULL;
   if(str[0] == '\0') return NULL;
   StringList *t1 = NULL;
-  StringList *tn = NULL;
-  StringList *tp = NULL;
-  char buf[B_MAX_STRING_LENGTH];
-  buf[0] = '\0'; 
-  buf[1] = '\0'; 
-  int bufi = 0;
+  StringList **tn = &t1;
   int length = strlength(str);
- for(int i = 0; i<length; i++){
-    char c = str[i];
-    buf[bufi++] = c;
-    if(isControlChar(c)){
-      if(buf[1] == '\0' && bufi == 1){
-        // add this control character to string list
-        if(c == ':' && str[i+1] == '-'){
-          i++;
-          buf[bufi++] = '-';
-        } 
-        buf[bufi] = '\0';
-      } else {
-        // add a variable, atom, or functor identifier to string list
-        i--;
-        buf[bufi - 1] = '\0';
-      }
-      if(!t1){
-        t1 = malloc(sizeof(StringList));
-        t1->entry = NULL;
-        t1->next = NULL;
-        tn = t1;
-      }
-      tn->entry = malloc(strlength(buf)+1);
-      strcopy(buf, tn->entry);
-      tp = tn;
-      tn = malloc(sizeof(StringList));
-      tn->entry = NULL;
-      tn->next = NULL;
-      tp->next = tn;
-      bufi = 0;  
-      buf[0] = '\0'; 
-      buf[1] = '\0'; 
+  int start = 0;
+  for(int i = 0; i<length; i++){
+    if(!isControlChar(str[i])) continue;
+    // a variable, atom, or functor identifier ends at the control character
+    int end = i;
+    if(i == start){
+      // the control character is a token of its own
+      end = str[i] == ':' && str[i+1] == '-' ? i + 2 : i + 1;
     }
+    (* tn) = newStringList();
+    (* tn)->entry = malloc(end - start + 1);
+    memcpy((* tn)->entry, str + start, end - start);
+    (* tn)->entry[end - start] = '\0';
+    tn = &(* tn)->next;
+    start = end;
+    i = end - 1;
   }
-  tp->next = NULL;
-  freeStringList(&tn);
   return t1;
 }
 
-char *joinStringList(StringList *list){
-  int buflength = 1000;
-  char *buf = malloc(buflength);
-  int bufi = 0;
-  int length = 0;
-
-  while(list){
-    length = strlength(list->entry);
-    if(bufi + length >= B_MAX_STRING_LENGTH) return NULL;
-    strcopy(list->entry, buf + bufi);
-    bufi += length;
-    list = list->next;
-    if(bufi + 100 >= buflength){
-      buflength +=1000;
-      char *tmp = realloc(buf, buflength);
-      if(!tmp){
-        freeChar(&buf);
-        return NULL;
-      }
-      buf = tmp;
-    }
-  }
-  char *str = malloc(bufi+1);
-  strcopy(buf, str);
-  freeChar(&buf);
-  return str;
-}
-
 StringList *copyStringList(StringList *strlist){
   if(!strlist) return NULL;
   StringList *newstrlist = NULL;
@@ -179,6 +193,7 @@ StringList *copyStringList(StringList *strlist){
       n = newstrlist;
     }
     n->entry = copyString(strlist->entry);
+    n->term = strlist->term;
     strlist = strlist->next;
   }
   return newstrlist;
@@ -187,8 +202,8 @@ StringList *copyStringList(StringList *strlist){
 void printStringlist(StringList *list, int start, int count){
   int s = 0;
   int c = 0;
-  while(list){
-    if(s>=start && c<count){
+  while(list && c<count){
+    if(s>=start){
       if(list->entry) printf("%s\n", list->entry);
       c++;
     }
@@ -208,772 +223,453 @@ int fprintStringlist(char *filepathname, StringList *list){
   return 1;
 }
 
-StringList *splitUnifier(char *unifier){
-  if(!unifier) return NULL;
-  StringList *t1 = NULL;
-  StringList *tn = NULL;
-  StringList *tp = NULL;
-  char buf[B_MAX_STRING_LENGTH];
-  int bufi = 0;
-  char c = unifier[0];
-  if(c != '{') return NULL;
-  int length = strlength(unifier);
- for(int i = 0; i<length; i++){
-    c = unifier[i];
-    buf[bufi++] = c;
-    if(c == '}'){
-      if(!t1){
-        t1 = malloc(sizeof(StringList));
-        t1->entry = NULL;
-        t1->next = NULL;
-        tn = t1;
-      }
-      buf[bufi] = '\0';
-      tn->entry = malloc(strlength(buf)+1);
-      strcopy(buf, tn->entry);
-      tp = tn;
-      tn = malloc(sizeof(StringList));
-      tn->entry = NULL;
-      tn->next = NULL;
-      tp->next = tn;
-      bufi = 0;   
-    }
-  }
-  freeStringList(&tp->next);
-  tp->next = NULL;
-  return t1;
+/* firstTerm - returns the first goal of a conjunction */
+Term firstTerm(Term term){
+  if(!term) return 0;
+  if(termType(term) == TTCONJUNCTION) return termArg(term, 0);
+  return term;
 }
 
-char *firstTerm(char *term){
-  if(!term) return NULL;
-  int length = strlength(term)+1;
-  char *first = malloc(length+1);
-  strcopy(term, first);
-  int paren = 0;
-  for(int index = 0; index<length; index++){
-    char c = first[index];
-    if(c == '(') paren++;
-    if(c == ')') paren--;
-    if(!paren){
-      if(c == ',' || c == '.'){
-        first[index] = '\0';
-        return first;
-      }
-    }
-  }
-  return first;
-}
-
-// 
-char *restTerm(char *term, char *firstTerm){
-  if(!term) return NULL;
-  int length = strlength(term) ;
-  int lengthfirst = strlength(firstTerm);
-  if(length - lengthfirst < 2) return NULL;
-  // if(term[length - 2] == '.') return NULL;
-  // if(length - lengthfirst == 0) return NULL;
-  char *rest = malloc(length - lengthfirst+1);
-  strcopy(term+lengthfirst+1, rest);
-  if(rest[0] == '\0'){
-    freeChar(&rest); 
-    return NULL;
-  }
-  return rest;
+/* restTerm - returns the conjunction following the first goal or 0 */
+Term restTerm(Term term){
+  if(!term) return 0;
+  if(termType(term) == TTCONJUNCTION) return termArg(term, 1);
+  return 0;
 }
 
-/* head - returns head of clause or full clause if no head;
- * no :- permitted in head of clause */
-char *head(char *clause){
-  char *head = clause;
-  int index = 0;
-  int length = strlength(clause) + 1;
-  int paren = 0;
-  while(index<length){
-    if(clause[index] == '(') paren++;
-    if(clause[index] == ')') paren--;
-    if(clause[index] == ':' && clause[index + 1] == '-' && !paren){
-      head = malloc(index+1);
-      for(int i = 0; i<=index; i++){
-        head[i] = clause[i];
-      }
-      head[index] = '\0';
-      return head;
-    }
-    index++;
-  }
-  head = malloc(length +1);
-  strcopy(clause, head);
-  return head;
+/* head - returns head of clause or full clause if no head */
+Term head(Term clause){
+  if(termType(clause) == TTCLAUSE) return termArg(clause, 0);
+  return clause;
 }
 
-/* body - returns body of clause or NULL;
- * no :- permitted in head of clause */
-char *body(char *clause){
-  char *body = NULL;
-  int index = 0;
-  int length = strlength(clause) + 1;
-  while(index<length){
-    if(clause[index] == ':' && clause[index + 1] == '-'){
-      body = malloc(length - (index) +1);//(index + 2)
-      for(int i = 0; i<length - (index + 2); i++){//(index + 2)
-        body[i] = clause[i + index + 2];//(index + 2)//TODO clause index overrun
-      }
-      break;
-    }
-    index++;
-  }
-  return body;
+/* body - returns body of clause or 0 */
+Term body(Term clause){
+  if(termType(clause) == TTCLAUSE) return termArg(clause, 1);
+  return 0;
+}
+
+int isBuiltin(Term goal){
+  if(termType(goal) == TTATOM) return termName(goal) == SymCut;
+  if(isArithmetic(goal)) return 1;
+  return termType(goal) == TTFUNCTOR && termName(goal) == SymOnce && termArity(goal) == 1;
+}
+
+/* prefixDirective - rewrites ":- name args." as ":-name(args)." so the
+ * directive survives whitespace removal; NULL if clause is not of that form */
+static char *prefixDirective(char *clause){
+  int i = 0;
+  while(isspace(clause[i])) i++;
+  if(clause[i] != ':' || clause[i+1] != '-') return NULL;
+  i += 2;
+  while(isspace(clause[i])) i++;
+  int name = i;
+  while(isalnum(clause[i]) || clause[i] == '_') i++;
+  if(i == name || !isspace(clause[i])) return NULL;
+  int args = i;
+  while(isspace(clause[args])) args++;
+  if(clause[args] == '(' || clause[args] == '.' || !clause[args]) return NULL;
+  int end = strlength(clause);
+  while(end > args && isspace(clause[end-1])) end--;
+  if(end - 1 <= args || clause[end-1] != '.') return NULL;
+  StringBuffer sb;
+  initStringBuffer(&sb);
+  for(int c = 0; c<i; c++) appendChar(&sb, clause[c]);
+  appendChar(&sb, '(');
+  for(int c = args; c<end-1; c++) appendChar(&sb, clause[c]);
+  appendString(&sb, ").");
+  return takeString(&sb);
+}
+
+/* separates - 1 if whitespace between a and b must be kept as a space, as
+ * in "X is Y" or "X< -1", where a and b would otherwise join in one name */
+static int separates(char a, char b){
+  return charClass(a) && charClass(a) == charClass(b);
 }
 
-/* sff - returns 1 if clause is well formed formula; 0 otherwise */
+/* wff - clause with its whitespace removed if it is a well formed formula;
+ * NULL otherwise */
 char *wff(char *clause){
+  char *directive = prefixDirective(clause);
+  if(directive) clause = directive;
   int length = strlength(clause) + 1;
   char *newClause = malloc(length+1);
   int index = 0;
   int newIndex = 0;
   int paren = 0;
   int illegalchar = 0;
+  int space = 0;
   while(index<length){
     char c = clause[index++];
-    if(!isspace(c)){
-      if(c == '(') paren++;
-      if(c ==')') paren--;
-      if(c =='{' || c == '}' || c == '|') illegalchar = 1;
-      newClause[newIndex++] = c;
+    if(isspace(c)){
+      space = 1;
+      continue;
     }
+    if(c == '(') paren++;
+    if(c ==')') paren--;
+    if(c =='{' || c == '}' || c == '|') illegalchar = 1;
+    if(space && newIndex && separates(newClause[newIndex-1], c)) newClause[newIndex++] = ' ';
+    space = 0;
+    newClause[newIndex++] = c;
   }
   newClause[newIndex] = '\0';
-  if(newClause[newIndex-2] !='.' || paren || illegalchar){
+  freeChar(&directive);
+  if(newIndex < 2 || newClause[newIndex-2] !='.' || paren || illegalchar){
     freeChar(&newClause);
     return NULL;
   }
   return newClause;
 }
 
-int arity(char *term){
-  if(!term) return 0;
-  int length = strlength(term) + 1;
-  int paren = 0;
-  int arity = 0;
-  int index = 0;
-  char c = term[index++];
-  while(!isControlChar(c)){
-    c = term[index++];
-  }
-  if(c != '(') return 0;
-  arity++;
-  paren = 1;
-  while(paren != 0){
-    c = term[index++];
-    if(c == '(') paren++;
-    if(c == ')') paren--;
-    if(paren == 1 && c == ',') arity++;
-  }
-  return arity;
-}
+int unifyTerms(Term term1, Term term2, Unifier *unifier);
 
-char *getOp(char *term){
-  char buf[B_MAX_STRING_LENGTH];
-  int index = 0;
-  char c = term[index];
-  while(!isControlChar(c)){
-    buf[index++] = c;
-    c = term[index];
+int unifyVariable(Term var, Term term, Unifier *unifier){
+  // var and term are dereferenced, so var is unbound
+  if(unifier->occurs != OCCURSOFF && termType(term) != TTVARIABLE && occursIn(var, term, unifier)){
+    if(unifier->occurs == OCCURSERROR) unifier->cyclic = 1;
+    return 0;
   }
-  buf[index] = '\0';
-  char *op = malloc(strlength(buf)+1);
-  strcopy(buf, op);
-  return op;
+  bind(unifier, var, term);
+  return 1;
 }
 
-char *getArgs(char *term){
-  char buf[B_MAX_STRING_LENGTH];
-  int bufindex = 0;
-  buf[bufindex]='\0';
-  int index = 0;
-  int paren = 1;
-  char c = term[index++];
-  while(c != '('){
-    c = term[index++];
+/* unifyPair - unifies term1 and term2 as far as their functors, pushing
+ * the pairs of their arguments on pending, the first on top */
+static int unifyPair(Term term1, Term term2, Unifier *unifier, TermStack *pending){
+  term1 = deref(term1, unifier);
+  term2 = deref(term2, unifier);
+  if(term1 == term2) return 1;
+  // terms are hash-consed, so different ground terms are never equal
+  if(termIsGround(term1) && termIsGround(term2)) return 0;
+  TermType tt1 = termType(term1);
+  TermType tt2 = termType(term2);
+  if(tt1 == TTVARIABLE){
+    return unifyVariable(term1, term2, unifier);
   }
-  while(paren != 0){
-    c = term[index++];
-    if(c == '(') paren++;
-    if(c == ')') paren--;
-    buf[bufindex++] = c;
+  if(tt2 == TTVARIABLE){ 
+    return unifyVariable(term2, term1, unifier);
   }
-  buf[bufindex - 1] = '\0';
-  char *args = malloc(strlength(buf)+1);
-  strcopy(buf, args);
-  return args;
+  // identical constants were caught above
+  if(termIsAtomic(term1) || termIsAtomic(term2)) return 0;
+  if(termName(term1) != termName(term2)) return 0;
+  int arity = termArity(term1);
+  if(arity != termArity(term2)) return 0;
+  for(int i = arity - 1; i>=0; i--){
+    PUSH_TERM(pending, termArg(term2, i));
+    PUSH_TERM(pending, termArg(term1, i));
+  }
+  return 1;
 }
 
-TermType type(char *term){
-  int paren = 0;
-  int conjunctions = 0;
-  int foundparen = 0;
-  int functor = 0;
-  int length = strlength(term);
-  for(int index = 0; index<length; index++){
-    char c = term[index];
-    if(c == '('){
-      paren++;
-      foundparen++;
-    } 
-    if(c == ')') paren--;
-    if(conjunctions == 0 && paren == 0 && c == ':' && term[index + 1] == '-') return TTCLAUSE;
-    if(paren == 0 && c == ',') return TTCONJUNCTION;
-  }
-  if(foundparen) return TTFUNCTOR;
-  if(isupper(term[0])) return TTVARIABLE;
-  return TTATOM;
-}
-
-TermType typeStringListEntry(StringList *list){
-  if(isControlChar(list->entry[0])) return TTCONTROLCHAR;
-  return type(list->entry);
-}
-
-/* returns term bound to variable var */
-char * getBound(char *var, char *unifier){
-  if(!var || !unifier) return NULL;
-  StringList *list = splitByControlChars(unifier);
-  StringList *l1 = list;
-  char buf[B_MAX_STRING_LENGTH];
-  int bufi = 0;
-  int priorcurly = 0;
-  while(l1){
-    TermType typ = typeStringListEntry(l1);
-    if(typ == TTVARIABLE && priorcurly){
-      if(!strcomp(var, l1->entry)){
-        l1 = l1->next->next;
-        while(l1){
-          if(l1->entry[0] == '}'){
-            char *bound = malloc(strlength(buf)+1);
-            strcopy(buf, bound);
-            freeStringList(&list);
-            return bound;
-          } else {
-            strcopy(l1->entry, buf + bufi);
-            bufi += strlength(l1->entry);
-            l1 = l1->next;
-          }
-        }
-      }
-    }
-    priorcurly = l1->entry[0] =='{' ? 1 : 0;
-    l1 = l1->next;
+int unifyTerms(Term term1, Term term2, Unifier *unifier){
+  TermStack pending;
+  initTermStack(&pending);
+  int unified;
+  while((unified = unifyPair(term1, term2, unifier, &pending)) && pending.count){
+    term1 = pending.items[--pending.count];
+    term2 = pending.items[--pending.count];
   }
-  freeStringList(&list);
-  return NULL;
+  freeTermStack(&pending);
+  return unified;
 }
 
-/************************************
-char *origcompose(char *origunifier, char *newunifier){
-  if(!origunifier || !newunifier) {
-    if(origunifier) return copyString(origunifier);
-    return copyString(newunifier);
-  }
-  if(!strcomp(origunifier, newunifier)) return copyString(origunifier);
-  if(!strcomp(origunifier, "{ | }")) return copyString(newunifier);
-  if(!strcomp(newunifier, "{ | }")) return copyString(origunifier);
-  StringList *list = splitByControlChars(origunifier);
-  StringList *l1 = list;
-  StringList *lp = NULL;
-  char buf[B_MAX_STRING_LENGTH];
-  int bufi = 0;
-  int priorcurly = 0;
-  // replace any origunifier variables matched 
-  // in newunifier with their bound value
-  while(l1){
-    TermType typ = typeStringListEntry(l1);
-    if(typ == TTVARIABLE && !priorcurly){
-      char *bound = getBound(l1->entry, newunifier);
-      if(bound){
-        freeChar(&l1->entry);
-        l1->entry = malloc(strlength(bound)+1);
-        strcopy(bound, l1->entry);
-        freeChar(&bound);
-      }
-    }
-    priorcurly = l1->entry[0] =='{' ? 1 : 0;
-    lp = l1;
-    l1 = l1->next;
-  }
-  // append everything in newunifier to the end
-  // of origunifier (except blank "{ | }")
-  StringList *nu = splitUnifier(newunifier);
-  StringList *nu2 = nu;
-  while(nu2){
-    if(strcomp(nu2->entry,"{ | }")){
-      lp->next = malloc(sizeof(StringList));
-      lp = lp->next;
-      lp->entry = NULL;
-      lp->next = NULL;
-      lp->entry = malloc(strlength(nu2->entry)+1);
-      strcopy(nu2->entry, lp->entry);
-    } 
-    nu2 = nu2->next;
-  }
-  char *compos = joinStringList(list);
-  freeStringList(&list);
-  freeStringList(&nu);  
-  // remove any duplicate entries and remove 
-  // all blanks "{ | }"
-  list = splitUnifier(compos);
-  freeChar(&compos);
-  lp = list;
-  nu = lp;
-  while(lp){
-    if(!strcomp(lp->entry, "{ | }") && lp->next){
-      l1 = lp->next;
-      lp->next = NULL;
-      freeStringList(&lp);
-      lp = l1;
-      if(nu == list){
-        list = lp;
-        nu = lp;
-      } else {
-        nu->next = lp;
-      }
-    }
-    l1 = lp->next;
-    StringList *l1p = lp;
-    while(l1){
-      if(!strcomp(lp->entry, l1->entry)){
-        l1p->next = l1->next;
-        l1->next = NULL;
-        freeStringList(&l1);
-        l1 = l1p->next;
-      } else {
-        l1p = l1;
-        l1 = l1->next;
-      }
-    }
-    nu = lp;
-    lp = lp->next;
-  }
-  // verify there's at least one entry or 
-  // return the emtpy unifier
-  int x = 0;
-  if(!list->next){
-    if(!list->entry){
-      x = 1;
-    } else {
-      if(!strcomp(list->entry, "{ | }")){
-        x = 1;
+/* unify - binds variables so term1 and term2 are identical; returns 0 and 
+ * leaves unifier unchanged if they do not unify */
+int unify(Term term1, Term term2, Unifier *unifier){
+  Stats.unifications++;
+  if(!term1 || !term2) return 1;
+  int mark = unifierMark(unifier);
+  if(unifyTerms(term1, term2, unifier)) return 1;
+  undoBindings(unifier, mark);
+  return 0;
+}
+
+/* renameVisit - renames a variable; a ground subterm is final as it is */
+static int renameVisit(Term *t, void *context){
+  if(termType(* t) != TTVARIABLE) return termIsGround(* t);
+  (* t) = variableTerm(termName(* t), * (int *)context);
+  return 1;
+}
+
+/* renameVariables - gives every variable in term the rename index */
+Term renameVariables(Term term, int index){
+  return mapTerm(term, renameVisit, &index);
+}
+
+/* renameIndex - an index no other renaming in the query has had; -1, and
+ * the query stops as it does when the term store is full, once they run
+ * out, as -1 is kept for variables that were never renamed */
+static int renameIndex(Engine *engine){
+  // parallel workers rename concurrently, each needs its own index
+  unsigned int i = __atomic_fetch_add(&engine->renames, 1, __ATOMIC_RELAXED);
+  if(i < INT_MAX) return (int)i;
+  // held past INT_MAX so the counter never wraps back to indexes in use
+  __atomic_store_n(&engine->renames, (unsigned int)INT_MAX + 1, __ATOMIC_RELAXED);
+  if(i == INT_MAX) fprintf(stderr, "Out of rename indexes\n");
+  exhaustMemory();
+  return -1;
+}
+
+/* indexVariables - renames variables in term apart from those in other
+ * clauses; 0 once the rename indexes have run out */
+Term indexVariables(Engine *engine, Term term){
+  int index = renameIndex(engine);
+  return index < 0 ? 0 : renameVariables(term, index);
+}
+
+#define FRAME_VARIABLES 32
+
+/* HeadFrame - values of the variables of a clause head while it is matched;
+ * the clause is not renamed, its variables are only bound in the frame */
+typedef struct HEAD_FRAME{
+  Term vars[FRAME_VARIABLES];
+  Term values[FRAME_VARIABLES];
+  int count;
+} HeadFrame;
+
+/* matchGoals - 0 if goal terms t1 and t2 cannot unify under unifier */
+static int matchGoals(Term t1, Term t2, Unifier *unifier){
+  TermStack pending;
+  initTermStack(&pending);
+  int match = 1;
+  for(;;){
+    t1 = deref(t1, unifier);
+    t2 = deref(t2, unifier);
+    if(t1 != t2 && termType(t1) != TTVARIABLE && termType(t2) != TTVARIABLE){
+      int arity = termArity(t1);
+      if(termIsAtomic(t1) || termIsAtomic(t2) ||
+        termName(t1) != termName(t2) || arity != termArity(t2)){
+        match = 0;
+        break;
       }
-    }
-  }
-  if(x){
-    compos = malloc(6);
-    strcopy("{ | }", compos);
-    freeStringList(&list);
-    return compos;
-  }
-  compos = joinStringList(list);
-  freeStringList(&list);
-  return compos;
-}
-*************************************/
-
-char *getVariablefromSubstitution(char *subst){
-  int len = strlength(subst);
-  char *var = malloc(len-2);
-  char c;
-  int j = 0;
-  for(int i = 1; i<len; i++){
-    c = subst[i];
-    if(c == '|') break;
-    var[j++] = c;
-  }  
-  var[j] = '\0';
-  return var;
-}
-
-char *getBoundfromSubstitution(char *subst){
-  int len = strlength(subst);
-  char *var = malloc(len-2);
-  char c;
-  int j = 0;
-  int found = 0;
-  for(int i = 1; i<len; i++){
-    c = subst[i];
-    if(c == '|') found = 1;
-    if(c == '}') break;
-    if(found) var[j++] = c;
-  }  
-  var[j] = '\0';
-  return var;
-}
-
-
-char *compose(char *origunifier, char *newunifier){
-  if(!origunifier || !newunifier) {
-    if(origunifier) return copyString(origunifier);
-    return copyString(newunifier);
-  }
-  if(!strcomp(origunifier, newunifier)) return copyString(origunifier);
-  if(!strcomp(origunifier, "{ | }")) return copyString(newunifier);
-  if(!strcomp(newunifier, "{ | }")) return copyString(origunifier);
-  if(origunifier[0] != '{') return copyString(newunifier);
-  if(newunifier[0] != '{') return copyString(origunifier);
-  StringList *list = splitByControlChars(origunifier);
-  StringList *l1 = list;
-  StringList *lp = NULL;
-  char buf[B_MAX_STRING_LENGTH];
-  int bufi = 0;
-  int priorcurly = 0;
-  // replace any origunifier variables matched 
-  // in newunifier with their bound value
-  while(l1){
-    TermType typ = typeStringListEntry(l1);
-    if(typ == TTVARIABLE && !priorcurly){
-      char *bound = getBound(l1->entry, newunifier);
-      if(bound){
-        freeChar(&l1->entry);
-        l1->entry = malloc(strlength(bound)+1);
-        strcopy(bound, l1->entry);
-        freeChar(&bound);
+      for(int i = arity - 1; i>=0; i--){
+        PUSH_TERM(&pending, termArg(t2, i));
+        PUSH_TERM(&pending, termArg(t1, i));
       }
     }
-    priorcurly = l1->entry[0] =='{' ? 1 : 0;
-    lp = l1;
-    l1 = l1->next;
-  }
-  // append everything in newunifier to the end
-  // of origunifier (except blank "{ | }")
-  StringList *nu = splitUnifier(newunifier);
-  StringList *nu2 = nu;
-  while(nu2){
-    if(strcomp(nu2->entry,"{ | }")){
-      lp->next = malloc(sizeof(StringList));
-      lp = lp->next;
-      lp->entry = NULL;
-      lp->next = NULL;
-      lp->entry = malloc(strlength(nu2->entry)+1);
-      strcopy(nu2->entry, lp->entry);
-    } 
-    nu2 = nu2->next;
+    if(!pending.count) break;
+    t1 = pending.items[--pending.count];
+    t2 = pending.items[--pending.count];
   }
-  char *compos = joinStringList(list);
-  freeStringList(&list);
-  freeStringList(&nu);  
-  // remove any duplicate entries and remove 
-  // all blanks "{ | }"
-  list = splitUnifier(compos);
-  freeChar(&compos);
-  lp = list;
-  nu = lp;
-  while(lp){
-    //remove blanks
-    if(!strcomp(lp->entry, "{ | }") && lp->next){
-      l1 = lp->next;
-      if(lp == list) list = lp->next;
-      lp->next = NULL;
-      freeStringList(&lp);
-      lp = l1;
-      if(nu == list){
-        list = lp;
-        nu = lp;
-      } else {
-        nu->next = lp;
-      }
+  freeTermStack(&pending);
+  return match;
+}
+
+/* matchPair - matchHead for one pair, pushing the pairs of its arguments
+ * on pending */
+static int matchPair(Term goal, Term h, Unifier *unifier, HeadFrame *frame, TermStack *pending){
+  goal = deref(goal, unifier);
+  if(termType(h) == TTVARIABLE){
+    for(int i = 0; i<frame->count; i++){
+      if(frame->vars[i] == h) return matchGoals(frame->values[i], goal, unifier);
     }
-    //remove duplicates variables (from newunifier) and {var|var}
-    l1 = lp->next;
-    StringList *l1p = lp;
-    while(l1){
-      char *lpvar = getVariablefromSubstitution(lp->entry);
-      char *l1var = getVariablefromSubstitution(l1->entry);
-      char *l1bound = getBoundfromSubstitution(lp->entry);
-      if(!strcomp(lpvar, l1var) || !strcomp(l1var, l1bound)){
-        l1p->next = l1->next;
-        l1->next = NULL;
-        freeStringList(&l1);
-        l1 = l1p->next;
-      } else {
-        l1p = l1;
-        l1 = l1->next;
-      }
-      freeChar(&lpvar);
-      freeChar(&l1var);
-      freeChar(&l1bound);
+    if(frame->count < FRAME_VARIABLES){
+      frame->vars[frame->count] = h;
+      frame->values[frame->count++] = goal;
     }
-    nu = lp;
-    lp = lp->next;
+    return 1;
   }
-  // verify there's at least one entry or 
-  // return the emtpy unifier
-  int x = 0;
-  //TODO what if list is null???
-  if(!list) return origunifier;
-  if(!list->next){
-    if(!list->entry){
-      x = 1;
-    } else {
-      if(!strcomp(list->entry, "{ | }")){
-        x = 1;
-      }
-    }
+  if(goal == h || termType(goal) == TTVARIABLE) return 1;
+  if(termIsAtomic(goal) || termIsAtomic(h)) return 0;
+  int arity = termArity(h);
+  if(termName(goal) != termName(h) || arity != termArity(goal)) return 0;
+  for(int i = arity - 1; i>=0; i--){
+    PUSH_TERM(pending, termArg(h, i));
+    PUSH_TERM(pending, termArg(goal, i));
   }
-  if(x){
-    compos = malloc(6);
-    strcopy("{ | }", compos);
-    freeStringList(&list);
-    return compos;
+  return 1;
+}
+
+/* matchHead - 0 if goal cannot unify with h, a part of a clause head whose
+ * variables are bound in frame; goal variables are never bound, so some
+ * pairs that pass still fail to unify */
+static int matchHead(Term goal, Term h, Unifier *unifier, HeadFrame *frame){
+  TermStack pending;
+  initTermStack(&pending);
+  int match;
+  while((match = matchPair(goal, h, unifier, frame, &pending)) && pending.count){
+    goal = pending.items[--pending.count];
+    h = pending.items[--pending.count];
   }
-  compos = joinStringList(list);
-  freeStringList(&list);
-  return compos;
+  freeTermStack(&pending);
+  return match;
 }
 
-char *unifyVariable(char *term1, char *term2, char *unifier);
+Term renameClause(Engine *engine, Term goal, Term clause, Unifier *unifier){
+  HeadFrame frame;
+  frame.count = 0;
+  if(goal && !matchHead(goal, head(clause), unifier, &frame)) return 0;
+  return indexVariables(engine, clause);
+}
 
-/* unify - returns unification of provided terms in format {X|a}{Y|b}... */
-char *unify(char *term1, char *term2, char *unifier){
-  if(!unifier) return NULL;
-  if(!term1 || !term2) return copyString(unifier);
-  if(!strcomp(term1, term2)) return copyString(unifier);
-  TermType tt1 = type(term1);
-  TermType tt2 = type(term2);
-  if(tt1 == TTVARIABLE){
-    return unifyVariable(term1, term2, unifier);
-  }
-  if(tt2 == TTVARIABLE){ 
-    return unifyVariable(term2, term1, unifier);
-  }
-  if(tt1 == TTFUNCTOR && tt2 == TTFUNCTOR){
-    char *t1a = getArgs(term1);
-    char *t2a = getArgs(term2);
-    char *t1o = getOp(term1);
-    char *t2o = getOp(term2);
-    char *ufunc = unify(t1o, t2o, unifier);
-    if(!ufunc){
-      freeChar(&t1o);
-      freeChar(&t2o);
-      freeChar(&t1a);
-      freeChar(&t2a);
-      return NULL;
-    }
-    char *ufunc2 = unify(t1a, t2a, ufunc);
-    freeChar(&t1o);
-    freeChar(&t2o);
-    freeChar(&t1a);
-    freeChar(&t2a);
-    freeChar(&ufunc);    
-    return ufunc2;
-  }
-  if(tt1 == TTCONJUNCTION && tt2 == TTCONJUNCTION){
-    char *ft1 = firstTerm(term1);
-    char *ft2 = firstTerm(term2);
-    char *rt1 = restTerm(term1, ft1);
-    char *rt2 = restTerm(term2, ft2);
-    char *uconj = unify(ft1, ft2, unifier);
-    if(!uconj){
-      freeChar(&ft1);
-      freeChar(&ft2);
-      freeChar(&rt1);
-      freeChar(&rt2);
-      return NULL;
-    }
-    char *uconj2 = unify(rt1, rt2, uconj);
-    freeChar(&ft1);
-    freeChar(&ft2);
-    freeChar(&rt1);
-    freeChar(&rt2);
-    freeChar(&uconj);
-    return uconj2;
-  }
-  return NULL;
+int hasStatement(KB *kb, Term stmnt){
+  if(kb->base && hasStatement(kb->base, stmnt)) return 1;
+  return containsClause(kb->index, stmnt);
 }
 
-char *unifyVariable(char *var, char *term, char *unifier){
-  if(strInStr(unifier, var)){
-    char *bound = getBound(var, unifier);
-    if(bound){ 
-      char *ub = unify(bound, term, unifier);
-      freeChar(&bound);
-      return ub;
-    }
-  }
-  if(type(term) == TTVARIABLE){
-    if(strInStr(unifier, term)){
-      char *tbound = getBound(term, unifier);
-      char *utv = unify(var, tbound, unifier);
-      freeChar(&tbound);
-      return utv;
-    }
-  }
-  char buf[B_MAX_STRING_LENGTH];
-  int bufindex = 0;
-  if(strcomp(unifier, "{ | }")){
-    strcopy(unifier, buf);
-    bufindex = strlength(unifier);
-  }
-  buf[bufindex++] = '{';
-  strcopy(var, buf + bufindex);
-  bufindex += strlength(var);
-  buf[bufindex++] = '|';
-  strcopy(term, buf + bufindex);
-  bufindex += strlength(term);
-  buf[bufindex++] = '}';
-  buf[bufindex] = '\0';
-  char *u = malloc(strlength(buf)+1);
-  strcopy(buf, u);
-  return u;
-}
-
-char *substitute(char *term, char *unifier){
-  if(!term) return NULL;
-  StringList *list = splitByControlChars(term);
-  StringList *l1 = list;
-  while(l1){
-    TermType typ = typeStringListEntry(l1);
-    if(typ == TTVARIABLE){
-
-      char *bound = getBound(l1->entry, unifier);
-      if(bound){
-        freeChar(&l1->entry);
-        l1->entry = bound;
-      }
-    }
-    l1 = l1->next;
-  }
-  char *newterm = joinStringList(list);
-  freeStringList(&list);
-  return newterm;
-}
-
-char *indexVariables(char *term){
-  static int i;
-  char buf[5];
-  sprintf(buf, "%d", i);
-  StringList *t = splitByControlChars(term);
-  StringList *t1 = t;
-  while(t1){
-    TermType typ = typeStringListEntry(t1);
-    if(typ == TTVARIABLE){
-      char *newentry = concat(t1->entry, buf);
-      freeChar(&t1->entry);
-      t1->entry = newentry;
-    }
-    t1 = t1->next;
-  }
-  char *newterm = joinStringList(t);
-  freeStringList(&t);
-  i++;
-  return newterm;
+KB *newKB(){
+  KB *kb = malloc(sizeof(KB));
+  kb->statements = NULL;
+  kb->index = newClauseIndex();
+  kb->base = NULL;
+  kb->arena = NULL;
+  kb->text = NULL;
+  kb->textsize = 0;
+  kb->nodes = NULL;
+  kb->nodecount = 0;
+  return kb;
 }
 
-int hasStatement(StringList *strlist, char *stmnt){
-  while(strlist){
-    if(!strcomp(strlist->entry,stmnt)) return 1;
-    strlist = strlist->next;
+static StringList *arenaStringList(Arena *arena, char *entry, Term term){
+  StringList *slist = arenaAlloc(arena, sizeof(StringList));
+  slist->entry = entry;
+  slist->term = term;
+  slist->next = NULL;
+  return slist;
+}
+
+KB *overlayKB(KB *kb, Arena *arena){
+  KB *newkb = arenaAlloc(arena, sizeof(KB));
+  newkb->statements = NULL;
+  newkb->index = newClauseIndex();
+  newkb->base = kb;
+  newkb->arena = arena;
+  newkb->text = NULL;
+  newkb->textsize = 0;
+  newkb->nodes = NULL;
+  newkb->nodecount = 0;
+  // positions left stale by edits are rebuilt before workers share them
+  refreshIndex(kb->index);
+  return newkb;
+}
+
+/* freeEntry - frees the text of s unless it lies in the loaded file */
+static void freeEntry(KB *kb, StringList *s){
+  if(s->entry >= kb->text && s->entry < kb->text + kb->textsize){
+    s->entry = NULL;
+    return;
   }
-  return 0;
+  freeChar(&s->entry);
 }
 
-void deleteStatement(StringList **strlist, int index){
-  StringList *s = (* strlist);
-  StringList *tbd = NULL;
-  StringList *prior = NULL;
-  int c = 0;
+/* freeStatement - frees s and its text unless loadKB allocated them */
+static void freeStatement(KB *kb, StringList *s){
+  freeEntry(kb, s);
+  if(s < kb->nodes || s >= kb->nodes + kb->nodecount) free(s);
+}
+
+void freeKB(KB **kb){
+  if(!(* kb)) return;
+  freeClauseIndex(&(* kb)->index);
+  if((* kb)->arena){
+    // statements are released with the arena
+    (* kb) = NULL;
+    return;
+  }
+  StringList *s = (* kb)->statements;
   while(s){
-    if(c == index){
-      if(s == (* strlist)){
-        s = s->next;
-        (* strlist)->next = NULL;
-        freeStringList(&(* strlist));
-        (* strlist) = s;
-        return;
-      } else {
-        tbd = s;
-        s = s->next;
-        prior->next = s;
-        tbd->next = NULL;
-        freeStringList(&tbd);
-        return;
-      }
-    }
-    prior = s;
-    s = s->next;
-    c++;
+    StringList *next = s->next;
+    freeStatement(* kb, s);
+    s = next;
   }
+  unmapFile((* kb)->text, (* kb)->textsize);
+  free((* kb)->nodes);
+  free(* kb);
+  (* kb) = NULL;
 }
 
-void replaceStatement(StringList *strlist, int index, char *newstmnt){
-  StringList *s = strlist;
-  int c = 0;
-  while(s){
-    if(c == index){
-      freeChar(&s->entry);
-      s->entry = copyString(newstmnt);
-      return;
-    }
-    s = s->next;
-    c++;
+StringList *statementAt(KB *kb, int index){
+  return clauseAt(kb->index, index);
+}
+
+/* linkStatement - puts s into the statement list at position */
+static void linkStatement(KB *kb, int position, StringList *s){
+  StringList *prior = position ? clauseAt(kb->index, position - 1) : NULL;
+  if(prior){
+    s->next = prior->next;
+    prior->next = s;
+  } else {
+    s->next = kb->statements;
+    kb->statements = s;
   }
 }
 
-void insertStatement(StringList **strlist, int index, char *newstmnt){
-  StringList *s = (* strlist);
-  StringList *new = NULL;
-  StringList *prior = NULL;
-  int c = 0;
-  while(s){
-    if(c == index){
-      if(s == (* strlist)){
-        s = newStringList();
-        s->entry = copyString(newstmnt);
-        s->next = (* strlist);
-        (* strlist) = s;
-        return;
-      } else {
-        new = newStringList();
-        new->entry = copyString(newstmnt);
-        new->next = s;
-        prior->next = new;
-        return;
-      }
-    }
-    prior = s;
-    s = s->next;
-    c++;
+void deleteStatement(KB *kb, int index){
+  StringList *s = removeClause(kb->index, index);
+  if(!s) return;
+  StringList *prior = index ? clauseAt(kb->index, index - 1) : NULL;
+  if(prior){
+    prior->next = s->next;
+  } else {
+    kb->statements = s->next;
   }
+  freeStatement(kb, s);
 }
 
-void appendStatement(StringList *strlist, char *newstmnt){
-  if(!newstmnt || !strlist) return;
-  while(strlist->next){
-    strlist = strlist->next;
+void replaceStatement(KB *kb, int index, char *newstmnt){
+  StringList *s = clauseAt(kb->index, index);
+  if(!s) return;
+  Term old = s->term;
+  freeEntry(kb, s);
+  s->entry = copyString(newstmnt);
+  s->term = parseTerm(newstmnt);
+  reindexClause(kb->index, s, old);
+}
+
+void insertStatement(KB *kb, int index, char *newstmnt){
+  if(!clauseAt(kb->index, index)) return;
+  StringList *new = newStringList();
+  new->entry = copyString(newstmnt);
+  new->term = parseTerm(newstmnt);
+  linkStatement(kb, index, new);
+  insertClause(kb->index, index, new);
+}
+
+void appendTerm(KB *kb, Term stmnt, char *text){
+  if(!stmnt || !kb) return;
+  StringList *new;
+  if(kb->arena){
+    new = arenaStringList(kb->arena, arenaString(kb->arena, text), stmnt);
+  } else {
+    new = newStringList();
+    new->entry = copyString(text);
+    new->term = stmnt;
   }
-  strlist->next = newStringList();
-  strlist = strlist->next;
-  strlist->entry = copyString(newstmnt);
+  linkStatement(kb, clauseCount(kb->index), new);
+  indexClause(kb->index, new);
+  // lemmas of a query are held in its arena until it ends
+  if(kb->arena) chargeMemory(MEMKB, sizeof(StringList) + strlength(text) + 1);
+}
+
+void appendStatement(KB *kb, char *newstmnt){
+  if(!newstmnt || !kb) return;
+  appendTerm(kb, parseTerm(newstmnt), newstmnt);
 }
 
-void appendResolution(char *unifier){
-  char *r = Unifiers;
+void appendResolution(Engine *engine, char *unifier){
+  char *r = engine->unifiers;
+  chargeMemory(MEMPROOF, strlength(unifier));
   if(!r){
     r = malloc(strlength(unifier)+1);
     strcopy(unifier, r);
-    Unifiers = r;
+    engine->unifiers = r;
     return;
   }
-  freeChar(&Unifiers);
-  Unifiers = concat(Unifiers, unifier);
+  engine->unifiers = concat(r, unifier);
+  freeChar(&r);
 }
 
-int appendProof(char *term){
+int appendProof(Engine *engine, char *term){
   if(!term) return 0;
-  StringList *p = Proof;
+  chargeMemory(MEMPROOF, sizeof(StringList) + strlength(term) + 1);
+  StringList *p = engine->proof;
   if(!p){
     p = malloc(sizeof(StringList));
     p->entry = malloc(strlength(term)+1);
     strcopy(term, p->entry);
+    p->term = 0;
     p->next = NULL;
-    Proof = p;
+    engine->proof = p;
   } else {
     while(p->next){
       p = p->next;
@@ -982,197 +678,956 @@ int appendProof(char *term){
     p = p->next;
     p->entry = malloc(strlength(term)+1);
     strcopy(term, p->entry);
+    p->term = 0;
     p->next = NULL;
   }
   return 1;
 }
 
-int midresolveprompt(char *unifier , char *resolvent){
-  if(unifier){
-    char *t = resolvent;
-    char *tp = NULL;
-    int done = 0;
-    while(!done){
-      t = substitute(t, unifier);
-      if(!tp){
-        tp = t;
-      } else {
-        if(!strcomp(t, tp)){
-          done = 1;
-          freeChar(&tp);
-        } else {
-          freeChar(&tp);
-          tp = t;
-        }
+int presentAnswer(Engine *engine, Unifier *unifier, Term q, Term thetaq){
+  char *theta = engine->presentation.quiet ? NULL : unifierToString(unifier);
+  long long size = theta ? strlength(theta) + 1 : 0;
+  chargeMemory(MEMPROOF, size);
+  int last = presentAnswerText(engine, theta, q, thetaq);
+  chargeMemory(MEMPROOF, -size);
+  freeChar(&theta);
+  return last;
+}
+
+int presentAnswerText(Engine *engine, const char *theta, Term q, Term thetaq){
+  Session *presentation = &engine->presentation;
+  presentation->solutions++;
+  int last = presentation->maxsolutions &&
+    presentation->solutions >= presentation->maxsolutions;
+  if(presentation->quiet) return last;
+  if(presentation->batch){
+    // the answer is the goal as proved, without the clause body
+    char *answer = clauseToString(head(thetaq));
+    printf("{\"query\":%d,\"answer\":", presentation->query);
+    outputJSONString(stdout, answer);
+    printf(",\"theta\":");
+    outputJSONString(stdout, theta);
+    printf("}\n");
+    freeChar(&answer);
+    return last;
+  }
+  char *qs = clauseToString(q);
+  char *thetaqs = clauseToString(thetaq);
+  printf("Yes.\n");
+  printf("Θ = %s\n", theta);
+  printf("q = %s\n", qs);
+  printf("Θq = %s\n", thetaqs);
+  freeChar(&qs);
+  freeChar(&thetaqs);
+  if(last) return 1;
+  printf("More? (y/N) ");
+  char buf[10];
+  if(!fgets(buf, 9, stdin)) return 1;
+  if(buf[0] == 'Y' || buf[0] == 'y') return 0;
+  return 1;
+}
+
+/* keepAnswer - resolvent as the level 1 answer in unifier proves it, added
+ * to the KB as a lemma when ground; 0 if the answer is not shown */
+static Term keepAnswer(Engine *engine, Term resolvent, Unifier *unifier){
+  Term t = substitute(resolvent, unifier);
+  // an answer with an unbound variable is not shown, but one that only
+  // keeps variables where cycles are cut (occurs check off) is
+  int ground = termIsGround(t);
+  if(!ground && !cyclesOnly(t, unifier)) return 0;
+  // control goals have no clauses for a lemma to join, nor has a cycle
+  if(ground && !isBuiltin(t) && !hasStatement(engine->working, t)){
+    char *thetaq = clauseToString(t);
+    appendTerm(engine->working, t, thetaq);
+    freeChar(&thetaq);
+    engine->retained++;
+  }
+  return t;
+}
+
+int midresolveprompt(Engine *engine, Term resolvent, Unifier *unifier){
+  Term t = keepAnswer(engine, resolvent, unifier);
+  if(!t) return 0;
+  return presentAnswer(engine, unifier, resolvent, t);
+}
+
+/**
+ * Resolution runs as a loop over two stacks rather than recursing in C.
+ *
+ * A continuation is what is left to do once a goal is proved: the rest of
+ * the body it came from, then the continuation saved in that body's frame.
+ * Entering a rule body pushes a frame holding the caller's continuation.
+ * When the last goal of a body is called, its continuation is the one in
+ * the frame, so the frame is dropped first and tail-recursive rules run in
+ * constant space.
+ *
+ * A choicepoint holds what is still to try for a goal: its other clauses,
+ * the rest of its table answers or, for a body split into independent
+ * groups (parallel.h), the other combinations of their solutions. Failing
+ * goes back to the newest choicepoint, undoing the bindings made since it
+ * and taking its next alternative, so every goal of a body is retried in
+ * turn. A goal's last candidate is tried without a choicepoint, and frames
+ * a choicepoint's continuation needs are never reused while it exists.
+ *
+ * A body remembers how many choicepoints there were when its clause was
+ * chosen. A cut in it drops every choicepoint pushed since, the clause's
+ * own included, so neither the goals before the cut nor the clauses after
+ * its clause are retried. once(G) proves the body "G,!" in place, which
+ * keeps the first solution of G and nothing else.
+ */
+
+/* Continuation - goals of a body still to prove at level, then those of
+ * frame; a cut among goals drops the choicepoints from index cut on */
+typedef struct CONTINUATION{
+  Term goals;
+  int frame;
+  int level;
+  int cut;
+} Continuation;
+
+/**
+ * Below level 1 a clause is not renamed. Its head is unified with the goal
+ * as it stands, and its variables take their values in the environment of
+ * the frame its body is proved in, by their offset there. A goal of the
+ * body is only built when it is called, from those values, and arithmetic
+ * reads them without being built at all. A variable that has no value
+ * when a goal needs it becomes a renamed variable then.
+ */
+
+/* Environment - the variables of the clause a frame proves the body of
+ * and their values, 0 for none yet; clause is 0 for a frame whose goals
+ * are terms of their own */
+typedef struct ENVIRONMENT{
+  int clause;
+  int index;           /* rename index of its variables; -1 until one is renamed */
+  Term *vars;
+  Term *values;
+  int count;
+  int size;
+} Environment;
+
+/* Setting - a value given to variable var of the environment of frame
+ * once its body has started, taken back on backtracking as bindings are */
+typedef struct SETTING{
+  int frame;
+  int var;
+} Setting;
+
+/* ChoicepointKind - what is left to try; CPPRUNED has nothing left for its
+ * goal, only the alternatives after it */
+typedef enum
+{
+  CPCLAUSES, CPANSWERS, CPGROUPS, CPBUILTIN, CPPRUNED
+}ChoicepointKind;
+
+/* Choicepoint - a goal being resolved and its untried alternatives */
+typedef struct CHOICEPOINT{
+  ChoicepointKind kind;
+  Term goal;
+  Term alternatives;   /* goals tried after goal when resolve was given several */
+  int level;
+  Continuation next;   /* what follows once goal is proved */
+  int cut;             /* cut of the body goal is in, for ! */
+  int frametop;        /* frames below it are kept for next */
+  int trailmark;       /* bindings of the alternative tried; -1 before the first */
+  int settingmark;     /* settings of that alternative */
+  Term termmark;       /* terms of that alternative */
+  int retained;
+  int predicate;       /* profile entry of goal; -1 unless profiling */
+  int box;             /* profile box of goal, see profile.h */
+  union{
+    struct{
+      ClauseCursor cursor;
+      StringList *ahead;   /* next candidate, read ahead below level 1 */
+    } clauses;
+    struct{
+      Table *table;
+      int answer;          /* next answer to try */
+    } answers;
+    Independent *groups;
+  };
+} Choicepoint;
+
+struct RESOLUTION{
+  Engine *engine;
+  Unifier *unifier;
+  int level;           /* level resolution started at */
+  int mark;            /* bindings made before it started */
+  Term goals;          /* conjunction to prove, until the first solution is asked for */
+  int started;
+  int handback;        /* level 1 answers go back to nextSolution, not presented */
+  Continuation next;   /* what to do once the current goal is proved */
+  Term resolvent;      /* level 1 clause being tried, presented as the answer */
+  Continuation *frames;
+  Environment *envs;   /* envs[frame] - the variables of the body frame proves */
+  int framesize;
+  Setting *settings;
+  int settingcount;
+  int settingsize;
+  ProfileCall *calls;  /* clause each frame proves, while profiling */
+  int boxes;           /* profile boxes before it started */
+  Choicepoint *choicepoints;
+  int count;
+  int size;
+  int cut;             /* a cut among the goals themselves has run */
+  Cancel *cancel;      /* stops it once set; NULL for none */
+};
+
+static Resolution *newResolution(Engine *engine, Unifier *unifier, int level){
+  Resolution *r = accountAlloc(MEMRESOLUTION, sizeof(Resolution));
+  r->engine = engine;
+  r->unifier = unifier;
+  r->level = level;
+  r->mark = unifierMark(unifier);
+  r->goals = 0;
+  r->started = 0;
+  r->handback = 0;
+  r->resolvent = 0;
+  r->cancel = NULL;
+  r->framesize = 16;
+  r->frames = accountAlloc(MEMRESOLUTION, r->framesize * sizeof(Continuation));
+  r->envs = accountAlloc(MEMRESOLUTION, r->framesize * sizeof(Environment));
+  memset(r->envs, 0, r->framesize * sizeof(Environment));
+  r->settingsize = 16;
+  r->settings = accountAlloc(MEMRESOLUTION, r->settingsize * sizeof(Setting));
+  r->settingcount = 0;
+  r->calls = engine->profile ? malloc(r->framesize * sizeof(ProfileCall)) : NULL;
+  r->boxes = engine->profile ? engine->profile->boxcount : 0;
+  r->size = 16;
+  r->choicepoints = accountAlloc(MEMRESOLUTION, r->size * sizeof(Choicepoint));
+  r->count = 0;
+  r->cut = 0;
+  return r;
+}
+
+/* popChoicepoint - drops the newest choicepoint */
+static void popChoicepoint(Resolution *r){
+  Choicepoint *p = &r->choicepoints[--r->count];
+  if(p->kind == CPGROUPS) closeIndependent(&p->groups);
+}
+
+/* cutTo - drops the choicepoints from index cut on; the one at cut keeps
+ * the alternatives resolve was given after its goal */
+static void cutTo(Resolution *r, int cut){
+  while(r->count > cut + 1) popChoicepoint(r);
+  if(cut < 0){
+    r->cut = 1;
+    return;
+  }
+  if(r->count == cut + 1){
+    Choicepoint *p = &r->choicepoints[cut];
+    if(p->alternatives) p->kind = CPPRUNED;
+    else popChoicepoint(r);
+  }
+}
+
+int cancelled(Cancel *cancel){
+  for(; cancel; cancel = cancel->outer){
+    if(cancel->set) return 1;
+  }
+  return 0;
+}
+
+void watchCancel(Resolution *r, Cancel *cancel){
+  r->cancel = cancel;
+}
+
+int resolutionCut(Resolution *r){
+  return r->cut;
+}
+
+void closeResolution(Resolution **r){
+  if(!(* r)) return;
+  while((* r)->count) popChoicepoint(* r);
+  Profile *profile = (* r)->engine->profile;
+  if(profile && profile->boxcount > (* r)->boxes) profile->boxcount = (* r)->boxes;
+  accountFree(MEMRESOLUTION, (* r)->frames, (* r)->framesize * sizeof(Continuation));
+  for(int i = 0; i<(* r)->framesize; i++){
+    Environment *e = &(* r)->envs[i];
+    accountFree(MEMRESOLUTION, e->vars, e->size * sizeof(Term));
+    accountFree(MEMRESOLUTION, e->values, e->size * sizeof(Term));
+  }
+  accountFree(MEMRESOLUTION, (* r)->envs, (* r)->framesize * sizeof(Environment));
+  accountFree(MEMRESOLUTION, (* r)->settings, (* r)->settingsize * sizeof(Setting));
+  free((* r)->calls);
+  accountFree(MEMRESOLUTION, (* r)->choicepoints, (* r)->size * sizeof(Choicepoint));
+  accountFree(MEMRESOLUTION, * r, sizeof(Resolution));
+  (* r) = NULL;
+}
+
+/* nextCandidate - next clause of cursor that has a term or NULL */
+static StringList *nextCandidate(ClauseCursor *cursor){
+  StringList *s;
+  while((s = nextClause(cursor)) && !s->term);
+  return s;
+}
+
+/* openGoal - starts p on the clauses, or the table answers, of its goal */
+static void openGoal(Resolution *r, Choicepoint *p){
+  Engine *engine = r->engine;
+  Term goal = p->goal;
+  if(engine->profile){
+    int frame = p->next.frame;
+    p->predicate = profilePredicate(engine->profile, goal);
+    p->box = profileCall(engine->profile, p->predicate, frame < 0 ? -1 : r->calls[frame].box);
+  }
+  if(isBuiltin(goal)){
+    p->kind = CPBUILTIN;
+    return;
+  }
+  if(isTabled(engine, goal)){
+    p->kind = CPANSWERS;
+    p->answers.table = callTable(engine, goal, r->unifier);
+    p->answers.answer = 0;
+    return;
+  }
+  p->kind = CPCLAUSES;
+  Term firstarg = termArity(goal) ? deref(termArg(goal, 0), r->unifier) : 0;
+  openClauses(engine->working, goal, firstarg, &p->clauses.cursor);
+  // level 1 reads on demand, as its answers add lemmas the cursor may reach
+  p->clauses.ahead = p->level > 1 ? nextCandidate(&p->clauses.cursor) : NULL;
+}
+
+static Choicepoint *newChoicepoint(Resolution *r, int level, Continuation next){
+  if(r->count == r->size){
+    r->choicepoints = accountRealloc(MEMRESOLUTION, r->choicepoints,
+      r->size * sizeof(Choicepoint), 2 * r->size * sizeof(Choicepoint));
+    r->size *= 2;
+  }
+  Choicepoint *p = &r->choicepoints[r->count];
+  p->level = level;
+  p->next = next;
+  p->frametop = next.frame + 1;
+  if(r->count && r->choicepoints[r->count - 1].frametop > p->frametop){
+    p->frametop = r->choicepoints[r->count - 1].frametop;
+  }
+  p->trailmark = -1;
+  p->predicate = -1;
+  p->box = -1;
+  r->count++;
+  return p;
+}
+
+static int retry(Resolution *r);
+
+/* bodyFrame - the frame a body continuing with next is proved in, above
+ * those the choicepoints keep, making room for it */
+static int bodyFrame(Resolution *r, Continuation next){
+  int frame = next.frame + 1;
+  if(r->count && r->choicepoints[r->count - 1].frametop > frame){
+    frame = r->choicepoints[r->count - 1].frametop;
+  }
+  if(frame >= r->framesize){
+    int size = r->framesize;
+    while(frame >= r->framesize) r->framesize *= 2;
+    r->frames = accountRealloc(MEMRESOLUTION, r->frames,
+      size * sizeof(Continuation), r->framesize * sizeof(Continuation));
+    r->envs = accountRealloc(MEMRESOLUTION, r->envs,
+      size * sizeof(Environment), r->framesize * sizeof(Environment));
+    memset(r->envs + size, 0, (r->framesize - size) * sizeof(Environment));
+    if(r->calls) r->calls = realloc(r->calls, r->framesize * sizeof(ProfileCall));
+  }
+  return frame;
+}
+
+/* environmentVariable - offset of clause variable var in e, where it is
+ * added with no value the first time */
+static int environmentVariable(Environment *e, Term var){
+  for(int i = 0; i<e->count; i++){
+    if(e->vars[i] == var) return i;
+  }
+  if(e->count == e->size){
+    int size = e->size ? e->size * 2 : 8;
+    e->vars = accountRealloc(MEMRESOLUTION, e->vars, e->size * sizeof(Term), size * sizeof(Term));
+    e->values = accountRealloc(MEMRESOLUTION, e->values, e->size * sizeof(Term), size * sizeof(Term));
+    e->size = size;
+  }
+  e->vars[e->count] = var;
+  e->values[e->count] = 0;
+  return e->count++;
+}
+
+/* settle - gives variable var of the environment of frame value */
+static void settle(Resolution *r, int frame, int var, Term value){
+  if(r->settingcount == r->settingsize){
+    r->settings = accountRealloc(MEMRESOLUTION, r->settings,
+      r->settingsize * sizeof(Setting), 2 * r->settingsize * sizeof(Setting));
+    r->settingsize *= 2;
+  }
+  r->settings[r->settingcount++] = (Setting){frame, var};
+  r->envs[frame].values[var] = value;
+}
+
+/* undoSettings - takes back the values settled since mark */
+static void undoSettings(Resolution *r, int mark){
+  while(r->settingcount > mark){
+    Setting *s = &r->settings[--r->settingcount];
+    r->envs[s->frame].values[s->var] = 0;
+  }
+}
+
+/* FrameTerm - a term of the clause whose body frame of r proves */
+typedef struct FRAME_TERM{
+  Resolution *r;
+  int frame;
+} FrameTerm;
+
+/* variableValue - the value of clause variable var in the environment of
+ * frame, settled as a renamed variable if it has none yet; 0 if that
+ * cannot be made */
+static Term variableValue(Resolution *r, int frame, Term var){
+  Environment *e = &r->envs[frame];
+  int k = environmentVariable(e, var);
+  if(e->values[k]) return e->values[k];
+  if(e->index < 0) e->index = renameIndex(r->engine);
+  Term renamed = e->index < 0 ? 0 : variableTerm(termName(var), e->index);
+  if(renamed) settle(r, frame, k, renamed);
+  return renamed;
+}
+
+/* instanceVisit - replaces a clause variable by its value; a ground
+ * subterm is final as it is */
+static int instanceVisit(Term *t, void *context){
+  if(termType(* t) != TTVARIABLE) return termIsGround(* t);
+  FrameTerm *f = context;
+  (* t) = variableValue(f->r, f->frame, * t);
+  return 1;
+}
+
+/* instantiate - t with the variables of the clause frame proves replaced
+ * by their values; t itself if frame holds no clause */
+static Term instantiate(Resolution *r, Term t, int frame){
+  if(frame < 0 || !r->envs[frame].clause) return t;
+  FrameTerm f = {r, frame};
+  return mapTerm(t, instanceVisit, &f);
+}
+
+/* frameLookup - Lookup of the variables of a FrameTerm */
+static Term frameLookup(Term var, void *context){
+  FrameTerm *f = context;
+  Environment *e = &f->r->envs[f->frame];
+  for(int i = 0; i<e->count; i++){
+    if(e->vars[i] == var) return e->values[i];
+  }
+  return 0;
+}
+
+/* unifyHead - unifies goal with the head of clause, whose variables take
+ * their values in the environment of frame; returns 0, leaving the
+ * bindings as they were, if they do not unify */
+static int unifyHead(Resolution *r, Term goal, Term clause, int frame){
+  Unifier *unifier = r->unifier;
+  Environment *e = &r->envs[frame];
+  e->clause = 1;
+  e->index = -1;
+  e->count = 0;
+  Stats.unifications++;
+  int mark = unifierMark(unifier);
+  TermStack pending;
+  initTermStack(&pending);
+  Term h = head(clause);
+  int unified = 1;
+  for(;;){
+    goal = deref(goal, unifier);
+    if(termType(h) == TTVARIABLE){
+      int k = environmentVariable(e, h);
+      // the first occurrence takes the goal's term as it is
+      if(e->values[k]) unified = unifyTerms(e->values[k], goal, unifier);
+      else e->values[k] = goal;
+    } else if(termIsGround(h)){
+      unified = unifyTerms(goal, h, unifier);
+    } else if(termType(goal) == TTVARIABLE){
+      Term t = instantiate(r, h, frame);
+      unified = t && unifyVariable(goal, t, unifier);
+    } else if(termIsAtomic(goal) || termName(goal) != termName(h) || termArity(goal) != termArity(h)){
+      unified = 0;
+    } else {
+      for(int i = termArity(h) - 1; i>=0; i--){
+        PUSH_TERM(&pending, termArg(h, i));
+        PUSH_TERM(&pending, termArg(goal, i));
+      }
+    }
+    if(!unified || !pending.count) break;
+    goal = pending.items[--pending.count];
+    h = pending.items[--pending.count];
+  }
+  freeTermStack(&pending);
+  if(!unified) undoBindings(unifier, mark);
+  return unified;
+}
+
+/* solveInFrame - solveArithmetic for goal of the clause frame proves,
+ * reading its variables from the environment; the left side of is/2
+ * takes the result as its value if it has none yet */
+static int solveInFrame(Resolution *r, Term goal, int frame){
+  FrameTerm f = {r, frame};
+  int right;
+  if(!evaluateWith(termArg(goal, 1), r->unifier, frameLookup, &f, &right)) return 0;
+  if(termName(goal) != SymIs){
+    int left;
+    if(!evaluateWith(termArg(goal, 0), r->unifier, frameLookup, &f, &left)) return 0;
+    return compareArithmetic(termName(goal), left, right);
+  }
+  Term value = integerTerm(right);
+  if(!value) return 0;
+  Term left = termArg(goal, 0);
+  if(termType(left) == TTVARIABLE){
+    int k = environmentVariable(&r->envs[frame], left);
+    if(!r->envs[frame].values[k]){
+      Stats.unifications++;
+      settle(r, frame, k, value);
+      return 1;
+    }
+  }
+  left = instantiate(r, left, frame);
+  return left && unify(left, value, r->unifier);
+}
+
+/* enterBody - continues with the goals of bdy at level and then with next,
+ * a cut among them dropping the choicepoints from index cut on; 0 if they
+ * fail at once. With clause set, bdy is the body of the clause unifyHead
+ * put in the environment of its frame. */
+static int enterBody(Resolution *r, Term bdy, int level, Continuation next, int cut, Term clause){
+  Engine *engine = r->engine;
+  if(!bdy){
+    r->next = next;
+    return 1;
+  }
+  int frame = bodyFrame(r, next);
+  if(!clause) r->envs[frame].clause = 0;
+  if(parallelOpen(engine) && restTerm(bdy)){
+    // a clause body is only instantiated if it may be split
+    BodySplit *split = clause ? clauseSplit(engine, clause) : NULL;
+    Term goals = clause && !split ? 0 : instantiate(r, bdy, frame);
+    Independent *groups = goals ? openIndependent(engine, split, goals, r->unifier, level, r->cancel) : NULL;
+    if(groups){
+      Choicepoint *p = newChoicepoint(r, level, next);
+      p->kind = CPGROUPS;
+      p->goal = goals;
+      p->alternatives = 0;
+      p->cut = cut;
+      p->groups = groups;
+      return retry(r);
+    }
+  }
+  r->frames[frame] = next;
+  if(r->calls) r->calls[frame] = (ProfileCall){-1, -1, 0, 0};
+  r->next = (Continuation){bdy, frame, level, cut};
+  return 1;
+}
+
+/* lastAlternative - 1 if p has nothing left to try after this alternative;
+ * level 1 cannot tell, as its answers add lemmas */
+static int lastAlternative(Choicepoint *p){
+  if(p->alternatives || p->level == 1) return 0;
+  if(p->kind == CPPRUNED) return 1;
+  if(p->kind == CPCLAUSES) return !p->clauses.ahead;
+  // answers found while the table is filled are consumed too
+  Table *t = p->answers.table;
+  return t->complete && p->answers.answer == t->count;
+}
+
+/* outerCall - 1 unless the goal of predicate continuing with frame is in
+ * a body of the same predicate */
+static int outerCall(Resolution *r, int predicate, int frame){
+  return frame < 0 || r->calls[frame].predicate != predicate;
+}
+
+/* tryAlternatives - undoes the alternative last tried by the newest
+ * choicepoint and starts its next one; 0 and the choicepoint is gone when
+ * none is left */
+static int tryAlternatives(Resolution *r){
+  Engine *engine = r->engine;
+  Unifier *unifier = r->unifier;
+  Profile *profile = engine->profile;
+  Choicepoint *p = &r->choicepoints[r->count - 1];
+  for(;;){
+    if(p->trailmark >= 0){
+      undoBindings(unifier, p->trailmark);
+      undoSettings(r, p->settingmark);
+      // a lemma or table entry keeps its terms alive
+      if(p->retained == engine->retained) termRelease(p->termmark);
+    }
+    if(engine->abort || cancelled(r->cancel)) return 0;
+    p->trailmark = unifierMark(unifier);
+    p->settingmark = r->settingcount;
+    // region of this alternative: its renamed clause and everything deeper
+    p->termmark = termMark();
+    p->retained = engine->retained;
+    if(profile) profileSwitch(profile, p->predicate, outerCall(r, p->predicate, p->next.frame));
+    if(p->kind == CPGROUPS){
+      if(nextIndependent(p->groups, unifier)){
+        r->next = p->next;
+        return 1;
       }
+      popChoicepoint(r);
+      return 0;
+    }
+    Term answer = 0;
+    StringList *clause = NULL;
+    Term builtin = 0;
+    if(p->kind == CPANSWERS){
+      Table *t = p->answers.table;
+      if(p->answers.answer < t->count) answer = t->answers[p->answers.answer++];
+    } else if(p->kind == CPBUILTIN){
+      // control goals succeed at most once
+      builtin = p->goal;
+      p->kind = CPPRUNED;
+    } else if(p->kind == CPPRUNED){
+      // nothing left of this goal
+    } else if(p->level > 1){
+      clause = p->clauses.ahead;
+      if(clause) p->clauses.ahead = nextCandidate(&p->clauses.cursor);
+    } else {
+      clause = nextCandidate(&p->clauses.cursor);
     }
-    // if(!hasStatement(WorkingKB, t)) appendStatement(WorkingKB, t);
-    //if t contains a variable, return 0
-    StringList *tstr = splitByControlChars(t);
-    StringList *tstrn = tstr;
-    while(tstrn){
-      if(typeStringListEntry(tstrn) == TTVARIABLE){
-        freeStringList(&tstr);
-        freeChar(&t);
+    if(!answer && !clause && !builtin){
+      if(profile) profileFail(profile, p->box);
+      p->goal = firstTerm(p->alternatives);
+      p->alternatives = restTerm(p->alternatives);
+      if(!p->goal){
+        popChoicepoint(r);
         return 0;
       }
-      tstrn = tstrn->next;
+      openGoal(r, p);
+      continue;
     }
-    freeStringList(&tstr);
-    printf("Yes.\n");
-    printf("Θ = %s\n", unifier);
-    printf("q = %s\n", resolvent);
-    printf("Θq = %s\n", t);
-    if(!hasStatement(WorkingKB, t)) appendStatement(WorkingKB, t);
-    freeChar(&t);
-  } else {
-    printf("No.\n");
+    Term goal = p->goal;
+    Term resolvent = goal;
+    int framed = 0;
+    if(profile && (answer || clause)) profile->entries[p->predicate].tried++;
+    if(answer){
+      if(!unify(goal, indexVariables(engine, answer), unifier)) continue;
+    } else if(clause && p->level > 1){
+      Stats.steps++;
+      if(!unifyHead(r, goal, clause->term, bodyFrame(r, p->next))) continue;
+      resolvent = clause->term;
+      framed = 1;
+    } else if(clause){
+      // the level 1 clause is presented with the answer, so it is renamed
+      Stats.steps++;
+      resolvent = renameClause(engine, goal, clause->term, unifier);
+      if(!resolvent || !unify(goal, head(resolvent), unifier)) continue;
+    }
+    if(profile && (answer || clause)) profile->entries[p->predicate].unified++;
+    int level = p->level;
+    Continuation next = p->next;
+    int cut = p->cut;
+    int predicate = p->predicate;
+    int box = p->box;
+    int index = r->count - 1;
+    if(level == 1) r->resolvent = resolvent;
+    int last = lastAlternative(p);
+    if(last) popChoicepoint(r);
+    if(answer){
+      if(profile) profileProved(profile, box);
+      r->next = next;
+      return 1;
+    }
+    if(builtin && !termArity(builtin)){
+      // ! keeps the bindings made so far and drops what is left to try
+      cutTo(r, cut);
+      if(profile) profileProved(profile, box);
+      r->next = next;
+      return 1;
+    }
+    if(builtin && isArithmetic(builtin)){
+      // arithmetic is proved or refuted at once, like a fact
+      if(!solveArithmetic(builtin, unifier)){
+        if(!last) continue;
+        if(profile) profileFail(profile, box);
+        return 0;
+      }
+      if(profile) profileProved(profile, box);
+      r->next = next;
+      return 1;
+    }
+    Term bdy = body(resolvent);
+    if(builtin){
+      // once(G) goes on with "G,!" as the body of a clause of its own
+      Term args[2] = {deref(termArg(builtin, 0), unifier), atomTerm(SymCut)};
+      if(termType(args[0]) == TTVARIABLE){
+        if(!last) continue;
+        if(profile) profileFail(profile, box);
+        return 0;
+      }
+      bdy = functorTerm(SymConjunction, 2, args);
+    }
+    if(enterBody(r, bdy, level + 1, next, index, framed ? resolvent : 0)){
+      if(profile && !bdy) profileProved(profile, box);
+      else if(profile){
+        int outer = outerCall(r, predicate, next.frame);
+        r->calls[r->next.frame] = (ProfileCall){predicate, box, outer, profileClock()};
+      }
+      return 1;
+    }
+    if(last){
+      if(profile) profileFail(profile, box);
+      return 0;
+    }
+    // enterBody may have pushed and dropped a choicepoint of its own
+    p = &r->choicepoints[r->count - 1];
   }
-  printf("More? (y/N) ");
-  char buf[10];
-  fgets(buf, 9, stdin);
-  if(buf[0] == 'Y' || buf[0] == 'y') return 0;
-  return 1;
 }
 
-char *resolve(char *goals, char *unifier, int level){
-  if(AbortResolution) return NULL;
-  if(!goals) return NULL; //copyString(unifier);
-  char *ans = NULL;
-  char *goal = firstTerm(goals);
-  char *restgoal = restTerm(goals, goal);
-  while(goal){
-    StringList *kb = WorkingKB;
-    while(kb){
-      int no = 0;
-      char *kbentry = indexVariables(kb->entry);
-      char *hed = head(kbentry);
-      ans = unify(goal, hed, unifier);
-      freeChar(&hed);
-      if(!ans){
-        freeChar(&kbentry);
-      } else {
-        // appendProof(kbentry);
-        char *a1 = compose(unifier, ans);
-        freeUnifier(&ans);
-        ans = a1;
-        char *bdy = body(kbentry);
-        char *bdyclause = NULL;
-        char *restbdy = NULL;
-        if(bdy){ 
-          bdyclause = firstTerm(bdy);
-          restbdy = restTerm(bdy, bdyclause);
-          freeChar(&bdy);
-        }
-        while(bdyclause){
-          char *ans2 = resolve(bdyclause, ans, level + 1);
-          if(AbortResolution){
-            freeUnifier(&ans);
-            freeChar(&bdyclause);
-            freeChar(&restbdy);
-            freeStringList(&Proof);
-            freeChar(&kbentry);
-            freeChar(&goal);
-            freeChar(&restgoal);
-            return NULL;
-          }
-          if(!ans2){
-            freeUnifier(&ans);
-            freeChar(&bdyclause);
-            freeChar(&restbdy);
-            freeStringList(&Proof);
-            freeChar(&kbentry);
-            no = 1;
-            break;
-          }
-          // appendProof(bdyclause);
-          char *a2 = compose(ans, ans2);
-          freeUnifier(&ans2);
-          freeUnifier(&ans);
-          ans = a2;
-          freeChar(&bdyclause);
-          if(!restbdy){ 
-            break;
-          }
-          bdyclause = firstTerm(restbdy);
-          char *rb = restTerm(restbdy, bdyclause);
-          freeChar(&restbdy);
-          restbdy = rb;
-        }
-        if(!no){
-          if(level == 1){
-            // appendResolution(ans);
-            int r = midresolveprompt(ans, kbentry);
-            // if(strcomp(unifier, "{ | }")){
-            //   freeUnifier(unifier);
-            //   unifier = malloc(6);
-            //   strcopy("{ | }", unifier);
-            // }
-            if(r){
-              AbortResolution = 1; 
-              freeChar(&kbentry);
-              freeUnifier(&ans);
-              freeChar(&goal);
-              freeChar(&restgoal);
-              return NULL;
-            }
-          } else {
-            freeChar(&kbentry);
-            freeChar(&goal);
-            freeChar(&restgoal);
-            return ans;
-          }
-        }
-        freeChar(&kbentry);
-        no = 0;
+/* retry - tryAlternatives, backtracking into the goal of the choicepoint
+ * when it was tried before and charging its time while profiling */
+static int retry(Resolution *r){
+  Profile *profile = r->engine->profile;
+  if(!profile) return tryAlternatives(r);
+  Choicepoint *p = &r->choicepoints[r->count - 1];
+  if(p->trailmark >= 0 && p->box >= 0) profileRedo(profile, p->box);
+  int proved = tryAlternatives(r);
+  profileSwitch(profile, -1, 0);
+  return proved;
+}
+
+/* push - pushes a choicepoint for goals at level, alternatives to each
+ * other in a body whose cut is cut, that continues with next, and tries the
+ * first; 0 if none proves */
+static int push(Resolution *r, Term goals, int level, Continuation next, int cut){
+  Choicepoint *p = newChoicepoint(r, level, next);
+  p->cut = cut;
+  p->goal = firstTerm(goals);
+  p->alternatives = restTerm(goals);
+  openGoal(r, p);
+  return retry(r);
+}
+
+/* call - calls the first goal of the continuation */
+static int call(Resolution *r){
+  Continuation *k = &r->next;
+  Term goal = firstTerm(k->goals);
+  Term rest = restTerm(k->goals);
+  int frame = k->frame;
+  Continuation next = {rest, frame, k->level, k->cut};
+  // a last call continues with the frame's continuation, dropping the
+  // frame, unless profiling has to see the body exit
+  if(!rest && frame >= 0 && !r->engine->profile) next = r->frames[frame];
+  // arithmetic in a clause is proved at once, unless profiling counts it
+  if(frame >= 0 && r->envs[frame].clause && !r->engine->profile && isArithmetic(goal)){
+    if(!solveInFrame(r, goal, frame)) return 0;
+    r->next = next;
+    return 1;
+  }
+  goal = instantiate(r, goal, frame);
+  if(!goal) return 0;
+  return push(r, goal, k->level, next, k->cut);
+}
+
+/* run - resolves until the goals are proved or, at level 1, until every
+ * answer has been presented; 1 leaves the bindings of the proof */
+static int run(Resolution *r, int proved){
+  Engine *engine = r->engine;
+  while(!engine->abort && !cancelled(r->cancel)){
+    if(r->unifier->cyclic){
+      // a cyclic binding in error mode ends the whole query
+      engine->cyclic = 1;
+      engine->abort = 1;
+      break;
+    }
+    if(!proved){
+      // backtrack to the newest choicepoint
+      if(!r->count){
+        if(engine->profile) profileBacktrack(engine->profile, r->boxes);
+        break;
       }
-      freeUnifier(&ans);
-      kb = kb->next;
+      proved = retry(r);
+      continue;
+    }
+    if(r->next.goals){
+      proved = call(r);
+      continue;
+    }
+    if(r->next.frame >= 0){
+      // a body proved with its frame kept, only while profiling
+      profileExit(engine->profile, &r->calls[r->next.frame]);
+      r->next = r->frames[r->next.frame];
+      continue;
+    }
+    if(r->level > 1) return 1;
+    if(r->handback){
+      // an answer that would not be shown is passed over
+      if(keepAnswer(engine, r->resolvent, r->unifier)) return 1;
+    } else if(midresolveprompt(engine, r->resolvent, r->unifier)){
+      engine->abort = 1;
+      break;
     }
-    freeChar(&goal);
-    goal = firstTerm(restgoal);
-    char *temp = restTerm(restgoal, goal);
-    freeChar(&restgoal);
-    restgoal = temp;
+    proved = 0;
   }
-  return ans;
+  while(r->count) popChoicepoint(r);
+  undoBindings(r->unifier, r->mark);
+  undoSettings(r, 0);
+  return 0;
 }
 
-int loadKB(const char *pathname){
-  char buf[B_MAX_STRING_LENGTH];
-  StringList *kb = NULL;
-  StringList *kb1 = NULL;
-  StringList *kb2 = NULL;
-  FILE *f = fopen(pathname, "r");
-  if(!f){ 
-    return 0;
+Resolution *openResolution(Engine *engine, Term goals, Unifier *unifier, int level){
+  Resolution *r = newResolution(engine, unifier, level);
+  r->goals = goals;
+  r->handback = level == 1;
+  return r;
+}
+
+int nextSolution(Resolution *r){
+  if(r->started) return run(r, 0);
+  r->started = 1;
+  if(r->engine->abort || cancelled(r->cancel)) return 0;
+  Continuation done = {0, -1, r->level, -1};
+  // level 1 goals are alternatives, as in resolve()
+  if(r->level == 1) return r->goals && run(r, push(r, r->goals, r->level, done, -1));
+  return run(r, enterBody(r, r->goals, r->level, done, -1, 0));
+}
+
+int resolve(Engine *engine, Term goals, Unifier *unifier, int level){
+  if(engine->abort) return 0;
+  if(!goals) return 0;
+  Resolution *r = newResolution(engine, unifier, level);
+  r->started = 1;
+  // goals are alternatives here, each of them called in turn
+  Continuation done = {0, -1, level, -1};
+  int result = run(r, push(r, goals, level, done, -1));
+  closeResolution(&r);
+  return result;
+}
+
+int runQuery(Engine *engine, char *text, int vm){
+  engine->query = wff(text);
+  // the query's terms go in a region of its own, given back as it ends
+  TermRegion *region = openTermRegion(NULL);
+  TermRegion *previous = useTermRegion(region);
+  Term query = parseTerm(engine->query);
+  engine->abort = 0;
+  openAccount(&engine->memory, &engine->abort);
+  engine->cyclic = 0;
+  engine->presentation.solutions = 0;
+  engine->renames = 0;
+  if(engine->profile) resetProfile(engine->profile);
+  // the VM does not table, so a KB that declares tables is interpreted
+  if(query && vm && !declaresTables(engine->kb)){
+    wamResolve(engine, query);
+  } else if(query){
+    arenaReset(engine->arena);
+    ArenaMark querymark = arenaMark(engine->arena);
+    engine->working = overlayKB(engine->kb, engine->arena);
+    openTables(engine);
+    Unifier *unifier = newUnifier();
+    unifier->occurs = engine->occurscheck;
+    // tabling and the profile keep shared state that the workers could not
+    // update safely
+    if(engine->presentation.threads > 1 && !tablesDeclared(engine) && !engine->profile){
+      openParallel(engine, engine->presentation.threads);
+      resolveParallel(engine, query, unifier);
+      closeParallel(engine);
+    } else {
+      resolve(engine, query, unifier, 1);
+    }
+    freeStringList(&engine->proof);
+    freeUnifier(&unifier);
+    closeTables(engine);
+    freeKB(&engine->working);
+    // everything the query allocated goes at once, even after an abort
+    arenaRelease(engine->arena, querymark);
   }
-  while(fgets(buf, B_MAX_STRING_LENGTH-1, f)){
-    if(!kb){
-      kb = malloc(sizeof(StringList));
-      kb->entry = NULL;
-      kb->next = NULL;
-      kb1 = kb;
+  freeChar(&engine->query);
+  useTermRegion(previous);
+  closeTermRegion(&region);
+  closeAccount();
+  return query != 0;
+}
+
+/* readClause - strips the whitespace from the clause at text[*r] and writes
+ * it back at text[*w], ending it with a 0; returns the clause, a copy when
+ * it cannot be ended in place, or NULL when it is not well formed */
+static char *readClause(char *text, size_t size, size_t *r, size_t *w){
+  if(text[*r] == ':' && (* r) + 1 < size && text[(* r) + 1] == '-'){
+    // directives are rewritten by wff and may grow, so they are copied
+    size_t start = * r;
+    while((* r) < size && text[*r] != '.') (* r)++;
+    if((* r) < size) (* r)++;
+    char *raw = malloc((* r) - start + 1);
+    memcpy(raw, text + start, (* r) - start);
+    raw[(* r) - start] = '\0';
+    char *clause = wff(raw);
+    free(raw);
+    return clause;
+  }
+  size_t start = * w;
+  int paren = 0;
+  int illegalchar = 0;
+  int ended = 0;
+  int space = 0;
+  while((* r) < size){
+    char c = text[(* r)++];
+    if(isspace((unsigned char)c)){
+      space = 1;
+      continue;
     }
-    int length = strlength(buf);
-    if(buf[length - 1] =='\n') {
-      buf[length - 1] = '\0';
-      length -= 1;
+    if(c == '(') paren++;
+    if(c == ')') paren--;
+    if(c == '{' || c == '}' || c == '|' || c == '\0') illegalchar = 1;
+    // the whitespace read is at least as long as the space kept
+    if(space && (* w) > start && separates(text[(* w) - 1], c)) text[(* w)++] = ' ';
+    space = 0;
+    text[(* w)++] = c;
+    if(c == '.'){
+      ended = 1;
+      break;
     }
-    if(length > 0){
-      char *wffterm = wff(buf);
-      length = strlength(wffterm);
-      kb1->entry = wffterm;
-      kb1->next = malloc(sizeof(StringList));
-      kb2 = kb1;
-      kb1 = kb1->next;
-      kb1->entry = NULL;
-      kb1->next = NULL;
+  }
+  char *clause = NULL;
+  if(ended && !paren && !illegalchar){
+    if((* w) < (* r)){
+      // the 0 overwrites whitespace already read
+      text[(* w)++] = '\0';
+      return text + start;
+    }
+    clause = malloc((* w) - start + 1);
+    memcpy(clause, text + start, (* w) - start);
+    clause[(* w) - start] = '\0';
+  }
+  (* w) = start;
+  return clause;
+}
+
+int loadKB(Engine *engine, const char *pathname){
+  char *text;
+  size_t size;
+  if(!mapFile(pathname, &text, &size)) return 0;
+  if(isImage(text, size)){
+    KB *image = loadImage(text, size);
+    if(image){
+      freeKB(&engine->kb);
+      engine->kb = image;
+      return 1;
     }
+    fprintf(stderr, "%s: not a KB image of version %d\n", pathname, IMAGE_VERSION);
+    unmapFile(text, size);
+    return 0;
+  }
+  KB *kb = newKB();
+  kb->text = text;
+  kb->textsize = size;
+  // each clause ends with a period, and a clause without one ends the file
+  size_t count = 1;
+  for(char *p = text; p && (p = memchr(p, '.', text + size - p)); p++) count++;
+  kb->nodes = malloc(count * sizeof(StringList));
+  StringList **tail = &kb->statements;
+  size_t r = 0;
+  size_t w = 0;
+  while(1){
+    while(r < size && isspace((unsigned char)text[r])) r++;
+    if(r >= size) break;
+    StringList *s = &kb->nodes[kb->nodecount++];
+    s->entry = readClause(text, size, &r, &w);
+    s->term = parseTerm(s->entry);
+    s->next = NULL;
+    (* tail) = s;
+    tail = &s->next;
+  }
+  for(StringList *s = kb->statements; s; s = s->next){
+    indexClause(kb->index, s);
   }
-  fclose(f);
-  freeStringList(&kb2->next);
-  kb2->next = NULL;
-  KnowledgeBase = kb;
+  freeKB(&engine->kb);
+  engine->kb = kb;
   return 1;
 }
@@ -1,18 +1,96 @@
 #ifndef PPP_H
 #define PPP_H
 
+#include "term.h"
+#include "unifier.h"
+#include "arena.h"
+#include "account.h"
 
 typedef struct STRING_LIST{
   char *entry;
+  Term term;
   struct STRING_LIST *next;
 } StringList;
 
-extern StringList *KnowledgeBase;
-extern StringList *WorkingKB;
-extern char *Query;
-extern char *Unifiers;
-extern StringList *Proof;
-extern int AbortResolution;
+typedef struct CLAUSE_INDEX ClauseIndex;
+
+/* KB - statements in order plus the clause index resolve searches; when
+ * arena is set the statements live in it and are released with it; when
+ * base is set the KB is an overlay, and the statements of base come first */
+typedef struct KNOWLEDGE_BASE{
+  StringList *statements;
+  ClauseIndex *index;
+  struct KNOWLEDGE_BASE *base;
+  Arena *arena;
+  char *text;          /* the file loadKB mapped; loaded entries point into it */
+  size_t textsize;
+  StringList *nodes;   /* the statements loadKB allocated in one block */
+  size_t nodecount;
+} KB;
+
+/* QueryCursor - answers of a query produced on request; see openQuery */
+typedef struct QUERY_CURSOR QueryCursor;
+
+/* Session - how answers are presented */
+typedef struct SESSION{
+  int batch;           /* write answers as JSON lines instead of prompting */
+  long maxsolutions;   /* stop a query after this many answers; 0 for all */
+  long solutions;      /* answers presented for the current query */
+  int query;           /* number of the current query */
+  int quiet;           /* count answers without writing them */
+  int threads;         /* worker threads for level 1 alternatives; 1 runs sequentially */
+} Session;
+
+/* EngineStats - work counters; they only grow, callers take differences */
+typedef struct ENGINE_STATS{
+  long steps;          /* clauses tried, or procedures called on the VM */
+  long unifications;   /* unify calls, or head unifications on the VM */
+} EngineStats;
+
+/* Stats - counted per thread; parallel workers add theirs when they finish */
+extern _Thread_local EngineStats Stats;
+
+typedef struct TABLING Tabling;
+typedef struct WORKER_POOL WorkerPool;
+typedef struct MACHINE Machine;
+typedef struct PROFILE Profile;
+
+/**
+ * Engine
+ *
+ * Everything one interpreter needs to answer queries: its KB, the state of
+ * the running query and how answers are presented. Engines share only the
+ * term store (term.h), which is locked once a second engine exists, so a
+ * process can run one engine per thread. Create the engines before any of
+ * them starts a query.
+ */
+typedef struct ENGINE{
+  KB *kb;              /* the KnowledgeBase loadKB reads and edits change */
+  KB *working;         /* overlay of kb holding the lemmas of the running query */
+  char *query;         /* text of the running query */
+  char *unifiers;
+  StringList *proof;
+  _Atomic int abort;   /* set to stop the query; workers of a parallel query poll it */
+  Arena *arena;        /* holds working, the overlay KB of lemmas, for one query */
+  int retained;        /* terms kept beyond their resolution region (lemmas,
+                        * answer tables); a region is only released if it
+                        * did not change */
+  unsigned int renames; /* rename indexes handed out in the running query */
+  Session presentation;
+  Tabling *tabling;    /* answer tables of the running query (table.c) */
+  WorkerPool *pool;    /* threads of a parallel query (parallel.c) */
+  Machine *machine;    /* compiled program and VM (wam.c); NULL until compileKB */
+  OccursCheck occurscheck; /* occurs check of the unifiers of a query */
+  int cyclic;          /* the running query stopped on a cyclic binding */
+  Profile *profile;    /* per-predicate counters (profile.c); NULL unless profiling */
+  MemoryAccount memory; /* memory of the running or last query and its limit */
+} Engine;
+
+/* newEngine - engine with no KB, default presentation and the occurs check on */
+Engine *newEngine(void);
+
+/* freeEngine - frees engine and its KB */
+void freeEngine(Engine **engine);
 
 void freeChar(char **charptr);
 
@@ -26,18 +104,133 @@ void printStringlist(StringList *list, int start, int count);
 
 int fprintStringlist(char *filepathname, StringList *list);
 
-void deleteStatement(StringList **strlist, int index);
+KB *newKB();
 
-void replaceStatement(StringList *strlist, int index, char *newstmnt);
+/* overlayKB - empty KB in arena on top of kb; statements appended to it
+ * leave kb as it is, and it is only valid while kb is unchanged */
+KB *overlayKB(KB *kb, Arena *arena);
 
-void insertStatement(StringList **strlist, int index, char *newstmnt);
+void freeKB(KB **kb);
 
-void appendStatement(StringList *strlist, char *newstmnt);
+/* statementAt - statement at index of kb or NULL */
+StringList *statementAt(KB *kb, int index);
+
+void deleteStatement(KB *kb, int index);
+
+void replaceStatement(KB *kb, int index, char *newstmnt);
+
+void insertStatement(KB *kb, int index, char *newstmnt);
+
+void appendStatement(KB *kb, char *newstmnt);
 
 char *wff(char *clause);
 
-int loadKB(const char *pathname);
+Term firstTerm(Term term);
+
+Term restTerm(Term term);
+
+Term head(Term clause);
+
+Term body(Term clause);
+
+int unify(Term term1, Term term2, Unifier *unifier);
+
+/* isBuiltin - 1 if goal is !, once/1 or arithmetic (arith.h), which
+ * resolve proves without clauses */
+int isBuiltin(Term goal);
+
+Term indexVariables(Engine *engine, Term term);
+
+/* renameClause - clause renamed apart, or 0 when its head cannot unify
+ * with goal; clauses that fail that check are never renamed */
+Term renameClause(Engine *engine, Term goal, Term clause, Unifier *unifier);
+
+/* presentAnswer - shows Θ, q and Θq, prompting for more unless in batch
+ * mode; returns 1 to stop the query */
+int presentAnswer(Engine *engine, Unifier *unifier, Term q, Term thetaq);
+
+/* presentAnswerText - presentAnswer with Θ already rendered; NULL when quiet */
+int presentAnswerText(Engine *engine, const char *theta, Term q, Term thetaq);
+
+/* midresolveprompt - presents a level 1 answer; returns 1 if the user stops */
+int midresolveprompt(Engine *engine, Term resolvent, Unifier *unifier);
+
+/* loadKB - maps the file at pathname and reads its clauses into the KB of
+ * engine, replacing the one it had; a clause runs to its period and may
+ * span lines. A KB image (image.h) is loaded without parsing. Returns 0 if
+ * the file cannot be opened or is a damaged image */
+int loadKB(Engine *engine, const char *pathname);
+
+/* resolve - proves goals, each an alternative to the others; at level 1
+ * every answer is presented, deeper levels return 1 on the first success
+ * and leave its bindings in unifier. Runs in constant C stack space */
+int resolve(Engine *engine, Term goals, Unifier *unifier, int level);
+
+/* Resolution - a proof of a conjunction, resumed for each further solution */
+typedef struct RESOLUTION Resolution;
+
+/* openResolution - starts proving the conjunction goals at level; at level
+ * 1 goals are the alternatives of a query, as for resolve, and each answer
+ * that would be presented is handed back by nextSolution instead, added as
+ * a lemma when ground. Nothing is proved until nextSolution */
+Resolution *openResolution(Engine *engine, Term goals, Unifier *unifier, int level);
+
+/* nextSolution - backtracks into the proof for its next solution and leaves
+ * the bindings in unifier; returns 0, with the bindings made since
+ * openResolution undone, when there are no more */
+int nextSolution(Resolution *r);
+
+/* Cancel - a flag that stops the proofs watching it once it, or the
+ * Cancel it is nested in, is set */
+typedef struct CANCEL{
+  _Atomic int set;
+  struct CANCEL *outer;
+} Cancel;
+
+/* cancelled - 1 once cancel or one it is nested in is set; 0 for NULL */
+int cancelled(Cancel *cancel);
+
+/* watchCancel - r stops, as when the query is aborted, once cancel is set */
+void watchCancel(Resolution *r, Cancel *cancel);
+
+/* resolutionCut - 1 once a cut among the goals r was opened with has run;
+ * like a cut in a clause body, it stands for the clauses after theirs */
+int resolutionCut(Resolution *r);
+
+/* closeResolution - frees r; the bindings of its last solution stay */
+void closeResolution(Resolution **r);
+
+/* runQuery - resolves the query text following "?-" on the interpreter or,
+ * with vm set, on the compiled program; returns 0 if it does not parse */
+int runQuery(Engine *engine, char *text, int vm);
+
+/**
+ * Query cursors
+ *
+ * A cursor hands out the answers of a query one at a time, as they are
+ * asked for, instead of writing them and prompting. The query is a level 1
+ * Resolution on the caller's thread: each request resumes it until its next
+ * answer, and closing the cursor early drops what it had left to try. An
+ * engine runs one query at a time, so it has at most one open cursor.
+ */
+
+/* Binding - a variable of the query and its value in an answer */
+typedef struct BINDING{
+  Term variable;
+  Term value;
+} Binding;
 
-char *resolve(char *goal, char *unifier, int level);
+/* openQuery - cursor on the answers over the KB of engine of the query text
+ * following "?-"; NULL if it does not parse. Nothing is proved until
+ * nextAnswer */
+QueryCursor *openQuery(Engine *engine, const char *text);
 
-#endif
\ No newline at end of file
+/* nextAnswer - proves the next answer; bindings gets the values of the
+ * query variables in order of first appearance, valid until the next call
+ * or closeQuery. Returns 0 when there are no more answers */
+int nextAnswer(QueryCursor *cursor, const Binding **bindings, int *count);
+
+/* closeQuery - ends the search and frees cursor */
+void closeQuery(QueryCursor **cursor);
+
+#endif
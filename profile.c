@@ -0,0 +1,197 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Brian O'Dell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "profile.h"
+#include "utils.h"
+
+void startProfile(Engine *engine){
+  if(engine->profile) return;
+  Profile *profile = calloc(1, sizeof(Profile));
+  initKeyTable(&profile->predicates);
+  profile->current = -1;
+  engine->profile = profile;
+}
+
+void stopProfile(Engine *engine){
+  Profile *profile = engine->profile;
+  if(!profile) return;
+  free(profile->predicates.keys);
+  free(profile->predicates.values);
+  free(profile->entries);
+  free(profile->boxes);
+  free(profile);
+  engine->profile = NULL;
+}
+
+void resetProfile(Profile *profile){
+  for(int i = 0; i<profile->count; i++){
+    unsigned long long key = profile->entries[i].key;
+    profile->entries[i] = (PredicateProfile){0};
+    profile->entries[i].key = key;
+  }
+  profile->current = -1;
+  profile->boxcount = 0;
+}
+
+long long profileClock(void){
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+int profilePredicate(Profile *profile, Term goal){
+  unsigned long long key = termKey(goal);
+  intptr_t found = (intptr_t)getKey(&profile->predicates, key);
+  if(found) return (int)found - 1;
+  if(profile->count == profile->size){
+    profile->size = profile->size ? profile->size * 2 : 16;
+    profile->entries = realloc(profile->entries, profile->size * sizeof(PredicateProfile));
+  }
+  profile->entries[profile->count] = (PredicateProfile){0};
+  profile->entries[profile->count].key = key;
+  putKey(&profile->predicates, key, (void *)(intptr_t)(profile->count + 1));
+  return profile->count++;
+}
+
+void profileSwitch(Profile *profile, int predicate, int outer){
+  long long now = profileClock();
+  if(profile->current >= 0){
+    PredicateProfile *e = &profile->entries[profile->current];
+    e->self += now - profile->since;
+    if(profile->outer) e->total += now - profile->since;
+  }
+  profile->current = predicate;
+  profile->outer = outer;
+  profile->since = now;
+}
+
+int profileCall(Profile *profile, int predicate, int parent){
+  if(profile->boxcount == profile->boxsize){
+    profile->boxsize = profile->boxsize ? profile->boxsize * 2 : 64;
+    profile->boxes = realloc(profile->boxes, profile->boxsize * sizeof(ProfileBox));
+  }
+  profile->entries[predicate].calls++;
+  profile->boxes[profile->boxcount] = (ProfileBox){predicate, parent, BOXOPEN};
+  return profile->boxcount++;
+}
+
+void profileProved(Profile *profile, int box){
+  ProfileBox *b = &profile->boxes[box];
+  profile->entries[b->predicate].exits++;
+  b->state = BOXEXITED;
+}
+
+void profileFail(Profile *profile, int box){
+  ProfileBox *b = &profile->boxes[box];
+  profile->entries[b->predicate].fails++;
+  b->state = BOXFAILED;
+}
+
+void profileExit(Profile *profile, ProfileCall *call){
+  if(call->predicate < 0) return;
+  long long now = profileClock();
+  PredicateProfile *e = &profile->entries[call->predicate];
+  profileProved(profile, call->box);
+  if(call->outer) e->total += now - call->start;
+  call->start = now;
+}
+
+void profileRedo(Profile *profile, int box){
+  profileBacktrack(profile, box + 1);
+  // a goal exits only after the goals of its body, so the exited boxes
+  // are the innermost ones
+  for(int b = box; b >= 0 && profile->boxes[b].state == BOXEXITED; b = profile->boxes[b].parent){
+    profile->entries[profile->boxes[b].predicate].redos++;
+    profile->boxes[b].state = BOXOPEN;
+  }
+}
+
+void profileBacktrack(Profile *profile, int top){
+  for(int b = profile->boxcount - 1; b >= top; b--){
+    if(profile->boxes[b].state == BOXOPEN) profileFail(profile, b);
+  }
+  if(top < profile->boxcount) profile->boxcount = top;
+}
+
+/* predicateName - name/arity of e */
+static void predicateName(PredicateProfile *e, char *buf, size_t size){
+  snprintf(buf, size, "%s/%u", symbolName((Symbol)(e->key >> 32)), (unsigned int)e->key);
+}
+
+static int bySelf(const void *a, const void *b){
+  const PredicateProfile *x = a, *y = b;
+  if(x->self != y->self) return x->self < y->self ? 1 : -1;
+  return x->key < y->key ? -1 : x->key > y->key;
+}
+
+/* sortedEntries - copy of the entries that were called, most self time
+ * first; the caller frees it */
+static PredicateProfile *sortedEntries(Profile *profile, int *count){
+  PredicateProfile *sorted = malloc((profile->count ? profile->count : 1) * sizeof(PredicateProfile));
+  *count = 0;
+  for(int i = 0; i<profile->count; i++){
+    if(profile->entries[i].calls) sorted[(*count)++] = profile->entries[i];
+  }
+  qsort(sorted, *count, sizeof(PredicateProfile), bySelf);
+  return sorted;
+}
+
+void printProfile(Profile *profile, FILE *out){
+  int count;
+  PredicateProfile *sorted = sortedEntries(profile, &count);
+  fprintf(out, "%-20s %9s %9s %9s %9s %9s %9s %10s %10s\n", "predicate",
+    "calls", "exits", "redos", "fails", "tried", "unified", "total ms", "self ms");
+  char name[64];
+  for(int i = 0; i<count; i++){
+    PredicateProfile *e = &sorted[i];
+    predicateName(e, name, sizeof(name));
+    fprintf(out, "%-20s %9ld %9ld %9ld %9ld %9ld %9ld %10.3f %10.3f\n", name,
+      e->calls, e->exits, e->redos, e->fails, e->tried, e->unified,
+      e->total / 1e6, e->self / 1e6);
+  }
+  free(sorted);
+}
+
+void writeProfileJSON(Profile *profile, FILE *out, int query){
+  int count;
+  PredicateProfile *sorted = sortedEntries(profile, &count);
+  fprintf(out, "{\"query\":%d,\"profile\":[", query);
+  char name[64];
+  for(int i = 0; i<count; i++){
+    PredicateProfile *e = &sorted[i];
+    predicateName(e, name, sizeof(name));
+    fprintf(out, "%s{\"predicate\":", i ? "," : "");
+    outputJSONString(out, name);
+    fprintf(out, ",\"calls\":%ld,\"exits\":%ld,\"redos\":%ld,\"fails\":%ld,"
+      "\"tried\":%ld,\"unified\":%ld,\"time_ms\":%.3f,\"self_ms\":%.3f}",
+      e->calls, e->exits, e->redos, e->fails, e->tried, e->unified,
+      e->total / 1e6, e->self / 1e6);
+  }
+  fprintf(out, "]}\n");
+  free(sorted);
+}
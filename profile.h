@@ -0,0 +1,155 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Brian O'Dell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PPP_PROFILE
+#define PPP_PROFILE
+
+#include <stdio.h>
+
+#include "ppp.h"
+#include "index.h"
+
+/**
+ * Profile
+ *
+ * Counts, per predicate (name/arity), the ports of the goals resolve()
+ * calls: a call when the goal is first tried, an exit each time it is
+ * proved, a redo each time backtracking returns into it after an exit and
+ * a fail when it has nothing left to try, so calls + redos = exits + fails
+ * for every goal that is not cut away or stopped. Candidate clauses (or
+ * table answers) tried are counted apart from those whose head unified.
+ *
+ * Each goal called gets a box, kept until backtracking leaves it, that
+ * records whether the goal has exited and the box of the clause body it
+ * is in. Backtracking to a choicepoint redoes its goal and every enclosing
+ * goal that had exited, and fails every goal still open since it.
+ *
+ * Self time is the time spent choosing, renaming and unifying the
+ * predicate's own clauses; that is where unify, substitute and
+ * indexVariables run for it. Total time adds the time from the entry of
+ * each of its clause bodies to the body's exit, or from one exit to the
+ * next when backtracking proves the body again. A call made within a body
+ * of the same predicate is already inside that time, so direct recursion
+ * is counted once; mutual recursion is counted at every level.
+ *
+ * Profiling is off unless startProfile is called; resolution then only
+ * tests engine->profile. While it is on, the last goal of a body keeps the
+ * body's frame so the exit can be seen, and queries run sequentially.
+ */
+
+typedef struct PREDICATE_PROFILE{
+  unsigned long long key;  /* name/arity, see termKey */
+  long calls;
+  long exits;
+  long redos;
+  long fails;
+  long tried;              /* candidate clauses and answers tried */
+  long unified;            /* of those, the ones whose head unified */
+  long long total;         /* nanoseconds, see above */
+  long long self;
+} PredicateProfile;
+
+/* ProfileCall - the clause whose body a frame proves, and when it was
+ * called or last exited */
+typedef struct PROFILE_CALL{
+  int predicate;           /* -1 for the query's own goals */
+  int box;                 /* box of the goal the clause was chosen for */
+  int outer;               /* not within a body of the same predicate */
+  long long start;
+} ProfileCall;
+
+typedef enum
+{
+  BOXOPEN, BOXEXITED, BOXFAILED
+}BoxState;
+
+/* ProfileBox - a goal called and not yet backtracked over */
+typedef struct PROFILE_BOX{
+  int predicate;
+  int parent;              /* box of the body it is in; -1 for none */
+  BoxState state;
+} ProfileBox;
+
+struct PROFILE{
+  KeyTable predicates;     /* key to entry index + 1 */
+  PredicateProfile *entries;
+  int count;
+  int size;
+  int current;             /* entry being charged self time; -1 for none */
+  int outer;               /* current's time counts as total time too */
+  long long since;         /* when it started being charged */
+  ProfileBox *boxes;       /* oldest first */
+  int boxcount;
+  int boxsize;
+};
+
+/* startProfile - turns profiling on for engine's later queries */
+void startProfile(Engine *engine);
+
+/* stopProfile - turns profiling off and discards the counters */
+void stopProfile(Engine *engine);
+
+/* resetProfile - zeroes the counters; runQuery calls it per query */
+void resetProfile(Profile *profile);
+
+/* profileClock - monotonic time in nanoseconds */
+long long profileClock(void);
+
+/* profilePredicate - index of goal's entry, added on first use */
+int profilePredicate(Profile *profile, Term goal);
+
+/* profileSwitch - charges the time since the last switch to the current
+ * entry and makes predicate (-1 for none) the current one; outer as for
+ * ProfileCall */
+void profileSwitch(Profile *profile, int predicate, int outer);
+
+/* profileCall - counts a call of predicate in the body of box parent and
+ * returns the goal's box */
+int profileCall(Profile *profile, int predicate, int parent);
+
+/* profileProved - counts an exit of the goal of box */
+void profileProved(Profile *profile, int box);
+
+/* profileFail - counts a fail of the goal of box */
+void profileFail(Profile *profile, int box);
+
+/* profileExit - counts an exit of the body of call and its total time */
+void profileExit(Profile *profile, ProfileCall *call);
+
+/* profileRedo - backtracking into the goal of box: fails the goals still
+ * open in the boxes after it, which it drops, and counts a redo of each
+ * exited goal from box outwards */
+void profileRedo(Profile *profile, int box);
+
+/* profileBacktrack - fails the goals still open in the boxes from top on
+ * and drops them */
+void profileBacktrack(Profile *profile, int top);
+
+/* printProfile - writes a table of the entries, most self time first */
+void printProfile(Profile *profile, FILE *out);
+
+/* writeProfileJSON - writes the entries as one JSON line for query */
+void writeProfileJSON(Profile *profile, FILE *out, int query);
+
+#endif
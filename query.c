@@ -0,0 +1,154 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Brian O'Dell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ppp.h"
+#include "table.h"
+#include "profile.h"
+#include "utils.h"
+
+struct QUERY_CURSOR{
+  Engine *engine;
+  char *text;
+  TermRegion *region;  /* holds the terms of the query */
+  Term query;
+  Term *variables;     /* variables of the query in order of first appearance */
+  Binding *bindings;
+  int count;
+  int size;
+  Unifier *unifier;
+  Resolution *resolution; /* the running query; NULL before and after it */
+  ArenaMark querymark; /* the arena as it was before the query */
+  int done;
+};
+
+/* addVariables - adds the variables of t not seen yet */
+static void addVariables(QueryCursor *cursor, Term t){
+  TermStack pending;
+  initTermStack(&pending);
+  for(;;){
+    if(termType(t) == TTVARIABLE){
+      int i = 0;
+      while(i<cursor->count && cursor->variables[i] != t) i++;
+      if(i == cursor->count){
+        if(cursor->count == cursor->size){
+          cursor->size = cursor->size ? cursor->size * 2 : 8;
+          cursor->variables = realloc(cursor->variables, cursor->size * sizeof(Term));
+        }
+        cursor->variables[cursor->count++] = t;
+      }
+    } else if(!termIsGround(t)){
+      for(int i = termArity(t) - 1; i>=0; i--) PUSH_TERM(&pending, termArg(t, i));
+    }
+    if(!pending.count) break;
+    t = pending.items[--pending.count];
+  }
+  freeTermStack(&pending);
+}
+
+QueryCursor *openQuery(Engine *engine, const char *text){
+  QueryCursor *cursor = calloc(1, sizeof(QueryCursor));
+  cursor->region = openTermRegion(NULL);
+  TermRegion *previous = useTermRegion(cursor->region);
+  char *raw = copyString(text);
+  cursor->text = wff(raw);
+  freeChar(&raw);
+  cursor->query = cursor->text ? parseTerm(cursor->text) : 0;
+  useTermRegion(previous);
+  if(!cursor->query){
+    closeTermRegion(&cursor->region);
+    freeChar(&cursor->text);
+    free(cursor);
+    return NULL;
+  }
+  cursor->engine = engine;
+  addVariables(cursor, cursor->query);
+  cursor->bindings = malloc((cursor->count ? cursor->count : 1) * sizeof(Binding));
+  cursor->unifier = newUnifier();
+  cursor->unifier->occurs = engine->occurscheck;
+  return cursor;
+}
+
+/* startCursor - sets the engine up for the query as runQuery does and
+ * opens its resolution */
+static void startCursor(QueryCursor *cursor){
+  Engine *engine = cursor->engine;
+  arenaReset(engine->arena);
+  cursor->querymark = arenaMark(engine->arena);
+  engine->working = overlayKB(engine->kb, engine->arena);
+  openTables(engine);
+  engine->abort = 0;
+  openAccount(&engine->memory, &engine->abort);
+  engine->cyclic = 0;
+  engine->renames = 0;
+  if(engine->profile) resetProfile(engine->profile);
+  cursor->resolution = openResolution(engine, cursor->query, cursor->unifier, 1);
+}
+
+/* endCursor - ends the resolution of the query and frees what it kept */
+static void endCursor(QueryCursor *cursor){
+  Engine *engine = cursor->engine;
+  cursor->done = 1;
+  if(!cursor->resolution) return;
+  closeResolution(&cursor->resolution);
+  freeStringList(&engine->proof);
+  closeTables(engine);
+  freeKB(&engine->working);
+  arenaRelease(engine->arena, cursor->querymark);
+  closeAccount();
+}
+
+int nextAnswer(QueryCursor *cursor, const Binding **bindings, int *count){
+  if(!cursor || cursor->done) return 0;
+  TermRegion *previous = useTermRegion(cursor->region);
+  if(!cursor->resolution) startCursor(cursor);
+  int answered = nextSolution(cursor->resolution);
+  if(answered){
+    for(int i = 0; i<cursor->count; i++){
+      cursor->bindings[i].variable = cursor->variables[i];
+      cursor->bindings[i].value = substitute(cursor->variables[i], cursor->unifier);
+    }
+  } else {
+    endCursor(cursor);
+  }
+  useTermRegion(previous);
+  if(!answered) return 0;
+  if(bindings) (* bindings) = cursor->bindings;
+  if(count) (* count) = cursor->count;
+  return 1;
+}
+
+void closeQuery(QueryCursor **cursor){
+  if(!(* cursor)) return;
+  QueryCursor *c = * cursor;
+  TermRegion *previous = useTermRegion(c->region);
+  endCursor(c);
+  useTermRegion(previous);
+  freeUnifier(&c->unifier);
+  closeTermRegion(&c->region);
+  freeChar(&c->text);
+  free(c->variables);
+  free(c->bindings);
+  free(c);
+  (* cursor) = NULL;
+}
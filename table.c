@@ -0,0 +1,267 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Brian O'Dell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+
+#include "table.h"
+#include "utils.h"
+
+/* Evaluation - the table being filled and the renamed call solved for it */
+typedef struct EVALUATION{
+  Table *table;
+  Term call;
+} Evaluation;
+
+/* VarList - variables of a term in order of first occurrence */
+typedef struct VAR_LIST{
+  Term *vars;
+  int count;
+  int size;
+} VarList;
+
+/* Tabling - the tables of the running query and those being filled */
+struct TABLING{
+  KeyTable tabled;     /* keys of the tabled predicates */
+  KeyTable tables;     /* call variant to its table */
+  Table **stack;       /* tables being evaluated, oldest first */
+  int stackcount;
+  int stacksize;
+  Table **pending;     /* evaluated tables that complete with an older one */
+  int pendingcount;
+  int pendingsize;
+  int answers;         /* answers added to any table */
+};
+
+static void pushTable(Table ***list, int *count, int *size, Table *t){
+  if(* count == * size){
+    (* size) = (* size) ? (* size) * 2 : 16;
+    (* list) = realloc(* list, (* size) * sizeof(Table *));
+  }
+  (* list)[(* count)++] = t;
+}
+
+/* tableSpec - key of a name/arity term; 0 if it is not one */
+static unsigned long long tableSpec(Term spec){
+  if(termName(spec) != SymDivide || termArity(spec) != 2) return 0;
+  Term name = termArg(spec, 0);
+  Term arity = termArg(spec, 1);
+  if(termType(name) != TTATOM || termType(arity) != TTINTEGER) return 0;
+  if(termInteger(arity) < 0) return 0;
+  return ((unsigned long long)termName(name) << 32) | (unsigned int)termInteger(arity);
+}
+
+void openTables(Engine *engine){
+  closeTables(engine);
+  Tabling *tabling = calloc(1, sizeof(Tabling));
+  initKeyTable(&tabling->tabled);
+  initKeyTable(&tabling->tables);
+  engine->tabling = tabling;
+  Symbol table = intern("table", 5);
+  for(KB *kb = engine->working; kb; kb = kb->base){
+    KeyTable *directives = &kb->index->directives;
+    for(int d = 0; d<directives->size; d++){
+      StringList *s = directives->values[d];
+      if(!s) continue;
+      Term directive = termArg(s->term, 0);
+      if(termName(directive) != table) continue;
+      for(int i = 0; i<termArity(directive); i++){
+        unsigned long long key = tableSpec(termArg(directive, i));
+        if(key) putKey(&tabling->tabled, key, tabling);
+      }
+    }
+  }
+}
+
+int declaresTables(KB *kb){
+  Symbol table = intern("table", 5);
+  for(; kb; kb = kb->base){
+    KeyTable *directives = &kb->index->directives;
+    for(int d = 0; d<directives->size; d++){
+      StringList *s = directives->values[d];
+      if(s && termName(termArg(s->term, 0)) == table) return 1;
+    }
+  }
+  return 0;
+}
+
+void closeTables(Engine *engine){
+  Tabling *tabling = engine->tabling;
+  if(!tabling) return;
+  for(int i = 0; i<tabling->tables.size; i++){
+    Table *t = tabling->tables.values[i];
+    if(!t) continue;
+    accountFree(MEMTABLES, t->answers, t->size * sizeof(Term));
+    free(t->seen.keys);
+    free(t->seen.values);
+    accountFree(MEMTABLES, t, sizeof(Table));
+  }
+  free(tabling->tables.keys);
+  free(tabling->tables.values);
+  free(tabling->tabled.keys);
+  free(tabling->tabled.values);
+  free(tabling->stack);
+  free(tabling->pending);
+  free(tabling);
+  engine->tabling = NULL;
+}
+
+int tablesDeclared(Engine *engine){
+  return engine->tabling && engine->tabling->tabled.count;
+}
+
+int isTabled(Engine *engine, Term goal){
+  Tabling *tabling = engine->tabling;
+  if(!tabling || !tabling->tabled.count) return 0;
+  return getKey(&tabling->tabled, termKey(goal)) != NULL;
+}
+
+/* numberVars - copies t with its variables replaced by _0, _1, ... in order
+ * of first occurrence, so variant terms share one handle; names starting
+ * with _ are atoms to the parser and cannot clash with KB variables */
+static int numberVisit(Term *t, void *context){
+  VarList *vars = context;
+  if(termType(* t) != TTVARIABLE) return termIsGround(* t);
+  int i = 0;
+  while(i<vars->count && vars->vars[i] != (* t)) i++;
+  if(i == vars->count){
+    if(vars->count == vars->size){
+      vars->size = vars->size ? vars->size * 2 : 8;
+      vars->vars = realloc(vars->vars, vars->size * sizeof(Term));
+    }
+    vars->vars[vars->count++] = (* t);
+  }
+  // renaming keeps names, so each position needs its own name
+  char name[16];
+  int length = sprintf(name, "_%d", i);
+  (* t) = variableTerm(intern(name, length), -1);
+  return 1;
+}
+
+static Term numberVars(Term t, VarList *vars){
+  return mapTerm(t, numberVisit, vars);
+}
+
+static Term variantOf(Term t, Unifier *unifier){
+  VarList vars = {NULL, 0, 0};
+  Term v = numberVars(substitute(t, unifier), &vars);
+  free(vars.vars);
+  return v;
+}
+
+static void addAnswer(Engine *engine, Evaluation *e, Unifier *unifier){
+  Table *t = e->table;
+  Term answer = variantOf(e->call, unifier);
+  if(getKey(&t->seen, answer)) return;
+  if(t->count == t->size){
+    int size = t->size ? t->size * 2 : 8;
+    t->answers = accountRealloc(MEMTABLES, t->answers, t->size * sizeof(Term), size * sizeof(Term));
+    t->size = size;
+  }
+  t->answers[t->count++] = answer;
+  putKey(&t->seen, answer, t);
+  engine->tabling->answers++;
+  engine->retained++;
+}
+
+/* solveClauses - adds every solution of e's call to its table */
+static void solveClauses(Engine *engine, Evaluation *e, Unifier *unifier){
+  Term goal = e->call;
+  Term firstarg = termArity(goal) ? deref(termArg(goal, 0), unifier) : 0;
+  ClauseCursor cursor;
+  openClauses(engine->working, goal, firstarg, &cursor);
+  StringList *kb;
+  int cut = 0;
+  while((kb = nextClause(&cursor)) && !engine->abort){
+    if(!kb->term) continue;
+    int mark = unifierMark(unifier);
+    Term termmark = termMark();
+    int retained = engine->retained;
+    Stats.steps++;
+    Term clause = renameClause(engine, goal, kb->term, unifier);
+    if(clause && unify(goal, head(clause), unifier)){
+      Resolution *r = openResolution(engine, body(clause), unifier, 2);
+      while(nextSolution(r)) addAnswer(engine, e, unifier);
+      cut = resolutionCut(r);
+      closeResolution(&r);
+    }
+    undoBindings(unifier, mark);
+    if(retained == engine->retained) termRelease(termmark);
+    // a cut in the body commits the call to this clause
+    if(cut) break;
+  }
+}
+
+/* evaluate - fills t until a pass over its clauses adds no answer anywhere */
+static void evaluate(Engine *engine, Table *t, Unifier *unifier){
+  Tabling *tabling = engine->tabling;
+  t->evaluating = 1;
+  t->depth = tabling->stackcount;
+  t->leader = tabling->stackcount;
+  pushTable(&tabling->stack, &tabling->stackcount, &tabling->stacksize, t);
+  int pending = tabling->pendingcount;
+  int before;
+  do {
+    before = tabling->answers;
+    int mark = unifierMark(unifier);
+    Term termmark = termMark();
+    int retained = engine->retained;
+    Evaluation e = {t, indexVariables(engine, t->variant)};
+    if(e.call) solveClauses(engine, &e, unifier);
+    undoBindings(unifier, mark);
+    if(retained == engine->retained) termRelease(termmark);
+  } while(tabling->answers != before && !engine->abort);
+  tabling->stackcount--;
+  t->evaluating = 0;
+  if(t->leader == t->depth){
+    t->complete = 1;
+    for(int i = pending; i<tabling->pendingcount; i++) tabling->pending[i]->complete = 1;
+    tabling->pendingcount = pending;
+  } else {
+    // t used an older table that is still being filled; it completes with it
+    pushTable(&tabling->pending, &tabling->pendingcount, &tabling->pendingsize, t);
+    Table *caller = tabling->stack[tabling->stackcount - 1];
+    if(t->leader < caller->leader) caller->leader = t->leader;
+  }
+}
+
+Table *callTable(Engine *engine, Term goal, Unifier *unifier){
+  Tabling *tabling = engine->tabling;
+  Term variant = variantOf(goal, unifier);
+  Table *t = getKey(&tabling->tables, variant);
+  if(!t){
+    t = accountAlloc(MEMTABLES, sizeof(Table));
+    (* t) = (Table){0};
+    t->variant = variant;
+    initKeyTable(&t->seen);
+    putKey(&tabling->tables, variant, t);
+    engine->retained++;
+  }
+  if(t->evaluating){
+    Table *caller = tabling->stack[tabling->stackcount - 1];
+    if(t->depth < caller->leader) caller->leader = t->depth;
+  } else if(!t->complete){
+    evaluate(engine, t, unifier);
+  }
+  return t;
+}
@@ -0,0 +1,79 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Brian O'Dell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PPP_TABLE
+#define PPP_TABLE
+
+#include "ppp.h"
+#include "index.h"
+
+/**
+ * Tabling
+ *
+ * ":- table name/arity." marks a predicate as tabled. Each call variant of
+ * a tabled predicate (the call with its variables numbered apart) gets an
+ * answer table. The table is filled by evaluating the predicate's clauses
+ * for every solution and repeating until no new answer appears. A variant
+ * call met while its own table is still being filled consumes the answers
+ * found so far instead of recursing, so left recursion terminates.
+ *
+ * Tables that depend on each other complete together: the oldest table in
+ * the group keeps iterating until none of them gains an answer.
+ */
+
+typedef struct TABLE{
+  Term variant;        /* the call, variables numbered apart */
+  Term *answers;       /* answers in the order found, numbered apart */
+  int count;
+  int size;
+  KeyTable seen;       /* answers already in the table */
+  int complete;
+  int evaluating;
+  int depth;           /* position on the evaluation stack */
+  int leader;          /* lowest stack position this table depends on */
+} Table;
+
+/* openTables - reads the table directives of engine's working KB; tables
+ * last until closeTables */
+void openTables(Engine *engine);
+
+/* declaresTables - returns 1 if kb or a KB it overlays has a table
+ * directive, without opening its tables */
+int declaresTables(KB *kb);
+
+/* tablesDeclared - returns 1 if the open KB tables any predicate */
+int tablesDeclared(Engine *engine);
+
+/* closeTables - discards every table and directive */
+void closeTables(Engine *engine);
+
+/* isTabled - returns 1 if goal's predicate is tabled */
+int isTabled(Engine *engine, Term goal);
+
+/* callTable - returns the table of goal's variant, filled to its fixpoint
+ * unless goal is met while that table is being filled; resolve() tries the
+ * answers in order */
+Table *callTable(Engine *engine, Term goal, Unifier *unifier);
+
+#endif
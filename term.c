@@ -0,0 +1,1346 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Brian O'Dell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <ctype.h>
+#include <limits.h>
+#include <pthread.h>
+
+#include "term.h"
+#include "account.h"
+#include "utils.h"
+
+typedef struct TERM_CELL{
+  TermType type;
+  Symbol name;
+  int index;          /* arity of functors; rename index of variables */
+  unsigned int args;  /* offset of first argument in Args */
+  unsigned int slot;  /* binding slot of variables */
+  unsigned int vars;  /* variable summary, see termVariables */
+  unsigned int hash;
+  Term next;          /* next cell in the same hash bucket */
+} TermCell;
+
+/*
+ * Cells and argument lists live in fixed-size chunks that are never moved,
+ * so a handle can be read without locking while other threads add terms.
+ * The arguments of one cell never straddle two chunks, except that a list
+ * longer than a chunk starts a run of chunks of its own. Once the chunks
+ * run out no term is added: the constructors return 0 and the query of
+ * the calling thread is stopped (exhaustMemory).
+ */
+#define CHUNK_BITS 14
+#define CHUNK_SIZE (1u << CHUNK_BITS)
+#define CHUNK_MASK (CHUNK_SIZE - 1)
+#define MAX_CHUNKS (1u << 18)
+
+#define CELL(t) (&CellChunks[(t) >> CHUNK_BITS][(t) & CHUNK_MASK])
+#define ARG(o) (ArgChunks[(o) >> CHUNK_BITS][(o) & CHUNK_MASK])
+
+Symbol SymConjunction;
+Symbol SymClause;
+Symbol SymCut;
+Symbol SymOnce;
+Symbol SymIs, SymArithEqual, SymArithNotEqual;
+Symbol SymLess, SymLessEqual, SymGreater, SymGreaterEqual;
+Symbol SymPlus, SymMinus, SymTimes, SymDivide, SymIntDivide, SymMod;
+Symbol SymInteger;
+
+static char **SymbolNames;
+static unsigned int *SymbolHashes;
+static Symbol *SymbolNext;
+static Symbol *SymbolBuckets;
+static unsigned int SymbolCount;
+static unsigned int SymbolSize;
+static unsigned int SymbolBucketCount;
+
+static TermCell *CellChunks[MAX_CHUNKS];
+static unsigned int CellCount;
+static Term *ArgChunks[MAX_CHUNKS];
+static unsigned int ArgCount;
+static Term *Buckets;
+static unsigned int BucketCount;
+static unsigned int SlotCount;
+/* StoreFull - a term could not be added since room was last released */
+static int StoreFull;
+
+/*
+ * A region (openTermRegion) takes its cells and argument slots in blocks,
+ * each under a chunk index of its own. The store's chunks count up from 0
+ * and the regions' down from the top, so the store's handles only grow
+ * while regions are open. A block starts at MIN_BLOCK entries and doubles
+ * up to a chunk; a list of arguments longer than a chunk takes a run of
+ * chunks. The chunks of a block a region gives back are kept for the next
+ * region needing a block of that size.
+ */
+#define MIN_BLOCK_BITS 6
+#define MIN_BLOCK (1u << MIN_BLOCK_BITS)
+#define BLOCK_CLASSES (CHUNK_BITS - MIN_BLOCK_BITS + 1)
+
+/* Block - the chunk holding positions start ... start+size-1 of a region,
+ * the first of a run when size is more than a chunk */
+typedef struct BLOCK{
+  unsigned int chunk;
+  unsigned int start;
+  unsigned int size;
+} Block;
+
+/* BlockList - the blocks of a region's cells or arguments in position
+ * order; positions before used are taken and current holds used itself.
+ * Blocks after current are kept from before a release. */
+typedef struct BLOCK_LIST{
+  Block *blocks;
+  int count;
+  int size;
+  int current;
+  unsigned int used;
+} BlockList;
+
+struct TERM_REGION{
+  TermRegion *parent;
+  unsigned int limit;  /* cells of the parent it sees, or of the store if none */
+  int depth;           /* 1 without a parent */
+  BlockList cells;
+  BlockList args;
+  Term *buckets;
+  unsigned int bucketcount;
+  unsigned int slots;  /* slots of its variables start where the parent's were */
+  int full;            /* as StoreFull */
+};
+
+/* BlockPool - chunk indices given back, by block size, and the lowest
+ * index the regions have taken */
+typedef struct BLOCK_POOL{
+  unsigned int *free[BLOCK_CLASSES];
+  int count[BLOCK_CLASSES];
+  int size[BLOCK_CLASSES];
+  unsigned int frontier;
+} BlockPool;
+
+static BlockPool CellPool;
+static BlockPool ArgPool;
+/* the region holding each cell chunk, NULL for the store, and the
+ * position of the chunk's first entry in it */
+static TermRegion *CellOwners[MAX_CHUNKS];
+static unsigned int CellStarts[MAX_CHUNKS];
+static unsigned int ArgStarts[MAX_CHUNKS];
+/* Region - the region the thread adds terms to; NULL for the store */
+static _Thread_local TermRegion *Region;
+
+static pthread_mutex_t StoreLock = PTHREAD_MUTEX_INITIALIZER;
+/* StoreShared - users sharing the store besides the first */
+static _Atomic int StoreShared;
+
+/* lockStore - locks the store if it is shared; returns 1 if it did, for
+ * unlockStore, as the store may stop being shared in between */
+static int lockStore(){
+  if(!StoreShared) return 0;
+  pthread_mutex_lock(&StoreLock);
+  return 1;
+}
+
+static void unlockStore(int locked){
+  if(locked) pthread_mutex_unlock(&StoreLock);
+}
+
+void shareTermStore(int shared){
+  if(shared) StoreShared++;
+  else StoreShared--;
+}
+
+int termStoreShared(void){
+  return StoreShared > 0;
+}
+
+static unsigned int hashName(const char *name, int length){
+  unsigned int h = 2166136261u;
+  for(int i = 0; i<length; i++){
+    h ^= (unsigned char)name[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static void rehashSymbols(){
+  SymbolBucketCount *= 2;
+  free(SymbolBuckets);
+  SymbolBuckets = calloc(SymbolBucketCount, sizeof(Symbol));
+  for(Symbol s = 1; s<SymbolCount; s++){
+    unsigned int b = SymbolHashes[s] & (SymbolBucketCount - 1);
+    SymbolNext[s] = SymbolBuckets[b];
+    SymbolBuckets[b] = s;
+  }
+}
+
+static Symbol findSymbol(const char *name, int length, unsigned int h){
+  Symbol s = SymbolBuckets[h & (SymbolBucketCount - 1)];
+  while(s){
+    const char *n = SymbolNames[s];
+    if(SymbolHashes[s] == h && strlength(n) == length){
+      int i = 0;
+      while(i<length && n[i] == name[i]) i++;
+      if(i == length) return s;
+    }
+    s = SymbolNext[s];
+  }
+  return 0;
+}
+
+Symbol intern(const char *name, int length){
+  unsigned int h = hashName(name, length);
+  int locked = lockStore();
+  Symbol s = findSymbol(name, length, h);
+  if(s){
+    unlockStore(locked);
+    return s;
+  }
+  if(SymbolCount == SymbolSize){
+    SymbolSize *= 2;
+    SymbolNames = realloc(SymbolNames, SymbolSize * sizeof(char *));
+    SymbolHashes = realloc(SymbolHashes, SymbolSize * sizeof(unsigned int));
+    SymbolNext = realloc(SymbolNext, SymbolSize * sizeof(Symbol));
+  }
+  s = SymbolCount++;
+  char *n = malloc(length + 1);
+  for(int i = 0; i<length; i++) n[i] = name[i];
+  n[length] = '\0';
+  SymbolNames[s] = n;
+  SymbolHashes[s] = h;
+  unsigned int b = h & (SymbolBucketCount - 1);
+  SymbolNext[s] = SymbolBuckets[b];
+  SymbolBuckets[b] = s;
+  if(SymbolCount > SymbolBucketCount * 2) rehashSymbols();
+  unlockStore(locked);
+  return s;
+}
+
+const char *symbolName(Symbol s){
+  // the name table moves as it grows; the names themselves do not
+  int locked = lockStore();
+  const char *n = (!s || s >= SymbolCount) ? "" : SymbolNames[s];
+  unlockStore(locked);
+  return n;
+}
+
+void initTermStore(void){
+  SymbolSize = 256;
+  SymbolNames = malloc(SymbolSize * sizeof(char *));
+  SymbolHashes = malloc(SymbolSize * sizeof(unsigned int));
+  SymbolNext = malloc(SymbolSize * sizeof(Symbol));
+  SymbolBucketCount = 256;
+  SymbolBuckets = calloc(SymbolBucketCount, sizeof(Symbol));
+  SymbolNames[0] = NULL;
+  SymbolCount = 1;
+
+  // the last cell chunk is kept so that CellCount stays representable
+  CellPool.frontier = MAX_CHUNKS - 1;
+  ArgPool.frontier = MAX_CHUNKS;
+  CellChunks[0] = malloc(CHUNK_SIZE * sizeof(TermCell));
+  CellCount = 1;
+  ArgChunks[0] = malloc(CHUNK_SIZE * sizeof(Term));
+  ArgCount = 0;
+  // no term reads as an atom without a name
+  *CELL(0) = (TermCell){TTATOM, 0, 0, 0, 0, 0, 0, 0};
+  BucketCount = 1024;
+  Buckets = calloc(BucketCount, sizeof(Term));
+
+  SymConjunction = intern(",", 1);
+  SymClause = intern(":-", 2);
+  SymCut = intern("!", 1);
+  SymOnce = intern("once", 4);
+  SymIs = intern("is", 2);
+  SymArithEqual = intern("=:=", 3);
+  SymArithNotEqual = intern("=\\=", 3);
+  SymLess = intern("<", 1);
+  SymLessEqual = intern("=<", 2);
+  SymGreater = intern(">", 1);
+  SymGreaterEqual = intern(">=", 2);
+  SymPlus = intern("+", 1);
+  SymMinus = intern("-", 1);
+  SymTimes = intern("*", 1);
+  SymDivide = intern("/", 1);
+  SymIntDivide = intern("//", 2);
+  SymMod = intern("mod", 3);
+  // '(' ends every parsed name, so no atom can be called this
+  SymInteger = intern("(integer)", 9);
+}
+
+void freeTermStore(void){
+  for(Symbol s = 1; s<SymbolCount; s++) free(SymbolNames[s]);
+  free(SymbolNames);
+  free(SymbolHashes);
+  free(SymbolNext);
+  free(SymbolBuckets);
+  // region chunks lie past the gap above the store's
+  for(unsigned int i = 0; i<MAX_CHUNKS; i++){
+    free(CellChunks[i]);
+    CellChunks[i] = NULL;
+    CellOwners[i] = NULL;
+    free(ArgChunks[i]);
+    ArgChunks[i] = NULL;
+  }
+  for(int k = 0; k<BLOCK_CLASSES; k++){
+    free(CellPool.free[k]);
+    free(ArgPool.free[k]);
+  }
+  CellPool = (BlockPool){0};
+  ArgPool = (BlockPool){0};
+  free(Buckets);
+  SymbolNames = NULL;
+  Buckets = NULL;
+  SymbolCount = CellCount = ArgCount = SlotCount = 0;
+  StoreFull = 0;
+}
+
+static unsigned int hashCell(TermType type, Symbol name, int index, int arity, Term *args){
+  unsigned int h = 2166136261u;
+  h = (h ^ (unsigned int)type) * 16777619u;
+  h = (h ^ name) * 16777619u;
+  h = (h ^ (unsigned int)index) * 16777619u;
+  for(int i = 0; i<arity; i++){
+    h = (h ^ args[i]) * 16777619u;
+  }
+  return h;
+}
+
+static void rehashCells(){
+  BucketCount *= 2;
+  free(Buckets);
+  Buckets = calloc(BucketCount, sizeof(Term));
+  // ascending order keeps the newest cell at the head of each chain,
+  // which termRelease relies on
+  for(Term t = 1; t<CellCount; t++){
+    unsigned int b = CELL(t)->hash & (BucketCount - 1);
+    CELL(t)->next = Buckets[b];
+    Buckets[b] = t;
+  }
+}
+
+static Term findCell(Term *buckets, unsigned int bucketcount, unsigned int h,
+  TermType type, Symbol name, int index, int arity, Term *args){
+  Term t = buckets[h & (bucketcount - 1)];
+  while(t){
+    TermCell *c = CELL(t);
+    if(c->hash == h && c->type == type && c->name == name && c->index == index){
+      int i = 0;
+      while(i<arity && ARG(c->args + i) == args[i]) i++;
+      if(i == arity) return t;
+    }
+    t = c->next;
+  }
+  return 0;
+}
+
+/* reserveArgs - sets *offset to arity free argument slots, in one chunk
+ * or, for more than a chunk holds, in a run of new ones; 0 if the chunks
+ * have run out */
+static int reserveArgs(int arity, unsigned int *offset){
+  unsigned int chunk = ArgCount >> CHUNK_BITS;
+  unsigned int count = (unsigned int)(arity + CHUNK_SIZE - 1) >> CHUNK_BITS;
+  if(arity && (ArgCount & CHUNK_MASK) + arity > CHUNK_SIZE && (ArgCount & CHUNK_MASK)) chunk++;
+  // the slot after the last argument must have an offset too
+  if(arity && chunk + count >= ArgPool.frontier){
+    if(!StoreFull) fprintf(stderr, "Term store: out of argument space\n");
+    return 0;
+  }
+  for(unsigned int i = 0; i<count; i++){
+    if(!ArgChunks[chunk + i]) ArgChunks[chunk + i] = malloc(CHUNK_SIZE * sizeof(Term));
+  }
+  if(chunk != ArgCount >> CHUNK_BITS) ArgCount = chunk << CHUNK_BITS;
+  (* offset) = ArgCount;
+  return 1;
+}
+
+/* regionPosition - position of region cell t in its region */
+static unsigned int regionPosition(Term t){
+  return CellStarts[t >> CHUNK_BITS] + (t & CHUNK_MASK);
+}
+
+/* termVisible - 1 if the thread's region, or the store without one, sees t */
+static int termVisible(Term t){
+  TermRegion *owner = CellOwners[t >> CHUNK_BITS];
+  unsigned int limit = UINT_MAX;
+  for(TermRegion *r = Region; r && (!owner || r->depth >= owner->depth); r = r->parent){
+    if(owner == r) return regionPosition(t) < limit;
+    limit = r->limit;
+  }
+  return !owner && t < limit;
+}
+
+/* addBlock - appends a block of at least size entries to the cells or
+ * arguments of r; 0 if the chunks have run out */
+static int addBlock(TermRegion *r, int cells, unsigned int size){
+  BlockList *list = cells ? &r->cells : &r->args;
+  BlockPool *pool = cells ? &CellPool : &ArgPool;
+  unsigned int count = 1;
+  int k = 0;
+  if(size > CHUNK_SIZE){
+    count = (size + CHUNK_MASK) >> CHUNK_BITS;
+    size = count << CHUNK_BITS;
+    k = BLOCK_CLASSES - 1;
+  } else {
+    while((MIN_BLOCK << k) < size) k++;
+    size = MIN_BLOCK << k;
+  }
+  unsigned int chunk = 0;
+  int locked = lockStore();
+  if(count == 1 && pool->count[k]){
+    chunk = pool->free[k][--pool->count[k]];
+  } else if(pool->frontier > count && pool->frontier - count > (cells ? CellCount : ArgCount) >> CHUNK_BITS){
+    // fresh chunks stay above those the store may still grow into
+    pool->frontier -= count;
+    chunk = pool->frontier;
+  }
+  unlockStore(locked);
+  if(!chunk) return 0;
+  unsigned int start = list->count ? list->blocks[list->count - 1].start + list->blocks[list->count - 1].size : 0;
+  for(unsigned int i = 0; i<count; i++){
+    unsigned int entries = count > 1 ? CHUNK_SIZE : size;
+    if(cells){
+      if(!CellChunks[chunk + i]) CellChunks[chunk + i] = malloc(entries * sizeof(TermCell));
+      CellOwners[chunk + i] = r;
+      CellStarts[chunk + i] = start + (i << CHUNK_BITS);
+    } else {
+      if(!ArgChunks[chunk + i]) ArgChunks[chunk + i] = malloc(entries * sizeof(Term));
+      ArgStarts[chunk + i] = start + (i << CHUNK_BITS);
+    }
+  }
+  if(list->count == list->size){
+    list->size = list->size ? list->size * 2 : 8;
+    list->blocks = realloc(list->blocks, list->size * sizeof(Block));
+  }
+  list->blocks[list->count++] = (Block){chunk, start, size};
+  return 1;
+}
+
+/* dropBlocks - gives the blocks of list from the from-th on back */
+static void dropBlocks(BlockList *list, BlockPool *pool, int from){
+  int locked = lockStore();
+  for(int b = from; b<list->count; b++){
+    Block *block = &list->blocks[b];
+    int k = 0;
+    while((MIN_BLOCK << k) < block->size && k < BLOCK_CLASSES - 1) k++;
+    // a run goes back a chunk at a time
+    unsigned int count = block->size > CHUNK_SIZE ? block->size >> CHUNK_BITS : 1;
+    for(unsigned int i = 0; i<count; i++){
+      if(pool->count[k] == pool->size[k]){
+        pool->size[k] = pool->size[k] ? pool->size[k] * 2 : 64;
+        pool->free[k] = realloc(pool->free[k], pool->size[k] * sizeof(unsigned int));
+      }
+      pool->free[k][pool->count[k]++] = block->chunk + i;
+    }
+  }
+  unlockStore(locked);
+  list->count = from;
+}
+
+/* nextSize - size of the block after one of size */
+static unsigned int nextSize(unsigned int size){
+  return size < CHUNK_SIZE ? size * 2 : CHUNK_SIZE;
+}
+
+static Term regionFull(TermRegion *r, const char *what){
+  if(!r->full) fprintf(stderr, "Term store: out of %s\n", what);
+  r->full = 1;
+  exhaustMemory();
+  return 0;
+}
+
+static void rehashRegion(TermRegion *r){
+  r->bucketcount *= 2;
+  free(r->buckets);
+  r->buckets = calloc(r->bucketcount, sizeof(Term));
+  // in position order, as for the store
+  for(int b = 0; b<r->cells.count; b++){
+    Block *block = &r->cells.blocks[b];
+    for(unsigned int i = 0; i<block->size && block->start + i < r->cells.used; i++){
+      Term t = (block->chunk << CHUNK_BITS) | i;
+      unsigned int bucket = CELL(t)->hash & (r->bucketcount - 1);
+      CELL(t)->next = r->buckets[bucket];
+      r->buckets[bucket] = t;
+    }
+  }
+}
+
+/* addRegionCell - adds a cell to r as internCell does to the store */
+static Term addRegionCell(TermRegion *r, unsigned int h, TermType type, Symbol name, int index, int arity, Term *args){
+  if(!r->cells.count && !addBlock(r, 1, MIN_BLOCK)) return regionFull(r, "cells");
+  if(!r->args.count && !addBlock(r, 0, MIN_BLOCK)) return regionFull(r, "argument space");
+  Block *block = &r->cells.blocks[r->cells.current];
+  if(r->cells.used == block->start + block->size){
+    if(r->cells.current + 1 == r->cells.count && !addBlock(r, 1, nextSize(block->size))){
+      return regionFull(r, "cells");
+    }
+    r->cells.current++;
+  }
+  block = &r->cells.blocks[r->cells.current];
+  // the arguments go where the block has room for all of them
+  int a = r->args.current;
+  unsigned int start = r->args.used;
+  Block *argblock = &r->args.blocks[a];
+  if((unsigned int)arity > argblock->start + argblock->size - start){
+    if(a + 1 == r->args.count || r->args.blocks[a + 1].size < (unsigned int)arity){
+      dropBlocks(&r->args, &ArgPool, a + 1);
+      unsigned int size = nextSize(argblock->size);
+      if(!addBlock(r, 0, size > (unsigned int)arity ? size : (unsigned int)arity)){
+        return regionFull(r, "argument space");
+      }
+    }
+    a++;
+    start = r->args.blocks[a].start;
+  }
+  argblock = &r->args.blocks[a];
+  unsigned int end = start + arity;
+  // the slot after the last argument must have an offset too
+  if(end == argblock->start + argblock->size){
+    if(a + 1 == r->args.count && !addBlock(r, 0, nextSize(argblock->size))){
+      return regionFull(r, "argument space");
+    }
+  }
+  argblock = &r->args.blocks[a];
+  Term t = (block->chunk << CHUNK_BITS) | (r->cells.used - block->start);
+  TermCell *c = CELL(t);
+  c->type = type;
+  c->name = name;
+  c->index = index;
+  c->args = (argblock->chunk << CHUNK_BITS) + (start - argblock->start);
+  c->slot = type == TTVARIABLE ? r->slots++ : 0;
+  c->vars = type == TTVARIABLE ? SLOT_SUMMARY(c->slot) : 0;
+  c->hash = h;
+  for(int i = 0; i<arity; i++){
+    ARG(c->args + i) = args[i];
+    c->vars |= CELL(args[i])->vars;
+  }
+  chargeMemory(MEMTERMS, sizeof(TermCell) + (end - r->args.used) * sizeof(Term));
+  r->args.used = end;
+  r->args.current = end == argblock->start + argblock->size ? a + 1 : a;
+  unsigned int bucket = h & (r->bucketcount - 1);
+  c->next = r->buckets[bucket];
+  r->buckets[bucket] = t;
+  r->cells.used++;
+  // a region starts small each query, so its chains are kept shorter than
+  // the store's, whose buckets stay as many as it ever needed
+  if(r->cells.used > r->bucketcount) rehashRegion(r);
+  return t;
+}
+
+/* internRegionCell - internCell for the thread's region r: the term is
+ * looked up where r sees it and added to r if it is not found */
+static Term internRegionCell(TermRegion *r, unsigned int h, TermType type, Symbol name, int index, int arity, Term *args){
+  // a term is held with its deepest argument or deeper still
+  int depth = 0;
+  for(int i = 0; i<arity; i++){
+    TermRegion *owner = CellOwners[args[i] >> CHUNK_BITS];
+    if(owner && owner->depth > depth) depth = owner->depth;
+  }
+  unsigned int limit = UINT_MAX;
+  for(TermRegion *x = r; x && x->depth >= depth; x = x->parent){
+    Term t = findCell(x->buckets, x->bucketcount, h, type, name, index, arity, args);
+    if(t && regionPosition(t) < limit) return t;
+    limit = x->limit;
+  }
+  if(!depth){
+    int locked = lockStore();
+    Term t = findCell(Buckets, BucketCount, h, type, name, index, arity, args);
+    unlockStore(locked);
+    if(t && t < limit) return t;
+  }
+  return addRegionCell(r, h, type, name, index, arity, args);
+}
+
+/* releaseRegion - termRelease for region r */
+static void releaseRegion(TermRegion *r, unsigned int mark){
+  if(mark >= r->cells.used) return;
+  int b = r->cells.current;
+  TermCell *c = NULL;
+  // cells are released newest first, so each one is the head of its chain
+  for(unsigned int p = r->cells.used; p-- > mark;){
+    while(r->cells.blocks[b].start > p) b--;
+    Block *block = &r->cells.blocks[b];
+    c = CELL((block->chunk << CHUNK_BITS) | (p - block->start));
+    r->buckets[c->hash & (r->bucketcount - 1)] = c->next;
+    if(c->type == TTVARIABLE) r->slots--;
+  }
+  r->cells.current = b;
+  unsigned int args = ArgStarts[c->args >> CHUNK_BITS] + (c->args & CHUNK_MASK);
+  chargeMemory(MEMTERMS, -(long long)((r->cells.used - mark) * sizeof(TermCell) +
+    (r->args.used - args) * sizeof(Term)));
+  r->cells.used = mark;
+  r->args.used = args;
+  while(r->args.blocks[r->args.current].start > args) r->args.current--;
+  r->full = 0;
+}
+
+TermRegion *openTermRegion(TermRegion *parent){
+  TermRegion *r = calloc(1, sizeof(TermRegion));
+  r->parent = parent;
+  if(parent){
+    r->limit = parent->cells.used;
+    r->depth = parent->depth + 1;
+    r->slots = parent->slots;
+  } else {
+    int locked = lockStore();
+    r->limit = CellCount;
+    r->slots = SlotCount;
+    unlockStore(locked);
+    r->depth = 1;
+  }
+  r->bucketcount = 64;
+  r->buckets = calloc(r->bucketcount, sizeof(Term));
+  return r;
+}
+
+void closeTermRegion(TermRegion **region){
+  TermRegion *r = * region;
+  if(!r) return;
+  chargeMemory(MEMTERMS, -(long long)(r->cells.used * sizeof(TermCell) + r->args.used * sizeof(Term)));
+  dropBlocks(&r->cells, &CellPool, 0);
+  dropBlocks(&r->args, &ArgPool, 0);
+  free(r->cells.blocks);
+  free(r->args.blocks);
+  free(r->buckets);
+  free(r);
+  (* region) = NULL;
+}
+
+TermRegion *useTermRegion(TermRegion *region){
+  TermRegion *previous = Region;
+  Region = region;
+  return previous;
+}
+
+TermRegion *termRegion(void){
+  return Region;
+}
+
+int termRegionDepth(void){
+  return Region ? Region->depth : 0;
+}
+
+static Term internCell(TermType type, Symbol name, int index, int arity, Term *args){
+  unsigned int h = hashCell(type, name, index, arity, args);
+  if(Region) return internRegionCell(Region, h, type, name, index, arity, args);
+  int locked = lockStore();
+  Term t = findCell(Buckets, BucketCount, h, type, name, index, arity, args);
+  if(t){
+    unlockStore(locked);
+    return t;
+  }
+  t = CellCount;
+  unsigned int argcount = ArgCount;
+  unsigned int args0;
+  if((t >> CHUNK_BITS) >= CellPool.frontier || !reserveArgs(arity, &args0)){
+    if((t >> CHUNK_BITS) >= CellPool.frontier && !StoreFull) fprintf(stderr, "Term store: out of cells\n");
+    StoreFull = 1;
+    unlockStore(locked);
+    exhaustMemory();
+    return 0;
+  }
+  if(!(t & CHUNK_MASK) && !CellChunks[t >> CHUNK_BITS]){
+    CellChunks[t >> CHUNK_BITS] = malloc(CHUNK_SIZE * sizeof(TermCell));
+  }
+  TermCell *c = CELL(t);
+  c->type = type;
+  c->name = name;
+  c->index = index;
+  c->args = args0;
+  c->slot = type == TTVARIABLE ? SlotCount++ : 0;
+  c->vars = type == TTVARIABLE ? SLOT_SUMMARY(c->slot) : 0;
+  c->hash = h;
+  for(int i = 0; i<arity; i++){
+    ARG(c->args + i) = args[i];
+    c->vars |= CELL(args[i])->vars;
+  }
+  ArgCount += arity;
+  unsigned int b = h & (BucketCount - 1);
+  c->next = Buckets[b];
+  Buckets[b] = t;
+  CellCount++;
+  if(CellCount > BucketCount * 2) rehashCells();
+  unlockStore(locked);
+  // argument slots skipped at the end of a chunk are charged with the cell
+  chargeMemory(MEMTERMS, sizeof(TermCell) + (ArgCount - argcount) * sizeof(Term));
+  return t;
+}
+
+Term atomTerm(Symbol name){
+  return internCell(TTATOM, name, 0, 0, NULL);
+}
+
+Term variableTerm(Symbol name, int index){
+  return internCell(TTVARIABLE, name, index, 0, NULL);
+}
+
+Term integerTerm(int value){
+  return internCell(TTINTEGER, SymInteger, value, 0, NULL);
+}
+
+Term functorTerm(Symbol name, int arity, Term *args){
+  if(arity == 0) return atomTerm(name);
+  // an argument that could not be added leaves no term
+  for(int i = 0; i<arity; i++) if(!args[i]) return 0;
+  TermType type = TTFUNCTOR;
+  if(arity == 2 && name == SymConjunction) type = TTCONJUNCTION;
+  if(arity == 2 && name == SymClause) type = TTCLAUSE;
+  return internCell(type, name, arity, arity, args);
+}
+
+TermType termType(Term t){
+  return CELL(t)->type;
+}
+
+Symbol termName(Term t){
+  return CELL(t)->name;
+}
+
+int termArity(Term t){
+  TermCell *c = CELL(t);
+  if(c->type == TTVARIABLE || c->type == TTATOM || c->type == TTINTEGER) return 0;
+  return c->index;
+}
+
+Term termArg(Term t, int i){
+  return ARG(CELL(t)->args + i);
+}
+
+int termIndex(Term t){
+  return CELL(t)->index;
+}
+
+int termInteger(Term t){
+  return CELL(t)->index;
+}
+
+int termIsAtomic(Term t){
+  TermType type = CELL(t)->type;
+  return type == TTATOM || type == TTINTEGER;
+}
+
+unsigned int termSlot(Term t){
+  return CELL(t)->slot;
+}
+
+unsigned int slotCount(void){
+  if(Region) return Region->slots;
+  return SlotCount;
+}
+
+unsigned int termVariables(Term t){
+  return CELL(t)->vars;
+}
+
+int termIsGround(Term t){
+  // every variable sets a bit of its summary
+  return !t || !CELL(t)->vars;
+}
+
+void initTermStack(TermStack *s){
+  s->items = s->local;
+  s->count = 0;
+  s->size = sizeof(s->local) / sizeof(Term);
+}
+
+void growTermStack(TermStack *s){
+  if(s->items == s->local){
+    s->items = malloc(2 * s->size * sizeof(Term));
+    for(int i = 0; i<s->count; i++) s->items[i] = s->local[i];
+  } else {
+    s->items = realloc(s->items, 2 * s->size * sizeof(Term));
+  }
+  s->size *= 2;
+}
+
+void freeTermStack(TermStack *s){
+  if(s->items != s->local) free(s->items);
+  initTermStack(s);
+}
+
+/* rebuildTerm - mapTerm, rebuilding a term from its mapped arguments
+ * even when they are unchanged if every is set */
+static Term rebuildTerm(Term t, int (*visit)(Term *t, void *context), void *context, int every){
+  // frames holds each term being rebuilt and where its arguments start
+  // in values
+  TermStack frames, values;
+  initTermStack(&frames);
+  initTermStack(&values);
+  for(;;){
+    if(!visit(&t, context) && termArity(t)){
+      PUSH_TERM(&frames, t);
+      PUSH_TERM(&frames, (Term)values.count);
+      t = termArg(t, 0);
+      continue;
+    }
+    PUSH_TERM(&values, t);
+    while(frames.count){
+      Term f = frames.items[frames.count - 2];
+      int base = (int)frames.items[frames.count - 1];
+      int arity = termArity(f);
+      if(values.count - base < arity) break;
+      Term *args = &values.items[base];
+      int i = 0;
+      while(i<arity && args[i] == termArg(f, i)) i++;
+      if(i < arity || every) f = functorTerm(termName(f), arity, args);
+      values.count = base;
+      frames.count -= 2;
+      PUSH_TERM(&values, f);
+    }
+    if(!frames.count) break;
+    t = termArg(frames.items[frames.count - 2], values.count - (int)frames.items[frames.count - 1]);
+  }
+  Term result = values.items[0];
+  freeTermStack(&frames);
+  freeTermStack(&values);
+  return result;
+}
+
+Term mapTerm(Term t, int (*visit)(Term *t, void *context), void *context){
+  return rebuildTerm(t, visit, context, 0);
+}
+
+/* importVisit - keeps a term the region sees and adds a constant or
+ * variable it does not see again */
+static int importVisit(Term *t, void *context){
+  (void)context;
+  if(termVisible(* t)) return 1;
+  if(termArity(* t)) return 0;
+  TermCell *c = CELL(* t);
+  (* t) = internCell(c->type, c->name, c->index, 0, NULL);
+  return 1;
+}
+
+Term importTerm(Term t){
+  if(!t) return 0;
+  return rebuildTerm(t, importVisit, NULL, 1);
+}
+
+Term termMark(void){
+  if(Region) return Region->cells.used;
+  int locked = lockStore();
+  Term mark = CellCount;
+  unlockStore(locked);
+  return mark;
+}
+
+void termRelease(Term mark){
+  if(Region){
+    releaseRegion(Region, mark);
+    return;
+  }
+  // threads sharing the store interleave their cells, so nothing added
+  // outside a region is released until the store is private again
+  if(StoreShared) return;
+  if(mark < 1 || mark >= CellCount) return;
+  // cells are released newest first, so each one is the head of its chain
+  for(Term t = CellCount - 1; t>=mark; t--){
+    Buckets[CELL(t)->hash & (BucketCount - 1)] = CELL(t)->next;
+    if(CELL(t)->type == TTVARIABLE) SlotCount--;
+  }
+  chargeMemory(MEMTERMS, -(long long)((CellCount - mark) * sizeof(TermCell) +
+    (ArgCount - CELL(mark)->args) * sizeof(Term)));
+  ArgCount = CELL(mark)->args;
+  CellCount = mark;
+  StoreFull = 0;
+}
+
+/**
+ * Parser
+ *
+ * <clause>      ::= <conjunction> | ":-" <conjunction>
+ * <conjunction> ::= <term> | <term> "," <conjunction> | <term> ":-" <conjunction>
+ * <term>        ::= <primary> | <term> <operator> <term>
+ * <primary>     ::= <name> | <name> "(" <term> { "," <term> } ")" |
+ *                   <integer> | "-" <primary> | "(" <conjunction> ")"
+ *
+ * A name is a run of the symbol characters + - * / \ < > = : or a run of
+ * any other characters that are neither control characters nor
+ * whitespace. Names starting with an uppercase letter are variables and
+ * names of digits only are integers. The operators are those of
+ * arithmetic, from the loosest:
+ *
+ *   700 xfx  is =:= =\= < =< > >=
+ *   500 yfx  + -
+ *   400 yfx  * / // mod
+ *
+ * "-" before a digit is the sign of an integer, before anything else but
+ * "(" it stands for -(X). An operator can still be written as a functor,
+ * as in is(X,+(Y,1)).
+ */
+
+typedef struct OPERATOR{
+  const char *name;
+  int priority;
+  int left;            /* loosest priority of the left operand */
+  int right;           /* loosest priority of the right operand */
+} Operator;
+
+static const Operator Operators[] = {
+  {"is", 700, 699, 699}, {"=:=", 700, 699, 699}, {"=\\=", 700, 699, 699},
+  {"<", 700, 699, 699}, {"=<", 700, 699, 699}, {">", 700, 699, 699},
+  {">=", 700, 699, 699},
+  {"+", 500, 500, 499}, {"-", 500, 500, 499},
+  {"*", 400, 400, 399}, {"/", 400, 400, 399}, {"//", 400, 400, 399},
+  {"mod", 400, 400, 399},
+  {NULL, 0, 0, 0}
+};
+
+/* findOperator - the operator named by the first length chars of name */
+static const Operator *findOperator(const char *name, int length){
+  for(const Operator *op = Operators; op->name; op++){
+    if(strlength(op->name) != length) continue;
+    int i = 0;
+    while(i<length && op->name[i] == name[i]) i++;
+    if(i == length) return op;
+  }
+  return NULL;
+}
+
+/* termOperator - the operator t is written with; NULL if it is none */
+static const Operator *termOperator(Term t){
+  if(CELL(t)->type != TTFUNCTOR || CELL(t)->index != 2) return NULL;
+  const char *name = symbolName(CELL(t)->name);
+  return findOperator(name, strlength(name));
+}
+
+/* ParseFrame - a rule the parser is in the middle of; the terms it has
+ * read so far are on the parser's values from base on */
+typedef enum
+{
+  PFCONJUNCTION, PFEXPRESSION, PFPARENTHESES, PFMINUS, PFARGUMENTS
+}ParseFrameKind;
+
+typedef struct PARSE_FRAME{
+  ParseFrameKind kind;
+  int base;
+  int max;             /* expression: loosest operator it may hold */
+  int priority;        /* expression: priority of its left operand */
+  const Operator *op;  /* expression: operator whose right operand is due */
+  Symbol name;         /* arguments: the functor they are of */
+} ParseFrame;
+
+typedef struct PARSER{
+  const char *text;
+  int index;
+  int error;
+  ParseFrame *frames;  /* rules in progress, so nesting costs no C stack */
+  int count;
+  int size;
+  TermStack values;
+} Parser;
+
+static int isControl(char c){
+  return (c == '(' || c == ')' || c == ',' || c == ':' ||
+    c == '.' || c == '|' || c == '{' || c == '}');
+}
+
+static int isSymbolChar(char c){
+  return (c == '+' || c == '-' || c == '*' || c == '/' || c == '\\' ||
+    c == '<' || c == '>' || c == '=' || c == ':');
+}
+
+int charClass(char c){
+  if(isSymbolChar(c)) return 2;
+  if(!c || isControl(c) || isspace((unsigned char)c)) return 0;
+  return 1;
+}
+
+static char peek(Parser *p){
+  while(isspace((unsigned char)p->text[p->index])) p->index++;
+  return p->text[p->index];
+}
+
+/* nameLength - length of the name at the parser's position; 0 if none */
+static int nameLength(Parser *p){
+  const char *s = p->text + p->index;
+  int class = charClass(s[0]);
+  int length = 0;
+  while(class && charClass(s[length]) == class) length++;
+  return length;
+}
+
+static ParseFrame *pushFrame(Parser *p, ParseFrameKind kind){
+  if(p->count == p->size){
+    p->size = p->size ? p->size * 2 : 16;
+    p->frames = realloc(p->frames, p->size * sizeof(ParseFrame));
+  }
+  ParseFrame *f = &p->frames[p->count++];
+  f->kind = kind;
+  f->base = p->values.count;
+  f->max = 0;
+  f->priority = 0;
+  f->op = NULL;
+  f->name = 0;
+  return f;
+}
+
+/* beginExpression - starts an expression of operators no looser than max */
+static void beginExpression(Parser *p, int max){
+  pushFrame(p, PFEXPRESSION)->max = max;
+}
+
+static void beginConjunction(Parser *p){
+  pushFrame(p, PFCONJUNCTION);
+  beginExpression(p, 999);
+}
+
+/* parseInteger - the integer of the digits at the parser's position, with
+ * sign -1 or 1 */
+static Term parseInteger(Parser *p, int sign){
+  long long value = 0;
+  while(isdigit((unsigned char)p->text[p->index])){
+    value = value * 10 + (p->text[p->index++] - '0');
+    if(value > (long long)INT_MAX + 1){
+      p->error = 1;
+      return 0;
+    }
+  }
+  value *= sign;
+  if(value > INT_MAX){
+    p->error = 1;
+    return 0;
+  }
+  return integerTerm((int)value);
+}
+
+/* parsePrimary - reads a primary into *t and returns 1, or starts the
+ * rules of one that nests and returns 0 */
+static int parsePrimary(Parser *p, Term *t){
+  char c = peek(p);
+  if(c == '('){
+    p->index++;
+    pushFrame(p, PFPARENTHESES);
+    beginConjunction(p);
+    return 0;
+  }
+  int start = p->index;
+  int length = nameLength(p);
+  if(length == 0){
+    p->error = 1;
+    return 0;
+  }
+  if(length == 1 && c == '-' && p->text[start + 1] != '('){
+    p->index++;
+    if(isdigit((unsigned char)p->text[p->index])){
+      (* t) = parseInteger(p, -1);
+      return 1;
+    }
+    pushFrame(p, PFMINUS);
+    return 0;
+  }
+  int digits = 0;
+  while(digits<length && isdigit((unsigned char)p->text[start + digits])) digits++;
+  if(digits == length){
+    (* t) = parseInteger(p, 1);
+    return 1;
+  }
+  p->index += length;
+  Symbol name = intern(p->text + start, length);
+  if(peek(p) != '('){
+    (* t) = isupper((unsigned char)p->text[start]) ? variableTerm(name, -1) : atomTerm(name);
+    return 1;
+  }
+  p->index++;
+  pushFrame(p, PFARGUMENTS)->name = name;
+  beginExpression(p, 999);
+  return 0;
+}
+
+/* reduce - hands t to the newest frame; returns 1 if that frame goes on
+ * with another primary, 0 if it is done and *t is what it read */
+static int reduce(Parser *p, Term *t){
+  ParseFrame *f = &p->frames[p->count - 1];
+  TermStack *values = &p->values;
+  Term *read = &values->items[f->base];
+  switch(f->kind){
+    case PFCONJUNCTION: {
+      PUSH_TERM(values, * t);
+      char c = peek(p);
+      if((c == ':' && p->text[p->index + 1] == '-') || c == ','){
+        // the separator is kept between the goals as the name it joins with
+        p->index += c == ',' ? 1 : 2;
+        PUSH_TERM(values, c == ',' ? SymConjunction : SymClause);
+        beginExpression(p, 999);
+        return 1;
+      }
+      // "a:-b,c" is ':-'(a, ','(b, c)): the goals join from the right
+      read = &values->items[f->base];
+      Term right = read[values->count - f->base - 1];
+      for(int i = values->count - f->base - 3; i>=0; i -= 2){
+        Term args[2] = {read[i], right};
+        right = functorTerm(read[i + 1], 2, args);
+      }
+      values->count = f->base;
+      (* t) = right;
+      break;
+    }
+    case PFEXPRESSION: {
+      if(f->op){
+        Term args[2] = {read[0], * t};
+        (* t) = functorTerm(intern(f->op->name, strlength(f->op->name)), 2, args);
+        f->priority = f->op->priority;
+        values->count = f->base;
+      }
+      peek(p);
+      int length = nameLength(p);
+      const Operator *op = findOperator(p->text + p->index, length);
+      if(op && op->priority <= f->max && f->priority <= op->left){
+        p->index += length;
+        f->op = op;
+        PUSH_TERM(values, * t);
+        beginExpression(p, op->right);
+        return 1;
+      }
+      break;
+    }
+    case PFPARENTHESES:
+      if(peek(p) != ')'){
+        p->error = 1;
+        return 0;
+      }
+      p->index++;
+      break;
+    case PFMINUS:
+      (* t) = functorTerm(SymMinus, 1, t);
+      break;
+    case PFARGUMENTS: {
+      PUSH_TERM(values, * t);
+      char c = peek(p);
+      p->index++;
+      if(c == ','){
+        beginExpression(p, 999);
+        return 1;
+      }
+      if(c != ')'){
+        p->error = 1;
+        return 0;
+      }
+      int arity = values->count - f->base;
+      (* t) = functorTerm(f->name, arity, &values->items[f->base]);
+      values->count = f->base;
+      break;
+    }
+  }
+  p->count--;
+  return 0;
+}
+
+/* parseConjunction - parses a conjunction; 0 with p->error set if it is
+ * not well formed */
+static Term parseConjunction(Parser *p){
+  Term t = 0;
+  beginConjunction(p);
+  while(!p->error){
+    if(!parsePrimary(p, &t)) continue;
+    while(!p->error && p->count && !reduce(p, &t));
+    if(!p->count) break;
+  }
+  return p->error ? 0 : t;
+}
+
+Term parseTerm(const char *text){
+  if(!text) return 0;
+  Parser p;
+  p.text = text;
+  p.index = 0;
+  p.error = 0;
+  p.frames = NULL;
+  p.count = p.size = 0;
+  initTermStack(&p.values);
+  int directive = 0;
+  if(peek(&p) == ':' && p.text[p.index + 1] == '-'){
+    // ":- goals." is a directive, stored as ':-'(goals)
+    p.index += 2;
+    directive = 1;
+  }
+  Term t = parseConjunction(&p);
+  free(p.frames);
+  freeTermStack(&p.values);
+  if(p.error) return 0;
+  if(directive) t = functorTerm(SymClause, 1, &t);
+  if(peek(&p) == '.') p.index++;
+  if(peek(&p) != '\0') return 0;
+  return t;
+}
+
+/* printPriority - priority of t as an operand; it is printed in
+ * parentheses where that is looser than the operand may be */
+static int printPriority(Term t, const Operator *op){
+  if(CELL(t)->type == TTCONJUNCTION) return 1000;
+  if(CELL(t)->type == TTCLAUSE) return 1200;
+  return op ? op->priority : 0;
+}
+
+/* firstChar - the first character printTerm writes for t */
+static char firstChar(Term t, int max){
+  for(;;){
+    TermCell *c = CELL(t);
+    const Operator *op = termOperator(t);
+    if(printPriority(t, op) > max) return '(';
+    if(op){
+      max = op->left;
+    } else if(c->type == TTCONJUNCTION){
+      max = 999;
+    } else if(c->type == TTCLAUSE){
+      max = 1199;
+    } else if(c->type == TTINTEGER){
+      char buf[16];
+      sprintf(buf, "%d", c->index);
+      return buf[0];
+    } else if(c->type == TTFUNCTOR && c->name == SymClause && c->index == 1){
+      return ':';
+    } else {
+      return symbolName(c->name)[0];
+    }
+    t = termArg(t, 0);
+  }
+}
+
+/* PrintStep - what printTerm still has to write: a term, in parentheses
+ * if it binds looser than max, a piece of text, or a symbol operator,
+ * spaced from the operands it would run into */
+typedef enum
+{
+  PSTERM, PSTEXT, PSOPERATOR
+}PrintStepKind;
+
+typedef struct PRINT_STEP{
+  PrintStepKind kind;
+  Term t;              /* the term, or the right operand of the operator */
+  int max;
+  const char *text;
+} PrintStep;
+
+typedef struct PRINTER{
+  PrintStep *steps;    /* newest is written next */
+  int count;
+  int size;
+} Printer;
+
+static void pushStep(Printer *pr, PrintStepKind kind, Term t, int max, const char *text){
+  if(pr->count == pr->size){
+    pr->size = pr->size ? pr->size * 2 : 32;
+    pr->steps = realloc(pr->steps, pr->size * sizeof(PrintStep));
+  }
+  pr->steps[pr->count++] = (PrintStep){kind, t, max, text};
+}
+
+/* printStep - writes t, or pushes the steps that write it in turn, last first */
+static void printStep(Printer *pr, StringBuffer *sb, Term t, int max){
+  TermCell *c = CELL(t);
+  const Operator *op = termOperator(t);
+  if(printPriority(t, op) > max){
+    pushStep(pr, PSTEXT, 0, 0, ")");
+    pushStep(pr, PSTERM, t, 1200, NULL);
+    pushStep(pr, PSTEXT, 0, 0, "(");
+    return;
+  }
+  if(op){
+    pushStep(pr, PSTERM, termArg(t, 1), op->right, NULL);
+    if(charClass(op->name[0]) == 1){
+      pushStep(pr, PSTEXT, 0, 0, " ");
+      pushStep(pr, PSTEXT, 0, 0, op->name);
+      pushStep(pr, PSTEXT, 0, 0, " ");
+    } else {
+      pushStep(pr, PSOPERATOR, termArg(t, 1), op->right, op->name);
+    }
+    pushStep(pr, PSTERM, termArg(t, 0), op->left, NULL);
+    return;
+  }
+  char buf[16];
+  switch(c->type){
+    case TTVARIABLE:
+      appendString(sb, symbolName(c->name));
+      if(c->index >= 0){
+        sprintf(buf, "%d", c->index);
+        appendString(sb, buf);
+      }
+      break;
+    case TTINTEGER:
+      sprintf(buf, "%d", c->index);
+      appendString(sb, buf);
+      break;
+    case TTCONJUNCTION:
+      pushStep(pr, PSTERM, termArg(t, 1), 1000, NULL);
+      pushStep(pr, PSTEXT, 0, 0, ",");
+      pushStep(pr, PSTERM, termArg(t, 0), 999, NULL);
+      break;
+    case TTCLAUSE:
+      pushStep(pr, PSTERM, termArg(t, 1), 1200, NULL);
+      pushStep(pr, PSTEXT, 0, 0, ":-");
+      pushStep(pr, PSTERM, termArg(t, 0), 1199, NULL);
+      break;
+    case TTFUNCTOR:
+      if(c->name == SymClause && c->index == 1){
+        appendString(sb, ":-");
+        pushStep(pr, PSTERM, termArg(t, 0), 1200, NULL);
+        break;
+      }
+      appendString(sb, symbolName(c->name));
+      appendChar(sb, '(');
+      pushStep(pr, PSTEXT, 0, 0, ")");
+      for(int i = c->index - 1; i>=0; i--){
+        pushStep(pr, PSTERM, termArg(t, i), 999, NULL);
+        if(i) pushStep(pr, PSTEXT, 0, 0, ",");
+      }
+      break;
+    default:
+      appendString(sb, symbolName(c->name));
+  }
+}
+
+/* printTerm - prints t, in parentheses if it binds looser than max */
+static void printTerm(StringBuffer *sb, Term t, int max){
+  Printer pr = {NULL, 0, 0};
+  pushStep(&pr, PSTERM, t, max, NULL);
+  while(pr.count){
+    PrintStep step = pr.steps[--pr.count];
+    if(step.kind == PSTERM){
+      printStep(&pr, sb, step.t, step.max);
+      continue;
+    }
+    if(step.kind == PSOPERATOR){
+      // symbol characters on either side would run into the operator's name
+      if(sb->length && charClass(sb->str[sb->length - 1]) == 2) appendChar(sb, ' ');
+      appendString(sb, step.text);
+      if(charClass(firstChar(step.t, step.max)) == 2) appendChar(sb, ' ');
+      continue;
+    }
+    appendString(sb, step.text);
+  }
+  free(pr.steps);
+}
+
+char *termToString(Term t){
+  StringBuffer sb;
+  initStringBuffer(&sb);
+  if(t) printTerm(&sb, t, 1200);
+  return takeString(&sb);
+}
+
+char *clauseToString(Term t){
+  StringBuffer sb;
+  initStringBuffer(&sb);
+  if(t) printTerm(&sb, t, 1200);
+  appendChar(&sb, '.');
+  return takeString(&sb);
+}
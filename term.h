@@ -0,0 +1,199 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Brian O'Dell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PPP_TERM
+#define PPP_TERM
+
+/**
+ * Term store
+ *
+ * Terms are parsed once into cells and hash-consed: building a term that
+ * already exists returns the existing handle, so two terms are identical
+ * exactly when their handles are equal. Atom, functor and variable names
+ * are interned in the symbol table.
+ *
+ * Conjunctions "a,b" are stored as the functor ','(a,b) and implications
+ * "h:-b" as ':-'(h,b). A directive ":-d" is ':-'(d).
+ *
+ * Integers are cells of their own, holding the value rather than a name,
+ * so they are compared and hashed like any other term. Their name is
+ * SymInteger, which no parsed name can equal.
+ */
+
+typedef enum
+{
+  TTVARIABLE, TTATOM, TTFUNCTOR, TTCONJUNCTION, TTCLAUSE, TTCONTROLCHAR, TTINTEGER
+}TermType;
+
+/* Term - handle of a term cell; 0 is no term */
+typedef unsigned int Term;
+/* Symbol - handle of an interned name; 0 is no symbol */
+typedef unsigned int Symbol;
+
+extern Symbol SymConjunction;
+extern Symbol SymClause;
+/* SymCut, SymOnce - names of the control goals ! and once/1 */
+extern Symbol SymCut;
+extern Symbol SymOnce;
+/* names of the arithmetic operators and comparisons */
+extern Symbol SymIs, SymArithEqual, SymArithNotEqual;
+extern Symbol SymLess, SymLessEqual, SymGreater, SymGreaterEqual;
+extern Symbol SymPlus, SymMinus, SymTimes, SymDivide, SymIntDivide, SymMod;
+extern Symbol SymInteger;
+
+/* initTermStore - creates the symbol table and term store */
+void initTermStore(void);
+/* freeTermStore - releases the symbol table and term store */
+void freeTermStore(void);
+
+/* intern - returns the symbol for the first length chars of name */
+Symbol intern(const char *name, int length);
+/* symbolName - returns the text of symbol s */
+const char *symbolName(Symbol s);
+
+/* The constructors return 0 when the term store is full, and functorTerm
+ * when one of args is 0 */
+
+/* atomTerm - returns the atom named name */
+Term atomTerm(Symbol name);
+/* variableTerm - returns variable name; index >= 0 is appended when renamed */
+Term variableTerm(Symbol name, int index);
+/* functorTerm - returns name(args[0], ..., args[arity-1]) */
+Term functorTerm(Symbol name, int arity, Term *args);
+/* integerTerm - returns the integer value */
+Term integerTerm(int value);
+
+TermType termType(Term t);
+Symbol termName(Term t);
+/* termArity - number of arguments; 0 for atoms and variables */
+int termArity(Term t);
+/* termArg - the i-th (0-based) argument of t */
+Term termArg(Term t, int i);
+/* termIndex - rename index of a variable; -1 if never renamed */
+int termIndex(Term t);
+/* termInteger - value of an integer */
+int termInteger(Term t);
+/* termIsAtomic - 1 for atoms and integers */
+int termIsAtomic(Term t);
+/* termSlot - binding slot of a variable; slots are dense from 0 */
+unsigned int termSlot(Term t);
+/* slotCount - number of variable slots in use */
+unsigned int slotCount(void);
+/* SLOT_SUMMARY - the bit standing for variable slot in variable summaries */
+#define SLOT_SUMMARY(slot) (1u << ((slot) & 31))
+/* termVariables - summary of the variables in t: the bits of their slots,
+ * kept in the cell, so it is 0 exactly when t is ground */
+unsigned int termVariables(Term t);
+/* termIsGround - returns 1 if t contains no variables */
+int termIsGround(Term t);
+
+/**
+ * Terms may be nested far deeper than the C stack allows, so they are
+ * walked with a stack of their own rather than by recursion.
+ */
+
+/* TermStack - terms still to visit; it starts in local and moves to the
+ * heap once that is full */
+typedef struct TERM_STACK{
+  Term *items;
+  int count;
+  int size;
+  Term local[32];
+} TermStack;
+
+/* initTermStack - prepares an empty stack */
+void initTermStack(TermStack *s);
+/* growTermStack - doubles the room of s */
+void growTermStack(TermStack *s);
+/* freeTermStack - frees what s took from the heap */
+void freeTermStack(TermStack *s);
+/* PUSH_TERM - pushes t on TermStack s */
+#define PUSH_TERM(s, t) do{ \
+  if((s)->count == (s)->size) growTermStack(s); \
+  (s)->items[(s)->count++] = (t); \
+}while(0)
+
+/* mapTerm - rebuilds t bottom up: visit is called on each subterm before
+ * its arguments and may replace it, returning 1 if *t is final or 0 to
+ * map the arguments of *t and rebuild it from them; a term whose
+ * arguments are unchanged keeps its handle */
+Term mapTerm(Term t, int (*visit)(Term *t, void *context), void *context);
+
+/**
+ * Regions
+ *
+ * A query adds its terms to a region of its own rather than to the store,
+ * so it can release them while other engines and threads add terms too.
+ * A region sees the terms the store, and its parent if it has one, held
+ * when it was opened; a term it does not find there is added to it, and
+ * its variables take slots from where its parent's stopped. One thread at
+ * a time adds terms to a region, and a parent adds none while a region
+ * under it is used by another thread. A term of another region that this
+ * one does not see is brought in with importTerm.
+ */
+
+typedef struct TERM_REGION TermRegion;
+
+/* openTermRegion - opens a region under parent, or under the store if NULL */
+TermRegion *openTermRegion(TermRegion *parent);
+/* closeTermRegion - discards region with its terms, once the regions
+ * opened under it are closed */
+void closeTermRegion(TermRegion **region);
+/* useTermRegion - the calling thread adds terms to region, or to the store
+ * if NULL; returns the region it used until now */
+TermRegion *useTermRegion(TermRegion *region);
+/* termRegion - the region the calling thread adds terms to */
+TermRegion *termRegion(void);
+/* termRegionDepth - the regions the calling thread's region is nested in,
+ * itself included; 0 for the store. Each one deeper makes looking up a
+ * term a little slower. */
+int termRegionDepth(void);
+/* importTerm - t built from terms the calling thread's region sees */
+Term importTerm(Term t);
+
+/* termMark - returns a mark; terms created after it are released by termRelease */
+Term termMark(void);
+/* termRelease - discards every term the calling thread's region created
+ * since mark; outside a region, nothing is released while the store is
+ * shared */
+void termRelease(Term mark);
+
+/* shareTermStore - with shared set, one more thread or engine creates terms
+ * beside the first, until shareTermStore(0); the store is locked while any
+ * does */
+void shareTermStore(int shared);
+/* termStoreShared - returns 1 while the store is shared between threads */
+int termStoreShared(void);
+
+/* charClass - 1 for characters of word names, 2 for those of symbol names
+ * such as "=<", 0 for control characters and whitespace */
+int charClass(char c);
+/* parseTerm - parses a clause, query or term ("h:-b1,b2." etc.); 0 on syntax error */
+Term parseTerm(const char *text);
+/* termToString - returns text of t (caller frees) */
+char *termToString(Term t);
+/* clauseToString - returns text of t followed by a period (caller frees) */
+char *clauseToString(Term t);
+
+#endif
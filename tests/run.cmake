@@ -0,0 +1,28 @@
+# run.cmake - runs PPP in batch mode on the knowledge base KB with the
+# queries in QUERIES and compares what it writes with EXPECTED, leaving out
+# the time and memory each query took. ARGS holds further options. With
+# IMAGE set, KB is compiled to IMAGE first and the queries run on the
+# image. With NOTHETA set, the bindings are left out of both, as parallel
+# workers number renamed variables in their own order.
+if(IMAGE)
+  execute_process(COMMAND ${PPP} --compile ${KB} -o ${IMAGE} RESULT_VARIABLE result)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "cannot compile ${KB}: ${result}")
+  endif()
+  set(KB ${IMAGE})
+endif()
+separate_arguments(ARGS)
+execute_process(COMMAND ${PPP} ${ARGS} --queries ${QUERIES} ${KB}
+  OUTPUT_VARIABLE output RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "ppp ${ARGS} ${KB} ended with ${result}")
+endif()
+file(READ ${EXPECTED} expected)
+string(REGEX REPLACE ",\"time_ms\":[0-9.]+,\"peak_bytes\":[0-9]+" "" output "${output}")
+if(NOTHETA)
+  string(REGEX REPLACE ",\"theta\":\"[^\"]*\"" "" output "${output}")
+  string(REGEX REPLACE ",\"theta\":\"[^\"]*\"" "" expected "${expected}")
+endif()
+if(NOT output STREQUAL expected)
+  message(FATAL_ERROR "ppp ${ARGS} ${KB} does not answer as ${EXPECTED}:\n${output}")
+endif()
@@ -0,0 +1,222 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Brian O'Dell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "unifier.h"
+#include "account.h"
+#include "utils.h"
+
+Unifier *newUnifier(){
+  Unifier *u = accountAlloc(MEMUNIFIERS, sizeof(Unifier));
+  u->size = 64;
+  u->bindings = accountAlloc(MEMUNIFIERS, u->size * sizeof(Term));
+  for(unsigned int i = 0; i<u->size; i++) u->bindings[i] = 0;
+  u->trailsize = 64;
+  u->trail = accountAlloc(MEMUNIFIERS, u->trailsize * sizeof(Term));
+  u->count = 0;
+  u->bound = 0;
+  for(int i = 0; i<32; i++) u->boundcounts[i] = 0;
+  u->occurs = OCCURSOFF;
+  u->cyclic = 0;
+  u->expanding = NULL;
+  u->expandingsize = 0;
+  return u;
+}
+
+void freeUnifier(Unifier **unifier){
+  if(!(* unifier)) return;
+  accountFree(MEMUNIFIERS, (* unifier)->bindings, (* unifier)->size * sizeof(Term));
+  accountFree(MEMUNIFIERS, (* unifier)->trail, (* unifier)->trailsize * sizeof(Term));
+  accountFree(MEMUNIFIERS, (* unifier)->expanding, (* unifier)->expandingsize);
+  accountFree(MEMUNIFIERS, * unifier, sizeof(Unifier));
+  (* unifier) = NULL;
+}
+
+Term getBound(Term var, Unifier *unifier){
+  if(!var || !unifier || termType(var) != TTVARIABLE) return 0;
+  unsigned int slot = termSlot(var);
+  if(slot >= unifier->size) return 0;
+  return unifier->bindings[slot];
+}
+
+Term deref(Term t, Unifier *unifier){
+  Term bound = getBound(t, unifier);
+  while(bound){
+    t = bound;
+    bound = getBound(t, unifier);
+  }
+  return t;
+}
+
+Term substitute(Term t, Unifier *unifier){
+  if(!t) return 0;
+  if(unifier->expandingsize < unifier->size){
+    unifier->expanding = accountRealloc(MEMUNIFIERS, unifier->expanding,
+      unifier->expandingsize, unifier->size);
+    memset(unifier->expanding + unifier->expandingsize, 0, unifier->size - unifier->expandingsize);
+    unifier->expandingsize = unifier->size;
+  }
+  // frames holds each term being rebuilt, where its arguments start in
+  // values and where the variables whose bindings it came from start in path
+  TermStack frames, values, path;
+  initTermStack(&frames);
+  initTermStack(&values);
+  initTermStack(&path);
+  for(;;){
+    int mark = path.count;
+    Term bound;
+    while((bound = getBound(t, unifier)) && !unifier->expanding[termSlot(t)]){
+      unifier->expanding[termSlot(t)] = 1;
+      PUSH_TERM(&path, t);
+      t = bound;
+    }
+    // a subterm none of whose variables is bound is final as it is
+    if(termArity(t) && (termVariables(t) & unifier->bound)){
+      PUSH_TERM(&frames, t);
+      PUSH_TERM(&frames, (Term)values.count);
+      PUSH_TERM(&frames, (Term)mark);
+      t = termArg(t, 0);
+      continue;
+    }
+    while(path.count > mark) unifier->expanding[termSlot(path.items[--path.count])] = 0;
+    PUSH_TERM(&values, t);
+    while(frames.count){
+      Term f = frames.items[frames.count - 3];
+      int base = (int)frames.items[frames.count - 2];
+      int arity = termArity(f);
+      if(values.count - base < arity) break;
+      mark = (int)frames.items[frames.count - 1];
+      while(path.count > mark) unifier->expanding[termSlot(path.items[--path.count])] = 0;
+      Term *args = &values.items[base];
+      int i = 0;
+      while(i<arity && args[i] == termArg(f, i)) i++;
+      if(i < arity) f = functorTerm(termName(f), arity, args);
+      values.count = base;
+      frames.count -= 3;
+      PUSH_TERM(&values, f);
+    }
+    if(!frames.count) break;
+    t = termArg(frames.items[frames.count - 3], values.count - (int)frames.items[frames.count - 2]);
+  }
+  Term result = values.items[0];
+  freeTermStack(&frames);
+  freeTermStack(&values);
+  freeTermStack(&path);
+  return result;
+}
+
+int cyclesOnly(Term t, Unifier *unifier){
+  TermStack pending;
+  initTermStack(&pending);
+  int cycles = 1;
+  for(;;){
+    if(termType(t) == TTVARIABLE){
+      cycles = getBound(t, unifier) != 0;
+      if(!cycles) break;
+    } else if(!termIsGround(t)){
+      for(int i = termArity(t) - 1; i>=0; i--) PUSH_TERM(&pending, termArg(t, i));
+    }
+    if(!pending.count) break;
+    t = pending.items[--pending.count];
+  }
+  freeTermStack(&pending);
+  return cycles;
+}
+
+void bind(Unifier *unifier, Term var, Term term){
+  unsigned int slot = termSlot(var);
+  if(slot >= unifier->size){
+    unsigned int size = unifier->size;
+    while(slot >= size) size *= 2;
+    unifier->bindings = accountRealloc(MEMUNIFIERS, unifier->bindings,
+      unifier->size * sizeof(Term), size * sizeof(Term));
+    for(unsigned int i = unifier->size; i<size; i++) unifier->bindings[i] = 0;
+    unifier->size = size;
+  }
+  if(unifier->count == unifier->trailsize){
+    unifier->trail = accountRealloc(MEMUNIFIERS, unifier->trail,
+      unifier->trailsize * sizeof(Term), 2 * unifier->trailsize * sizeof(Term));
+    unifier->trailsize *= 2;
+  }
+  unifier->bindings[slot] = term;
+  unifier->trail[unifier->count++] = var;
+  unifier->boundcounts[slot & 31]++;
+  unifier->bound |= SLOT_SUMMARY(slot);
+}
+
+int occursIn(Term var, Term t, Unifier *unifier){
+  unsigned int summary = unifier->bound | SLOT_SUMMARY(termSlot(var));
+  TermStack pending;
+  initTermStack(&pending);
+  int found = 0;
+  for(;;){
+    t = deref(t, unifier);
+    if(t == var){
+      found = 1;
+      break;
+    }
+    // a subterm without bound variables is as written, and var is not in
+    // it unless its bit is in the summary
+    if(termVariables(t) & summary){
+      for(int i = termArity(t) - 1; i>=0; i--) PUSH_TERM(&pending, termArg(t, i));
+    }
+    if(!pending.count) break;
+    t = pending.items[--pending.count];
+  }
+  freeTermStack(&pending);
+  return found;
+}
+
+int unifierMark(Unifier *unifier){
+  return unifier->count;
+}
+
+void undoBindings(Unifier *unifier, int mark){
+  while(unifier->count > mark){
+    Term var = unifier->trail[--unifier->count];
+    unsigned int slot = termSlot(var);
+    unifier->bindings[slot] = 0;
+    if(!--unifier->boundcounts[slot & 31]) unifier->bound &= ~SLOT_SUMMARY(slot);
+  }
+}
+
+char *unifierToString(Unifier *unifier){
+  if(!unifier || !unifier->count) return copyString("{ | }");
+  StringBuffer sb;
+  initStringBuffer(&sb);
+  for(int i = 0; i<unifier->count; i++){
+    Term var = unifier->trail[i];
+    char *v = termToString(var);
+    char *bound = termToString(substitute(var, unifier));
+    appendChar(&sb, '{');
+    appendString(&sb, v);
+    appendChar(&sb, '|');
+    appendString(&sb, bound);
+    appendChar(&sb, '}');
+    free(v);
+    free(bound);
+  }
+  return takeString(&sb);
+}
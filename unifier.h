@@ -0,0 +1,101 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Brian O'Dell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PPP_UNIFIER
+#define PPP_UNIFIER
+
+#include "term.h"
+
+/**
+ * Unifier (Θ)
+ *
+ * Bindings are kept per variable slot, so looking a variable up is a
+ * single array access. Every binding is pushed on the trail; backtracking
+ * takes a mark before trying an alternative and undoes back to it.
+ * The familiar {X|a}{Y|b} form is only produced for display.
+ *
+ * With the occurs check on, a variable is not bound to a term it occurs
+ * in once that term's bindings are followed. The walk skips ground
+ * subterms and, through the variable summaries of the term store,
+ * subterms none of whose variables is bound, so binding to a ground term
+ * or a fresh structure costs no walk at all.
+ */
+
+/* OccursCheck - what unify does when a variable would be bound to a term
+ * containing it: bind it anyway (off), fail (on), or fail and flag the
+ * unifier so the query stops (error) */
+typedef enum
+{
+  OCCURSOFF, OCCURSON, OCCURSERROR
+}OccursCheck;
+
+typedef struct UNIFIER{
+  Term *bindings;      /* bindings[slot] - term bound to the variable; 0 if unbound */
+  unsigned int size;
+  Term *trail;         /* bound variables, oldest first */
+  int count;
+  int trailsize;
+  unsigned int bound;  /* variable summary of the bound variables */
+  int boundcounts[32]; /* bound variables per summary bit */
+  OccursCheck occurs;
+  int cyclic;          /* a binding failed the occurs check in error mode */
+  unsigned char *expanding; /* expanding[slot] - substitute is inside the binding */
+  unsigned int expandingsize;
+} Unifier;
+
+Unifier *newUnifier();
+
+void freeUnifier(Unifier **unifier);
+
+/* getBound - term bound to var; 0 if var is unbound */
+Term getBound(Term var, Unifier *unifier);
+
+/* deref - follows bindings from t until a non-variable or an unbound variable */
+Term deref(Term t, Unifier *unifier);
+
+/* substitute - returns t with every bound variable replaced by its value.
+ * With the occurs check off a variable may be bound to a term containing
+ * it; it is left as it is where it is met again inside its own value */
+Term substitute(Term t, Unifier *unifier);
+
+/* cyclesOnly - 1 if every variable substitute left in t is bound, so it
+ * only stands where a cycle is cut; 0 if one is unbound */
+int cyclesOnly(Term t, Unifier *unifier);
+
+/* bind - binds var to term and records it on the trail */
+void bind(Unifier *unifier, Term var, Term term);
+
+/* occursIn - returns 1 if var occurs in t once t's bindings are followed */
+int occursIn(Term var, Term t, Unifier *unifier);
+
+/* unifierMark - returns the current trail position */
+int unifierMark(Unifier *unifier);
+
+/* undoBindings - unbinds every variable bound since mark */
+void undoBindings(Unifier *unifier, int mark);
+
+/* unifierToString - returns Θ in the form {X|a}{Y|b}... (caller frees) */
+char *unifierToString(Unifier *unifier);
+
+#endif
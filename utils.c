@@ -22,29 +22,27 @@
  * SOFTWARE.
  */
 
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include "utils.h"
 
-char tib[B_TIB_LENGTH];
-int tibIndex;
 
 int strcomp(char *s1, char * s2){
-  for(int i=0; i<B_MAX_STRING_LENGTH; i++){
+  for(int i=0; ; i++){
     if(s1[i]!=s2[i]) return i+1;
     if(s1[i]==0) return 0;
   }
-  return 0;
 }
 
 void strcopy(const char *from, char *to){
   if(!from) return;
-  for(int i=0; i<B_MAX_STRING_LENGTH; i++){
-    if(from[i]!=0){
-      to[i]=from[i];
-    }
-    else{
-      to[i]=0;
-      break;
-    }
+  for(int i=0; ; i++){
+    to[i]=from[i];
+    if(from[i]==0) break;
   }
 }
 
@@ -57,7 +55,7 @@ int strlength(const char *s){
   return c;
 }
 
-char *copyString(char *str){
+char *copyString(const char *str){
   if(!str) return NULL;
   char *newstr = malloc(strlength(str)+1);
   strcopy(str, newstr);
@@ -89,14 +87,57 @@ int strInStr(char *str, char *search){
 }
 
 char *concat(const char *str1, const char *str2){
-  char buf[B_MAX_STRING_LENGTH];
-  strcopy(str1, buf);
-  strcopy(str2, buf + strlength(str1));
-  char *newstr = malloc(strlength(buf)+1);
-  strcopy(buf, newstr);
+  int length1 = strlength(str1);
+  char *newstr = malloc(length1 + strlength(str2) + 1);
+  newstr[0] = '\0';
+  strcopy(str1, newstr);
+  strcopy(str2, newstr + length1);
   return newstr;
 }
 
+void initStringBuffer(StringBuffer *sb){
+  sb->str = NULL;
+  sb->length = 0;
+  sb->size = 0;
+}
+
+void appendChar(StringBuffer *sb, char c){
+  if(sb->length + 1 >= sb->size){
+    int size = sb->size ? sb->size * 2 : 64;
+    sb->str = realloc(sb->str, size);
+    sb->size = size;
+  }
+  sb->str[sb->length++] = c;
+  sb->str[sb->length] = '\0';
+}
+
+void appendString(StringBuffer *sb, const char *s){
+  if(!s) return;
+  while(*s) appendChar(sb, *s++);
+}
+
+char *takeString(StringBuffer *sb){
+  char *str = sb->str;
+  if(!str) str = copyString("");
+  initStringBuffer(sb);
+  return str;
+}
+
+char *readLine(FILE *f){
+  StringBuffer sb;
+  initStringBuffer(&sb);
+  char chunk[256];
+  while(fgets(chunk, sizeof(chunk), f)){
+    appendString(&sb, chunk);
+    if(sb.str[sb.length - 1] == '\n'){
+      sb.str[--sb.length] = '\0';
+      break;
+    }
+  }
+  if(!sb.str) return NULL;
+  return takeString(&sb);
+}
+
 int atoint(const char* s){
     int num = 0;
     int i = 0;
@@ -113,26 +154,11 @@ int atoint(const char* s){
     return num;
 }
 
-void resetTib(){
-  tibIndex=0;
-  tib[tibIndex]=0;
-}
-
 void output(char *s){
   fputs(s, stdout);
   fflush(stdout);
 }
 
-void input(void){
-  int i;
-	resetTib();
-	fgets(tib, B_TIB_LENGTH, stdin);
-	for(i=0;i<B_TIB_LENGTH; i++){
-		if(tib[i]=='\n')
-			tib[i]=0;
-	}
-}
-
 long getFileSize(const char *pathname){
   long sz;
   FILE *f;
@@ -146,40 +172,75 @@ long getFileSize(const char *pathname){
 }
 
 char *loadMemFile(const char *pathname){
-  char c;
-  long sz = getFileSize(pathname);
-  long i = 0;
-  char *memfile = malloc(sz+1);
-  if(memfile == NULL) return NULL;
-  FILE *f = fopen(pathname, "r");
-  if(f == NULL) return NULL;
-  do
-  {
-    c = fgetc(f);
-    memfile[i++] = c;
-  } while (c != EOF);
-  
-  fclose(f);
-  return memfile;
+  return loadMemFileWithSize(pathname, getFileSize(pathname));
 }
 
 char *loadMemFileWithSize(const char *pathname, long size){
-  char c;
-  long i = 0;
   char *memfile = malloc(size+1);
   if(memfile == NULL) return NULL;
   FILE *f = fopen(pathname, "r");
-  if(f == NULL) return NULL;
-  do
-  {
-    c = fgetc(f);
-    memfile[i++] = c;
-  } while (c != EOF);
-  
+  if(f == NULL){
+    free(memfile);
+    return NULL;
+  }
+  size_t n = fread(memfile, 1, size, f);
+  memfile[n] = (char)EOF;
   fclose(f);
   return memfile;
 }
 
+int mapFile(const char *pathname, char **data, size_t *size){
+  (* data) = NULL;
+  (* size) = 0;
+  int fd = open(pathname, O_RDONLY);
+  if(fd < 0) return 0;
+  struct stat st;
+  if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode)){
+    if(st.st_size == 0){
+      close(fd);
+      return 1;
+    }
+    void *p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if(p != MAP_FAILED){
+      close(fd);
+      (* data) = p;
+      (* size) = st.st_size;
+      return 1;
+    }
+  }
+  // pipes and the like are read into anonymous pages of growing size
+  size_t capacity = 1 << 16;
+  char *buf = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  size_t used = 0;
+  ssize_t n;
+  while(buf != MAP_FAILED && (n = read(fd, buf + used, capacity - used)) > 0){
+    used += n;
+    if(used < capacity) continue;
+    char *bigger = mmap(NULL, capacity * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(bigger != MAP_FAILED) memcpy(bigger, buf, used);
+    munmap(buf, capacity);
+    buf = bigger;
+    capacity *= 2;
+  }
+  close(fd);
+  if(buf == MAP_FAILED) return 0;
+  if(!used){
+    munmap(buf, capacity);
+    return 1;
+  }
+  // munmap works in whole pages, so unmapFile(buf, used) releases the rest
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t keep = (used + page - 1) & ~(page - 1);
+  if(keep < capacity) munmap(buf + keep, capacity - keep);
+  (* data) = buf;
+  (* size) = used;
+  return 1;
+}
+
+void unmapFile(char *data, size_t size){
+  if(data) munmap(data, size);
+}
+
 FILE *openFile(char *pathname, char *mode){
   FILE *f = fopen(pathname, mode);
   return f;
@@ -191,4 +252,15 @@ void outputFile(FILE *f, char *s){
 
 int closeFile(FILE *f){
   return fclose(f);
-}
\ No newline at end of file
+}
+
+void outputJSONString(FILE *f, const char *s){
+  fputc('"', f);
+  for(; *s; s++){
+    unsigned char c = *s;
+    if(c == '"' || c == '\\') fprintf(f, "\\%c", c);
+    else if(c < 0x20) fprintf(f, "\\u%04x", c);
+    else fputc(c, f);
+  }
+  fputc('"', f);
+}
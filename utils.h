@@ -28,14 +28,6 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-#define B_TIB_LENGTH 256
-#define B_MAX_STRING_LENGTH 4096
-
-/* tibIndex - an index for The Input Buffer (tib) */
-extern int tibIndex;
-/* tib - The Input Buffer, B_TIB_LENGTH bytes long */
-extern char tib[B_TIB_LENGTH];
-
 /* strcomp - Compare 2 strings; Returns 0 if identical otherwise first different char */
 int strcomp(char *s1, char * s2); 
 /* strcopy - copies chars from 'from' to 'to' until a 0 value is encountered. */
@@ -43,21 +35,36 @@ void strcopy(const char *from, char *to);
 /* strlength - returns number of bytes before a 0 value is encountered */
 int strlength(const char *s);
 /* copyString - returns a copy of str */
-char *copyString(char *str);
+char *copyString(const char *str);
 /* returns location of character c in s; 0 if not found */
 int charInStr(char *str, char search);
 /* strInStr - returns the first occurence of search in str */
 int strInStr(char *str, char *search);
 /* concat - returns a new (char *) pointint to beginning of str1 & str2 */
 char *concat(const char *str1, const char *str2);
+
+/* StringBuffer - a string that grows as characters are appended */
+typedef struct STRING_BUFFER{
+  char *str;
+  int length;
+  int size;
+} StringBuffer;
+
+/* initStringBuffer - prepares an empty buffer */
+void initStringBuffer(StringBuffer *sb);
+/* appendChar - appends c to the buffer */
+void appendChar(StringBuffer *sb, char c);
+/* appendString - appends s to the buffer */
+void appendString(StringBuffer *sb, const char *s);
+/* takeString - returns the buffer contents (caller frees) and resets sb */
+char *takeString(StringBuffer *sb);
+/* readLine - reads a line of any length without its newline; NULL at the
+ * end of f (caller frees) */
+char *readLine(FILE *f);
 /* convert string to int; will return a number by ignoring all non digits in string */
 int atoint(const char* s);
-/* resetTib -  clears first byte of tib and sets tibIndex to 0 */
-void resetTib();
 /* output - hardware independent print */
 void output(char *s);
-/* input - hardware independent console input */
-void input(void);
 /* getFileSize - hardware independent file size (bytes) */
 long getFileSize(const char *pathname);
 /* loadMemFile - hardware independent; loads entire file into memory, 
@@ -68,10 +75,20 @@ returning a pointer to first byte; last byte is EOF;
 avoids call to getFileSize */
 char *loadMemFileWithSize(const char *pathname, long size);
 
+/* mapFile - maps pathname privately so the caller may edit it in place;
+ * files that cannot be mapped are read into anonymous memory instead. An
+ * empty file gives NULL data. Returns 0 if the file cannot be opened */
+int mapFile(const char *pathname, char **data, size_t *size);
+/* unmapFile - releases memory returned by mapFile */
+void unmapFile(char *data, size_t size);
+
 FILE *openFile(char *pathname, char *mode);
 
 int closeFile(FILE *f);
 
 void outputFile(FILE *f, char *s);
 
+/* outputJSONString - writes s to f as a quoted, escaped JSON string */
+void outputJSONString(FILE *f, const char *s);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,1160 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Brian O'Dell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "wam.h"
+#include "index.h"
+#include "arith.h"
+#include "utils.h"
+
+typedef enum
+{
+  WREF, WSTR, WCON, WFUN
+}WamTag;
+
+/* WamCell - heap, register and stack word; REF/STR hold heap addresses,
+ * CON a constant (the term of an atom or integer) and FUN a functor name
+ * with its arity */
+typedef struct WAM_CELL{
+  WamTag tag;
+  int arity;
+  unsigned int value;
+} WamCell;
+
+typedef struct PROCEDURE{
+  unsigned long long key;
+  int id;
+  int address;         /* -1 while the predicate has no clauses */
+} Procedure;
+
+typedef struct CHOICEPOINT{
+  int arity;
+  int args;            /* saved argument registers in ArgStack */
+  int e;
+  int cp;
+  int b;
+  int next;            /* address of the alternative clause */
+  int tr;
+  int h;
+  int etop;            /* environment stack top to protect */
+} Choicepoint;
+
+typedef enum
+{
+  WMREAD, WMWRITE
+}WamMode;
+
+/* Machine - the compiled program of an engine and the VM that runs it */
+struct MACHINE{
+  Engine *engine;
+  WamInstruction *code;
+  int codecount;
+  int codesize;
+  int programcount;    /* code of the KB; a query is compiled after it */
+
+  Procedure **procedures;
+  int procedurecount;
+  int proceduresize;
+  KeyTable proceduretable;
+  int compiled;        /* proceduretable holds the procedures of a KB */
+
+  int registercount;
+
+  WamCell *heap;
+  int heapsize;
+  WamCell *x;
+  WamCell *stack;
+  int stacksize;
+  Choicepoint *choicepoints;
+  int choicepointsize;
+  WamCell *argstack;
+  int argstacksize;
+  int *trail;
+  int trailsize;
+
+  /* occurs check: structures seen in this walk are marked with epoch */
+  unsigned int *marks;
+  int marksize;
+  unsigned int epoch;
+  /* cells still to visit by a walk of the heap; unification keeps its
+   * pairs apart since binding may run the occurs check */
+  WamCell *pending;
+  int pendingsize;
+  WamCell *pairs;
+  int pairsize;
+
+  /* machine registers; b0 is b when the running predicate was called */
+  int p, cp, e, b, b0, h, hb, s, tr, numargs;
+  WamMode mode;
+  int built;           /* structure get_structure fills in write mode */
+
+  Symbol unbound;
+};
+
+/* ---- compiler ---- */
+
+static int emit(Machine *m, WamOp op, int reg, int arg, unsigned int value){
+  if(m->codecount == m->codesize){
+    m->codesize = m->codesize ? m->codesize * 2 : 256;
+    m->code = realloc(m->code, m->codesize * sizeof(WamInstruction));
+  }
+  m->code[m->codecount].op = op;
+  m->code[m->codecount].reg = reg;
+  m->code[m->codecount].arg = arg;
+  m->code[m->codecount].value = value;
+  return m->codecount++;
+}
+
+static Procedure *procedure(Machine *m, unsigned long long key){
+  Procedure *proc = getKey(&m->proceduretable, key);
+  if(proc) return proc;
+  if(m->procedurecount == m->proceduresize){
+    m->proceduresize = m->proceduresize ? m->proceduresize * 2 : 64;
+    m->procedures = realloc(m->procedures, m->proceduresize * sizeof(Procedure *));
+  }
+  proc = malloc(sizeof(Procedure));
+  proc->key = key;
+  proc->id = m->procedurecount;
+  proc->address = -1;
+  m->procedures[m->procedurecount++] = proc;
+  putKey(&m->proceduretable, key, proc);
+  return proc;
+}
+
+/* VarInfo - register allocation of one clause variable */
+typedef struct VAR_INFO{
+  Term var;
+  int firstchunk;
+  int lastchunk;
+  int reg;
+  int seen;
+} VarInfo;
+
+typedef struct CLAUSE_COMPILER{
+  VarInfo *vars;
+  int count;
+  int size;
+  int nexttemp;
+  int permanents;
+  int allpermanent;
+} ClauseCompiler;
+
+static VarInfo *findVar(ClauseCompiler *cc, Term var){
+  for(int i = 0; i<cc->count; i++){
+    if(cc->vars[i].var == var) return &cc->vars[i];
+  }
+  return NULL;
+}
+
+static void collectVars(ClauseCompiler *cc, Term t, int chunk){
+  TermStack pending;
+  initTermStack(&pending);
+  for(;;){
+    if(termType(t) == TTVARIABLE){
+      VarInfo *v = findVar(cc, t);
+      if(!v){
+        if(cc->count == cc->size){
+          cc->size = cc->size ? cc->size * 2 : 8;
+          cc->vars = realloc(cc->vars, cc->size * sizeof(VarInfo));
+        }
+        v = &cc->vars[cc->count++];
+        v->var = t;
+        v->firstchunk = chunk;
+        v->reg = 0;
+        v->seen = 0;
+      }
+      v->lastchunk = chunk;
+    } else if(!termIsGround(t)){
+      for(int i = termArity(t) - 1; i>=0; i--) PUSH_TERM(&pending, termArg(t, i));
+    }
+    if(!pending.count) break;
+    t = pending.items[--pending.count];
+  }
+  freeTermStack(&pending);
+}
+
+/* useVar - register of var; sets *first when this is its first occurrence */
+static int useVar(ClauseCompiler *cc, Term var, int *first){
+  VarInfo *v = findVar(cc, var);
+  *first = !v->seen;
+  if(!v->seen){
+    v->seen = 1;
+    if(cc->allpermanent || v->firstchunk != v->lastchunk){
+      v->reg = WAM_Y(cc->permanents++);
+    } else {
+      v->reg = cc->nexttemp++;
+    }
+  }
+  return v->reg;
+}
+
+static int newTemp(ClauseCompiler *cc){
+  return cc->nexttemp++;
+}
+
+static unsigned int constantOf(Term t){
+  // atoms and integers are hash-consed, so equal constants share a term
+  return t;
+}
+
+static int isStructure(Term t){
+  return termType(t) != TTVARIABLE && termArity(t) > 0;
+}
+
+/* Nested - a structure argument and the register it is compiled from or
+ * into; nested keeps the registers of its own structure arguments */
+typedef struct NESTED{
+  Term term;
+  int reg;
+  int next;
+  int *nested;
+} Nested;
+
+static Nested *pushNested(Nested **stack, int *count, int *size, Term t, int reg){
+  if((* count) == (* size)){
+    (* size) = (* size) ? (* size) * 2 : 16;
+    (* stack) = realloc(* stack, (* size) * sizeof(Nested));
+  }
+  Nested *n = &(* stack)[(* count)++];
+  n->term = t;
+  n->reg = reg;
+  n->next = 0;
+  n->nested = malloc(termArity(t) * sizeof(int));
+  return n;
+}
+
+/* compileHeadArg - matches argument ai against t; the structures nested
+ * in t follow it, depth first */
+static void compileHeadArg(Machine *m, ClauseCompiler *cc, Term t, int ai){
+  int first;
+  if(termType(t) == TTVARIABLE){
+    int reg = useVar(cc, t, &first);
+    emit(m, first ? WIGETVARIABLE : WIGETVALUE, reg, ai, 0);
+    return;
+  }
+  if(!termArity(t)){
+    emit(m, WIGETCONSTANT, 0, ai, constantOf(t));
+    return;
+  }
+  Nested *stack = NULL;
+  int count = 0, size = 0;
+  pushNested(&stack, &count, &size, t, ai);
+  while(count){
+    Nested n = stack[--count];
+    int arity = termArity(n.term);
+    emit(m, WIGETSTRUCTURE, n.reg, arity, termName(n.term));
+    for(int i = 0; i<arity; i++){
+      Term a = termArg(n.term, i);
+      n.nested[i] = -1;
+      if(termType(a) == TTVARIABLE){
+        int reg = useVar(cc, a, &first);
+        emit(m, first ? WIUNIFYVARIABLE : WIUNIFYVALUE, reg, 0, 0);
+      } else if(!termArity(a)){
+        emit(m, WIUNIFYCONSTANT, 0, 0, constantOf(a));
+      } else {
+        n.nested[i] = newTemp(cc);
+        emit(m, WIUNIFYVARIABLE, n.nested[i], 0, 0);
+      }
+    }
+    for(int i = arity - 1; i>=0; i--){
+      if(n.nested[i] >= 0) pushNested(&stack, &count, &size, termArg(n.term, i), n.nested[i]);
+    }
+    free(n.nested);
+  }
+  free(stack);
+}
+
+/* putStructure - builds t bottom up, leaving it in register target */
+static void putStructure(Machine *m, ClauseCompiler *cc, Term t, int target){
+  Nested *stack = NULL;
+  int count = 0, size = 0;
+  int first;
+  pushNested(&stack, &count, &size, t, target);
+  while(count){
+    Nested *n = &stack[count - 1];
+    int arity = termArity(n->term);
+    if(n->next < arity){
+      // a structure argument is built before the structure holding it
+      Term a = termArg(n->term, n->next);
+      int i = n->next++;
+      n->nested[i] = -1;
+      if(isStructure(a)){
+        n->nested[i] = newTemp(cc);
+        pushNested(&stack, &count, &size, a, n->nested[i]);
+      }
+      continue;
+    }
+    emit(m, WIPUTSTRUCTURE, n->reg, arity, termName(n->term));
+    for(int i = 0; i<arity; i++){
+      Term a = termArg(n->term, i);
+      if(n->nested[i] >= 0){
+        emit(m, WISETVALUE, n->nested[i], 0, 0);
+      } else if(termType(a) == TTVARIABLE){
+        int reg = useVar(cc, a, &first);
+        emit(m, first ? WISETVARIABLE : WISETVALUE, reg, 0, 0);
+      } else {
+        emit(m, WISETCONSTANT, 0, 0, constantOf(a));
+      }
+    }
+    free(n->nested);
+    count--;
+  }
+  free(stack);
+}
+
+static void compileBodyArg(Machine *m, ClauseCompiler *cc, Term t, int ai){
+  int first;
+  if(termType(t) == TTVARIABLE){
+    int reg = useVar(cc, t, &first);
+    emit(m, first ? WIPUTVARIABLE : WIPUTVALUE, reg, ai, 0);
+  } else if(!termArity(t)){
+    emit(m, WIPUTCONSTANT, 0, ai, constantOf(t));
+  } else {
+    putStructure(m, cc, t, ai);
+  }
+}
+
+/* compileGoal - loads the goal's arguments; returns 0 if goal cannot be called */
+static int compileGoal(Machine *m, ClauseCompiler *cc, Term goal){
+  if(termType(goal) == TTVARIABLE) return 0;
+  for(int i = 0; i<termArity(goal); i++) compileBodyArg(m, cc, termArg(goal, i), i);
+  return 1;
+}
+
+static int goalList(Term body, Term **goals){
+  int count = 0;
+  int size = 4;
+  (* goals) = malloc(size * sizeof(Term));
+  while(body){
+    if(count == size){
+      size *= 2;
+      (* goals) = realloc(* goals, size * sizeof(Term));
+    }
+    if(termType(body) == TTCONJUNCTION){
+      (* goals)[count++] = termArg(body, 0);
+      body = termArg(body, 1);
+    } else {
+      (* goals)[count++] = body;
+      body = 0;
+    }
+  }
+  return count;
+}
+
+/* calledGoal - the goal once/1 calls, unwrapping nested ones */
+static Term calledGoal(Term goal){
+  while(termType(goal) == TTFUNCTOR && termName(goal) == SymOnce && termArity(goal) == 1){
+    goal = termArg(goal, 0);
+  }
+  return goal;
+}
+
+static int isCut(Term goal){
+  return termType(goal) == TTATOM && termName(goal) == SymCut;
+}
+
+static int maxArity(Term head, Term *goals, int count){
+  int m = head ? termArity(head) : 0;
+  for(int i = 0; i<count; i++){
+    if(termArity(calledGoal(goals[i])) > m) m = termArity(calledGoal(goals[i]));
+  }
+  return m;
+}
+
+/* compileCall - emits goal; ! cuts back to the level saved in register
+ * level and once(G) to the one saved before G. Arithmetic loads its
+ * arguments and evaluates them in place. A last goal ends the clause, by
+ * execute when it is a call */
+static void compileCall(Machine *m, ClauseCompiler *cc, Term goal, int level, int last){
+  // each once/1 around the goal saves a level before it and cuts after it
+  int *saved = NULL;
+  int depth = 0, size = 0;
+  while(goal != calledGoal(goal)){
+    if(depth == size){
+      size = size ? size * 2 : 4;
+      saved = realloc(saved, size * sizeof(int));
+    }
+    level = saved[depth++] = WAM_Y(cc->permanents++);
+    emit(m, WISAVELEVEL, level, 0, 0);
+    goal = termArg(goal, 0);
+  }
+  if(isCut(goal)){
+    emit(m, WICUT, level, 0, 0);
+  } else if(isArithmetic(goal)){
+    compileGoal(m, cc, goal);
+    emit(m, WIARITH, 0, 2, termName(goal));
+  } else if(!compileGoal(m, cc, goal)){
+    emit(m, WIFAIL, 0, 0, 0);
+    if(!depth) last = 0;
+  } else {
+    int proc = procedure(m, termKey(goal))->id;
+    if(last && !depth){
+      emit(m, WIDEALLOCATE, 0, 0, 0);
+      emit(m, WIEXECUTE, 0, termArity(goal), proc);
+      last = 0;
+    } else {
+      emit(m, WICALL, 0, termArity(goal), proc);
+    }
+  }
+  while(depth) emit(m, WICUT, saved[--depth], 0, 0);
+  free(saved);
+  if(last){
+    emit(m, WIDEALLOCATE, 0, 0, 0);
+    emit(m, WIPROCEED, 0, 0, 0);
+  }
+}
+
+/* compileClause - emits head and body; with query set, every variable is
+ * permanent and the code ends in an answer instead of returning */
+static void compileClause(Machine *m, Term head, Term body, int query, ClauseCompiler *cc){
+  Term *goals;
+  int count = goalList(body, &goals);
+  cc->count = 0;
+  cc->permanents = 0;
+  cc->allpermanent = query;
+  cc->nexttemp = maxArity(head, goals, count);
+  if(head) collectVars(cc, head, 0);
+  for(int i = 0; i<count; i++) collectVars(cc, goals[i], i);
+
+  int allocate = -1;
+  if(count || query) allocate = emit(m, WIALLOCATE, 0, 0, 0);
+  int level = 0;
+  for(int i = 0; i<count && !level; i++){
+    if(!isCut(goals[i])) continue;
+    level = WAM_Y(cc->permanents++);
+    emit(m, WIGETLEVEL, level, 0, 0);
+  }
+  if(head){
+    for(int i = 0; i<termArity(head); i++) compileHeadArg(m, cc, termArg(head, i), i);
+  }
+  for(int i = 0; i<count; i++) compileCall(m, cc, goals[i], level, i == count - 1 && !query);
+  if(query) emit(m, WIANSWER, 0, 0, 0);
+  else if(!count) emit(m, WIPROCEED, 0, 0, 0);
+  if(allocate >= 0) m->code[allocate].arg = cc->permanents;
+  if(cc->nexttemp > m->registercount) m->registercount = cc->nexttemp;
+  free(goals);
+}
+
+static void compilePredicate(Machine *m, Predicate *pred, ClauseCompiler *cc){
+  Procedure *proc = procedure(m, pred->key);
+  int clauses = 0;
+  for(int i = 0; i<pred->count; i++){
+    if(pred->clauses[i]->term) clauses++;
+  }
+  if(!clauses) return;
+  proc->address = m->codecount;
+  int alternative = -1;
+  int c = 0;
+  for(int i = 0; i<pred->count; i++){
+    Term clause = pred->clauses[i]->term;
+    if(!clause) continue;
+    if(alternative >= 0) m->code[alternative].value = m->codecount;
+    alternative = -1;
+    if(clauses > 1){
+      if(c == 0) alternative = emit(m, WITRYMEELSE, 0, 0, 0);
+      else if(c < clauses - 1) alternative = emit(m, WIRETRYMEELSE, 0, 0, 0);
+      else emit(m, WITRUSTME, 0, 0, 0);
+    }
+    c++;
+    if(termType(clause) == TTCLAUSE){
+      compileClause(m, termArg(clause, 0), termArg(clause, 1), 0, cc);
+    } else {
+      compileClause(m, clause, 0, 0, cc);
+    }
+  }
+}
+
+static void freeProgram(Machine *m){
+  for(int i = 0; i<m->procedurecount; i++) free(m->procedures[i]);
+  free(m->procedures);
+  m->procedures = NULL;
+  m->procedurecount = 0;
+  m->proceduresize = 0;
+  if(m->compiled){
+    free(m->proceduretable.keys);
+    free(m->proceduretable.values);
+    m->compiled = 0;
+  }
+  free(m->code);
+  m->code = NULL;
+  m->codecount = 0;
+  m->codesize = 0;
+  m->programcount = 0;
+}
+
+void compileKB(Engine *engine){
+  Machine *m = engine->machine;
+  if(!m){
+    m = calloc(1, sizeof(Machine));
+    m->engine = engine;
+    engine->machine = m;
+  }
+  freeProgram(m);
+  initKeyTable(&m->proceduretable);
+  m->compiled = 1;
+  m->unbound = intern("_G", 2);
+  ClauseCompiler cc = {NULL, 0, 0, 0, 0, 0};
+  KeyTable *preds = &engine->kb->index->predicates;
+  for(int i = 0; i<preds->size; i++){
+    if(preds->values[i]) compilePredicate(m, preds->values[i], &cc);
+  }
+  free(cc.vars);
+  m->programcount = m->codecount;
+}
+
+/* ---- machine ---- */
+
+static WamCell cell(WamTag tag, int arity, unsigned int value){
+  WamCell c;
+  c.tag = tag;
+  c.arity = arity;
+  c.value = value;
+  return c;
+}
+
+static void growHeap(Machine *m, int needed){
+  if(m->h + needed < m->heapsize) return;
+  int size = m->heapsize;
+  while(m->h + needed >= m->heapsize) m->heapsize = m->heapsize ? m->heapsize * 2 : 4096;
+  // the machine keeps its stacks between queries; a query is charged for
+  // the growth it causes
+  m->heap = accountRealloc(MEMRESOLUTION, m->heap, size * sizeof(WamCell), m->heapsize * sizeof(WamCell));
+}
+
+static void growStack(Machine *m, int needed){
+  if(needed < m->stacksize) return;
+  int size = m->stacksize;
+  while(needed >= m->stacksize) m->stacksize = m->stacksize ? m->stacksize * 2 : 1024;
+  m->stack = accountRealloc(MEMRESOLUTION, m->stack, size * sizeof(WamCell), m->stacksize * sizeof(WamCell));
+}
+
+static WamCell newVariable(Machine *m){
+  m->heap[m->h] = cell(WREF, 0, m->h);
+  return m->heap[m->h++];
+}
+
+static WamCell derefCell(Machine *m, WamCell c){
+  while(c.tag == WREF){
+    WamCell h = m->heap[c.value];
+    if(h.tag == WREF && h.value == c.value) return c;
+    c = h;
+  }
+  return c;
+}
+
+static void trail(Machine *m, int address){
+  if(address >= m->hb) return;
+  if(m->tr == m->trailsize){
+    int size = m->trailsize;
+    m->trailsize = m->trailsize ? m->trailsize * 2 : 1024;
+    m->trail = accountRealloc(MEMRESOLUTION, m->trail, size * sizeof(int), m->trailsize * sizeof(int));
+  }
+  m->trail[m->tr++] = address;
+}
+
+static void unwindTrail(Machine *m, int mark){
+  while(m->tr > mark){
+    int address = m->trail[--m->tr];
+    m->heap[address] = cell(WREF, 0, address);
+  }
+}
+
+/* pushCell - pushes c on cells, a stack of *size cells holding *top */
+static void pushCell(WamCell **cells, int *size, int *top, WamCell c){
+  if((* top) == (* size)){
+    (* size) = (* size) ? (* size) * 2 : 256;
+    (* cells) = realloc(* cells, (* size) * sizeof(WamCell));
+  }
+  (* cells)[(* top)++] = c;
+}
+
+/* newEpoch - starts a walk of the heap; no cell is marked with the new epoch */
+static void newEpoch(Machine *m){
+  if(m->marksize < m->h){
+    free(m->marks);
+    m->marksize = m->heapsize;
+    m->marks = calloc(m->marksize, sizeof(unsigned int));
+    m->epoch = 0;
+  }
+  if(++m->epoch == 0){
+    memset(m->marks, 0, m->marksize * sizeof(unsigned int));
+    m->epoch = 1;
+  }
+}
+
+/* occursCell - 1 if the heap cell at address is reached from c, through
+ * the arguments of structures and the bindings of variables */
+static int occursCell(Machine *m, WamCell c, int address){
+  newEpoch(m);
+  int top = 0;
+  for(;;){
+    while(c.tag == WREF){
+      if(c.value == (unsigned int)address) return 1;
+      WamCell h = m->heap[c.value];
+      if(h.tag == WREF && h.value == c.value) break;
+      c = h;
+    }
+    if(c.tag == WSTR && m->marks[c.value] != m->epoch){
+      // a structure shared by several arguments is walked once
+      m->marks[c.value] = m->epoch;
+      if(c.value == (unsigned int)address) return 1;
+      int arity = m->heap[c.value].arity;
+      for(int i = 1; i<=arity; i++){
+        if(c.value + i == (unsigned int)address) return 1;
+        pushCell(&m->pending, &m->pendingsize, &top, m->heap[c.value + i]);
+      }
+    }
+    if(!top) return 0;
+    c = m->pending[--top];
+  }
+}
+
+/* cyclicBinding - refuses a binding that would make a cyclic term; in
+ * error mode it also stops the query */
+static int cyclicBinding(Machine *m){
+  if(m->engine->occurscheck == OCCURSERROR){
+    m->engine->cyclic = 1;
+    m->engine->abort = 1;
+  }
+  return 0;
+}
+
+/* bindCell - binds the unbound ref; of two variables the younger is bound.
+ * 0 if the occurs check refuses it */
+static int bindCell(Machine *m, WamCell ref, WamCell value){
+  if(value.tag == WREF && value.value > ref.value){
+    WamCell t = ref;
+    ref = value;
+    value = t;
+  }
+  if(value.tag == WSTR && m->engine->occurscheck != OCCURSOFF &&
+    occursCell(m, value, ref.value)){
+    return cyclicBinding(m);
+  }
+  m->heap[ref.value] = value;
+  trail(m, ref.value);
+  return 1;
+}
+
+static int unifyCells(Machine *m, WamCell a, WamCell b){
+  int top = 0;
+  for(;;){
+    a = derefCell(m, a);
+    b = derefCell(m, b);
+    if(a.tag == WREF){
+      if((b.tag != WREF || b.value != a.value) && !bindCell(m, a, b)) return 0;
+    } else if(b.tag == WREF){
+      if(!bindCell(m, b, a)) return 0;
+    } else if(a.tag != b.tag){
+      return 0;
+    } else if(a.tag == WCON){
+      if(a.value != b.value) return 0;
+    } else if(a.value != b.value){
+      WamCell fa = m->heap[a.value];
+      WamCell fb = m->heap[b.value];
+      if(fa.value != fb.value || fa.arity != fb.arity) return 0;
+      for(int i = fa.arity; i>=1; i--){
+        pushCell(&m->pairs, &m->pairsize, &top, m->heap[b.value + i]);
+        pushCell(&m->pairs, &m->pairsize, &top, m->heap[a.value + i]);
+      }
+    }
+    if(!top) return 1;
+    a = m->pairs[--top];
+    b = m->pairs[--top];
+  }
+}
+
+static WamCell *reg(Machine *m, int r){
+  if(r < 0) return &m->stack[m->e + 3 + WAM_Y(r)];
+  return &m->x[r];
+}
+
+static int envTop(Machine *m){
+  int top = m->e >= 0 ? m->e + 3 + (int)m->stack[m->e + 2].value : 0;
+  if(m->b >= 0 && m->choicepoints[m->b].etop > top) top = m->choicepoints[m->b].etop;
+  return top;
+}
+
+static void pushChoicepoint(Machine *m, int next){
+  int b = m->b + 1;
+  if(b == m->choicepointsize){
+    int size = m->choicepointsize;
+    m->choicepointsize = m->choicepointsize ? m->choicepointsize * 2 : 256;
+    m->choicepoints = accountRealloc(MEMRESOLUTION, m->choicepoints,
+      size * sizeof(Choicepoint), m->choicepointsize * sizeof(Choicepoint));
+  }
+  Choicepoint *c = &m->choicepoints[b];
+  c->arity = m->numargs;
+  c->args = m->b >= 0 ? m->choicepoints[m->b].args + m->choicepoints[m->b].arity : 0;
+  while(c->args + m->numargs >= m->argstacksize){
+    int size = m->argstacksize;
+    m->argstacksize = m->argstacksize ? m->argstacksize * 2 : 1024;
+    m->argstack = accountRealloc(MEMRESOLUTION, m->argstack,
+      size * sizeof(WamCell), m->argstacksize * sizeof(WamCell));
+  }
+  for(int i = 0; i<m->numargs; i++) m->argstack[c->args + i] = m->x[i];
+  c->e = m->e;
+  c->cp = m->cp;
+  c->b = m->b;
+  c->next = next;
+  c->tr = m->tr;
+  c->h = m->h;
+  c->etop = envTop(m);
+  m->b = b;
+  m->hb = m->h;
+}
+
+/* restoreChoicepoint - resets the machine to the state saved in B */
+static void restoreChoicepoint(Machine *m){
+  Choicepoint *c = &m->choicepoints[m->b];
+  m->numargs = c->arity;
+  for(int i = 0; i<m->numargs; i++) m->x[i] = m->argstack[c->args + i];
+  m->e = c->e;
+  m->cp = c->cp;
+  m->b0 = c->b;
+  unwindTrail(m, c->tr);
+  m->h = c->h;
+  m->hb = m->h;
+}
+
+/* backtrack - resumes the newest alternative; 0 when none remain */
+static int backtrack(Machine *m){
+  if(m->b < 0) return 0;
+  m->p = m->choicepoints[m->b].next;
+  return 1;
+}
+
+static void callProcedure(Machine *m, int proc, int arity){
+  m->numargs = arity;
+  m->p = m->procedures[proc]->address;
+}
+
+/* evaluateCell - sets *value to the value of the expression in c; 0 if it
+ * has none */
+static int evaluateCell(Machine *m, WamCell c, int *value){
+  // operands go on pending above their functor cell; a functor popped
+  // means its operands are on values
+  int top = 0, count = 0, size = 32, ok = 1;
+  int local[32];
+  int *values = local;
+  pushCell(&m->pending, &m->pendingsize, &top, c);
+  while(ok && top){
+    c = m->pending[--top];
+    int result;
+    if(c.tag == WFUN){
+      count -= c.arity;
+      ok = applyArithmetic(c.value, c.arity, values + count, &result);
+    } else {
+      c = derefCell(m, c);
+      if(c.tag == WCON && termType(c.value) == TTINTEGER){
+        result = termInteger(c.value);
+      } else if(c.tag == WSTR && m->heap[c.value].arity <= 2){
+        WamCell f = m->heap[c.value];
+        pushCell(&m->pending, &m->pendingsize, &top, f);
+        for(int i = f.arity; i>=1; i--) pushCell(&m->pending, &m->pendingsize, &top, m->heap[c.value + i]);
+        continue;
+      } else {
+        ok = 0;
+      }
+    }
+    if(!ok) break;
+    if(count == size){
+      size *= 2;
+      values = values == local ? memcpy(malloc(size * sizeof(int)), local, sizeof(local)) :
+        realloc(values, size * sizeof(int));
+    }
+    values[count++] = result;
+  }
+  if(ok) (* value) = values[0];
+  if(values != local) free(values);
+  return ok;
+}
+
+/* run - executes from P until an answer (1) or final failure (0) */
+static int run(Machine *m){
+  while(1){
+    if(m->engine->abort) return 0;
+    growHeap(m, 2);
+    WamInstruction *i = &m->code[m->p];
+    int ok = 1;
+    WamCell c;
+    switch(i->op){
+      case WIPUTVARIABLE:
+        c = newVariable(m);
+        *reg(m, i->reg) = c;
+        m->x[i->arg] = c;
+        m->p++;
+        break;
+      case WIPUTVALUE:
+        m->x[i->arg] = *reg(m, i->reg);
+        m->p++;
+        break;
+      case WIPUTSTRUCTURE:
+        *reg(m, i->reg) = cell(WSTR, 0, m->h);
+        m->heap[m->h++] = cell(WFUN, i->arg, i->value);
+        m->p++;
+        break;
+      case WIPUTCONSTANT:
+        m->x[i->arg] = cell(WCON, 0, i->value);
+        m->p++;
+        break;
+      case WIGETVARIABLE:
+        *reg(m, i->reg) = m->x[i->arg];
+        m->p++;
+        break;
+      case WIGETVALUE:
+        Stats.unifications++;
+        ok = unifyCells(m, *reg(m, i->reg), m->x[i->arg]);
+        m->p++;
+        break;
+      case WIGETSTRUCTURE:
+        Stats.unifications++;
+        c = derefCell(m, *reg(m, i->reg));
+        if(c.tag == WREF){
+          // the new structure has no arguments yet to check; they are
+          // checked as they are written
+          m->heap[m->h] = cell(WFUN, i->arg, i->value);
+          m->heap[c.value] = cell(WSTR, 0, m->h);
+          trail(m, c.value);
+          m->built = m->h++;
+          m->mode = WMWRITE;
+        } else if(c.tag == WSTR && m->heap[c.value].value == i->value &&
+          m->heap[c.value].arity == i->arg){
+          m->s = c.value + 1;
+          m->mode = WMREAD;
+        } else {
+          ok = 0;
+        }
+        m->p++;
+        break;
+      case WIGETCONSTANT:
+        Stats.unifications++;
+        c = derefCell(m, m->x[i->arg]);
+        if(c.tag == WREF) bindCell(m, c, cell(WCON, 0, i->value));
+        else ok = c.tag == WCON && c.value == i->value;
+        m->p++;
+        break;
+      case WISETVARIABLE:
+        *reg(m, i->reg) = newVariable(m);
+        m->p++;
+        break;
+      case WISETVALUE:
+        m->heap[m->h++] = *reg(m, i->reg);
+        m->p++;
+        break;
+      case WISETCONSTANT:
+        m->heap[m->h++] = cell(WCON, 0, i->value);
+        m->p++;
+        break;
+      case WIUNIFYVARIABLE:
+        if(m->mode == WMREAD) *reg(m, i->reg) = m->heap[m->s++];
+        else *reg(m, i->reg) = newVariable(m);
+        m->p++;
+        break;
+      case WIUNIFYVALUE:
+        if(m->mode == WMREAD){
+          ok = unifyCells(m, *reg(m, i->reg), m->heap[m->s++]);
+        } else if(m->engine->occurscheck != OCCURSOFF &&
+          occursCell(m, *reg(m, i->reg), m->built)){
+          ok = cyclicBinding(m);
+        } else {
+          m->heap[m->h++] = *reg(m, i->reg);
+        }
+        m->p++;
+        break;
+      case WIUNIFYCONSTANT:
+        if(m->mode == WMREAD){
+          c = derefCell(m, m->heap[m->s++]);
+          if(c.tag == WREF) bindCell(m, c, cell(WCON, 0, i->value));
+          else ok = c.tag == WCON && c.value == i->value;
+        } else {
+          m->heap[m->h++] = cell(WCON, 0, i->value);
+        }
+        m->p++;
+        break;
+      case WIALLOCATE: {
+        int e = envTop(m);
+        growStack(m, e + 3 + i->arg);
+        m->stack[e] = cell(WCON, 0, m->e);
+        m->stack[e + 1] = cell(WCON, 0, m->cp);
+        m->stack[e + 2] = cell(WCON, 0, i->arg);
+        m->e = e;
+        m->p++;
+        break;
+      }
+      case WIDEALLOCATE:
+        m->cp = m->stack[m->e + 1].value;
+        m->e = (int)m->stack[m->e].value;
+        m->p++;
+        break;
+      case WICALL:
+        Stats.steps++;
+        m->cp = m->p + 1;
+        m->b0 = m->b;
+        callProcedure(m, i->value, i->arg);
+        ok = m->p >= 0;
+        break;
+      case WIEXECUTE:
+        Stats.steps++;
+        m->b0 = m->b;
+        callProcedure(m, i->value, i->arg);
+        ok = m->p >= 0;
+        break;
+      case WIPROCEED:
+        m->p = m->cp;
+        break;
+      case WITRYMEELSE:
+        pushChoicepoint(m, i->value);
+        m->p++;
+        break;
+      case WIRETRYMEELSE:
+        restoreChoicepoint(m);
+        m->choicepoints[m->b].next = i->value;
+        m->p++;
+        break;
+      case WITRUSTME:
+        restoreChoicepoint(m);
+        m->b = m->choicepoints[m->b].b;
+        m->hb = m->b >= 0 ? m->choicepoints[m->b].h : 0;
+        m->p++;
+        break;
+      case WIGETLEVEL:
+        *reg(m, i->reg) = cell(WCON, 0, m->b0);
+        m->p++;
+        break;
+      case WISAVELEVEL:
+        *reg(m, i->reg) = cell(WCON, 0, m->b);
+        m->p++;
+        break;
+      case WICUT: {
+        int b = (int)reg(m, i->reg)->value;
+        if(b < m->b){
+          m->b = b;
+          m->hb = b >= 0 ? m->choicepoints[b].h : 0;
+        }
+        m->p++;
+        break;
+      }
+      case WIARITH: {
+        int left, right;
+        ok = evaluateCell(m, m->x[1], &right);
+        if(ok && i->value == SymIs){
+          Stats.unifications++;
+          ok = unifyCells(m, m->x[0], cell(WCON, 0, integerTerm(right)));
+        } else if(ok){
+          ok = evaluateCell(m, m->x[0], &left) && compareArithmetic(i->value, left, right);
+        }
+        m->p++;
+        break;
+      }
+      case WIFAIL:
+        ok = 0;
+        break;
+      case WIANSWER:
+        return 1;
+    }
+    if(!ok && !backtrack(m)) return 0;
+  }
+}
+
+/* cellToTerm - rebuilds a heap term in the term store. With the occurs
+ * check off the heap may be cyclic; a structure met again inside itself
+ * is left as a variable */
+static Term cellToTerm(Machine *m, WamCell c){
+  // arguments go on pending above their functor cell; a functor popped
+  // means its arguments are on values. A structure is marked while it is
+  // rebuilt, and a REF of arity -1 below its functor unmarks it
+  TermStack values;
+  initTermStack(&values);
+  newEpoch(m);
+  int top = 0;
+  pushCell(&m->pending, &m->pendingsize, &top, c);
+  while(top){
+    c = m->pending[--top];
+    Term t;
+    if(c.tag == WREF && c.arity < 0){
+      m->marks[c.value] = 0;
+      continue;
+    }
+    if(c.tag == WFUN){
+      values.count -= c.arity;
+      t = functorTerm(c.value, c.arity, values.items + values.count);
+    } else {
+      c = derefCell(m, c);
+      if(c.tag == WREF || (c.tag == WSTR && m->marks[c.value] == m->epoch)){
+        t = variableTerm(m->unbound, c.value);
+      } else if(c.tag == WCON){
+        t = c.value;
+      } else {
+        WamCell f = m->heap[c.value];
+        m->marks[c.value] = m->epoch;
+        pushCell(&m->pending, &m->pendingsize, &top, cell(WREF, -1, c.value));
+        pushCell(&m->pending, &m->pendingsize, &top, f);
+        for(int i = f.arity; i>=1; i--) pushCell(&m->pending, &m->pendingsize, &top, m->heap[c.value + i]);
+        continue;
+      }
+    }
+    PUSH_TERM(&values, t);
+  }
+  Term t = values.items[0];
+  freeTermStack(&values);
+  return t;
+}
+
+static int answerprompt(Machine *m, Term query, ClauseCompiler *cc){
+  Unifier *unifier = newUnifier();
+  for(int i = 0; i<cc->count; i++){
+    VarInfo *v = &cc->vars[i];
+    if(!v->seen) continue;
+    Term value = cellToTerm(m, *reg(m, v->reg));
+    if(value != v->var) bind(unifier, v->var, value);
+  }
+  int stop = presentAnswer(m->engine, unifier, query, substitute(query, unifier));
+  freeUnifier(&unifier);
+  return stop;
+}
+
+int wamResolve(Engine *engine, Term query){
+  Machine *m = engine->machine;
+  if(!m || !m->compiled) return 0;
+  ClauseCompiler cc = {NULL, 0, 0, 0, 0, 0};
+  m->codecount = m->programcount;
+  int start = m->codecount;
+  compileClause(m, 0, query, 1, &cc);
+  m->x = realloc(m->x, (m->registercount + 1) * sizeof(WamCell));
+  m->h = 0;
+  m->hb = 0;
+  m->tr = 0;
+  m->e = -1;
+  m->b = -1;
+  m->b0 = -1;
+  m->cp = -1;
+  m->numargs = 0;
+  m->p = start;
+  while(run(m)){
+    if(answerprompt(m, query, &cc)){
+      engine->abort = 1;
+      break;
+    }
+    if(!backtrack(m)) break;
+  }
+  free(cc.vars);
+  m->codecount = m->programcount;
+  return 0;
+}
+
+static const char *OpNames[] = {
+  "put_variable", "put_value", "put_structure", "put_constant",
+  "get_variable", "get_value", "get_structure", "get_constant",
+  "set_variable", "set_value", "set_constant",
+  "unify_variable", "unify_value", "unify_constant",
+  "allocate", "deallocate", "call", "execute", "proceed",
+  "try_me_else", "retry_me_else", "trust_me",
+  "get_level", "save_level", "cut", "arith",
+  "fail", "answer"
+};
+
+static void printRegister(int r){
+  if(r < 0) printf("Y%d", WAM_Y(r));
+  else printf("X%d", r);
+}
+
+static void printProcedure(Machine *m, unsigned int proc){
+  unsigned long long key = m->procedures[proc]->key;
+  printf("%s/%u", symbolName((Symbol)(key >> 32)), (unsigned int)key);
+}
+
+void printWamCode(Engine *engine){
+  Machine *m = engine->machine;
+  if(!m) return;
+  for(int p = 0; p<m->programcount; p++){
+    for(int i = 0; i<m->procedurecount; i++){
+      if(m->procedures[i]->address == p){
+        printProcedure(m, i);
+        printf(":\n");
+      }
+    }
+    WamInstruction *i = &m->code[p];
+    printf("%5d  %s ", p, OpNames[i->op]);
+    switch(i->op){
+      case WIPUTVARIABLE: case WIPUTVALUE: case WIGETVARIABLE: case WIGETVALUE:
+        printRegister(i->reg);
+        printf(", A%d", i->arg);
+        break;
+      case WIPUTCONSTANT: case WIGETCONSTANT: {
+        char *constant = termToString(i->value);
+        printf("%s, A%d", constant, i->arg);
+        freeChar(&constant);
+        break;
+      }
+      case WIPUTSTRUCTURE: case WIGETSTRUCTURE:
+        printf("%s/%d, ", symbolName(i->value), i->arg);
+        printRegister(i->reg);
+        break;
+      case WISETVARIABLE: case WISETVALUE: case WIUNIFYVARIABLE: case WIUNIFYVALUE:
+      case WIGETLEVEL: case WISAVELEVEL: case WICUT:
+        printRegister(i->reg);
+        break;
+      case WISETCONSTANT: case WIUNIFYCONSTANT: {
+        char *constant = termToString(i->value);
+        printf("%s", constant);
+        freeChar(&constant);
+        break;
+      }
+      case WIARITH:
+        printf("%s/%d", symbolName(i->value), i->arg);
+        break;
+      case WIALLOCATE:
+        printf("%d", i->arg);
+        break;
+      case WICALL: case WIEXECUTE:
+        printProcedure(m, i->value);
+        break;
+      case WITRYMEELSE: case WIRETRYMEELSE:
+        printf("%u", i->value);
+        break;
+      default:
+        break;
+    }
+    printf("\n");
+  }
+}
+
+void freeWam(Engine *engine){
+  Machine *m = engine->machine;
+  if(!m) return;
+  freeProgram(m);
+  free(m->heap);
+  free(m->x);
+  free(m->stack);
+  free(m->choicepoints);
+  free(m->argstack);
+  free(m->trail);
+  free(m->marks);
+  free(m->pending);
+  free(m->pairs);
+  free(m);
+  engine->machine = NULL;
+}
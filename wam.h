@@ -0,0 +1,89 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Brian O'Dell
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PPP_WAM
+#define PPP_WAM
+
+#include "ppp.h"
+
+/**
+ * WAM
+ *
+ * The knowledge base is compiled to instructions for a Warren Abstract
+ * Machine: head arguments become get/unify instructions, body goals become
+ * put/set instructions followed by call or execute, and the clauses of a
+ * predicate are chained with try_me_else/retry_me_else/trust_me. The VM
+ * keeps terms on a heap, environments and choicepoints on stacks and undoes
+ * bindings from a trail, so it backtracks fully without interpreting text.
+ *
+ * A clause with a cut saves B0, the choicepoint register as it was when
+ * the clause's predicate was called, in a permanent variable (get_level),
+ * and ! resets B to it (cut). once(G) is compiled in place: save_level
+ * keeps B before G is called and the cut after it goes back to it.
+ *
+ * Constants are the terms of atoms and integers. is/2 and the comparisons
+ * load their two arguments like a call and arith evaluates them on the
+ * heap, binding A0 for is/2.
+ *
+ * The pen & paper interpreter in ppp.c stays the reference; the VM is
+ * selected with --vm.
+ */
+
+typedef enum
+{
+  WIPUTVARIABLE, WIPUTVALUE, WIPUTSTRUCTURE, WIPUTCONSTANT,
+  WIGETVARIABLE, WIGETVALUE, WIGETSTRUCTURE, WIGETCONSTANT,
+  WISETVARIABLE, WISETVALUE, WISETCONSTANT,
+  WIUNIFYVARIABLE, WIUNIFYVALUE, WIUNIFYCONSTANT,
+  WIALLOCATE, WIDEALLOCATE, WICALL, WIEXECUTE, WIPROCEED,
+  WITRYMEELSE, WIRETRYMEELSE, WITRUSTME,
+  WIGETLEVEL, WISAVELEVEL, WICUT, WIARITH,
+  WIFAIL, WIANSWER
+}WamOp;
+
+/* WAM_Y - encodes permanent variable n as a register operand */
+#define WAM_Y(n) (-(n) - 1)
+
+typedef struct WAM_INSTRUCTION{
+  WamOp op;
+  int reg;             /* Xn (>= 0) or WAM_Y(n) */
+  int arg;             /* argument register, arity or environment size */
+  unsigned int value;  /* symbol, constant term, procedure or code address */
+} WamInstruction;
+
+/* compileKB - compiles every clause of engine's KB, replacing the previous
+ * program */
+void compileKB(Engine *engine);
+
+/* freeWam - releases the program and the machine of engine */
+void freeWam(Engine *engine);
+
+/* wamResolve - runs query on the compiled program, presenting each answer;
+ * returns 0 once no answers remain or the user stops */
+int wamResolve(Engine *engine, Term query);
+
+/* printWamCode - lists the compiled program */
+void printWamCode(Engine *engine);
+
+#endif